@@ -0,0 +1,135 @@
+/**
+ * File :      Arduino.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Subset of the Arduino core used by the firmware, backed by NativeHal.
+*/
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "NativeHal.h"
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+#define INPUT_PULLDOWN  0x09
+
+#define DEC 10
+#define HEX 16
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+unsigned long millis();
+unsigned long micros();
+void yield();
+
+/**
+ * Minimal Arduino String, only what the firmware and the shims need.
+ */
+class String {
+private:
+    std::string _s;
+
+public:
+    String() = default;
+    String(const char* s) : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    explicit String(char c) : _s(1, c) {}
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.length(); }
+    char operator[](unsigned int i) const { return _s[i]; }
+
+    String& operator+=(const String& o) { _s += o._s; return *this; }
+    String& operator+=(const char* o) { _s += o; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator==(const char* o) const { return _s == o; }
+
+    long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+    void trim();
+};
+
+/**
+ * Base of every byte sink : serial port, files.
+ * println() terminates lines with "\r\n", as the real core does.
+ */
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) { return write(&c, 1); }
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(long long n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned long long n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(double d, int digits = 2);
+
+    size_t println() { return print("\r\n"); }
+    template<typename T>
+    size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template<typename T>
+    size_t println(const T& v, int format) { size_t n = print(v, format); return n + println(); }
+};
+
+/**
+ * Serial port, output goes to stdout. Input can be fed by a driver program.
+ */
+class HardwareSerial : public Print {
+private:
+    std::string _rx;
+
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    operator bool() const { return true; }
+
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int available() const { return (int)_rx.size(); }
+    int read();
+    void flush() { fflush(stdout); }
+
+    void feed(const char* s) { _rx += s; }      // Host only : bytes the firmware will receive
+};
+
+extern HardwareSerial Serial;
+
+/**
+ * Chip information of the core. The host has no cycle counter : it counts nanoseconds of the
+ * host's clock, as a 1000 MHz CPU would count cycles.
+ */
+class EspClass {
+public:
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 1000; }
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,195 @@
+#include "freertos/task.h"
+#include "NativeHal.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+
+struct tskTaskControlBlock {
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+    bool deleted = false;                       // By another task, its thread ends at its next wait
+    bool adopted = false;                       // Thread that isn't a task, see xTaskGetCurrentTaskHandle()
+    uint8_t* stack = nullptr;                   // Painted with StackPaint, lowest address first
+    size_t stackSize = 0;
+};
+
+namespace {
+
+/**
+ * Thrown by vTaskDelete(nullptr), or by the next wait of a task another one deleted : ends its thread.
+ */
+struct TaskDeleted {};
+
+std::string failingTask;                        // See nativehal::failTaskCreation()
+
+thread_local tskTaskControlBlock* currentTask = nullptr;
+thread_local BaseType_t currentCore = 1;        // Arduino runs setup() and loop() on core 1
+
+const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+// Host frames are much larger than the ESP32's : a task gets this much more stack than it asked for,
+// and the high-water mark is what is left of the requested size once this margin is used up
+const size_t HostStackMargin = 256 * 1024;
+const uint8_t StackPaint = 0xA5;
+
+struct TaskStart {
+    TaskFunction_t code;
+    void* parameters;
+    tskTaskControlBlock* task;
+    BaseType_t core;
+};
+
+void* runTask(void* argument) {
+    TaskStart start = *static_cast<TaskStart*>(argument);
+    delete static_cast<TaskStart*>(argument);
+
+    currentTask = start.task;
+    currentCore = start.core == tskNO_AFFINITY ? 0 : start.core;
+    try {
+        start.code(start.parameters);
+    }
+    catch (const TaskDeleted&) {
+        return nullptr;
+    }
+    abort();                                    // A FreeRTOS task must not return
+}
+
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth, void* parameters,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t coreId) {
+    (void)priority;
+
+    if (name && !failingTask.empty() && failingTask == name) {
+        if (createdTask)
+            *createdTask = nullptr;
+        return pdFAIL;
+    }
+
+    // Never freed, like a task that is never deleted
+    tskTaskControlBlock* task = new tskTaskControlBlock();
+    task->name = name ? name : "";
+    task->stackSize = stackDepth + HostStackMargin;
+    task->stack = static_cast<uint8_t*>(aligned_alloc(4096, (task->stackSize + 4095) / 4096 * 4096));
+    if (!task->stack)
+        return pdFAIL;
+    memset(task->stack, StackPaint, task->stackSize);
+
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, task->stack, task->stackSize);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    bool started = pthread_create(&thread, &attributes, runTask, new TaskStart{code, parameters, task, coreId}) == 0;
+    pthread_attr_destroy(&attributes);
+
+    if (createdTask)
+        *createdTask = started ? task : nullptr;
+    return started ? pdPASS : pdFAIL;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != nullptr && task != currentTask) {
+        {
+            std::lock_guard<std::mutex> guard(task->mutex);
+            task->deleted = true;
+        }
+        task->notified.notify_one();
+        return;
+    }
+    if (currentTask == nullptr || currentTask->adopted)    // Not a task, e.g. loop() called by a driver
+        return;
+    throw TaskDeleted();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // On the ESP32, setup() and loop() run in a task : the driver's thread gets a control block as well
+    if (currentTask == nullptr) {
+        currentTask = new tskTaskControlBlock();
+        currentTask->adopted = true;
+    }
+    return currentTask;
+}
+
+size_t nativehal::taskStackUsed(tskTaskControlBlock* task) {
+    if (task == nullptr || task->stack == nullptr)     // setup() and loop() run on the driver's own stack
+        return 0;
+
+    // The stack grows down : the bytes still painted at the bottom were never reached
+    size_t untouched = 0;
+    while (untouched < task->stackSize && task->stack[untouched] == StackPaint)
+        untouched++;
+    return task->stackSize - untouched;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    if (task == nullptr)
+        task = currentTask;
+    if (task == nullptr || task->stack == nullptr)
+        return 0;
+
+    size_t requested = task->stackSize - HostStackMargin;
+    size_t used = nativehal::taskStackUsed(task);
+    return used < requested ? (UBaseType_t)(requested - used) : 0;
+}
+
+BaseType_t xPortGetCoreID() {
+    return currentCore;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+
+    if (currentTask != nullptr) {
+        std::lock_guard<std::mutex> guard(currentTask->mutex);
+        if (currentTask->deleted)
+            throw TaskDeleted();
+    }
+}
+
+void nativehal::failTaskCreation(const char* name) {
+    failingTask = name ? name : "";
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->mutex);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+    tskTaskControlBlock* task = currentTask;
+    if (task == nullptr)
+        abort();
+
+    std::unique_lock<std::mutex> guard(task->mutex);
+    auto pending = [task]() { return task->notifications > 0 || task->deleted; };
+
+    if (ticksToWait == portMAX_DELAY)
+        task->notified.wait(guard, pending);
+    else
+        task->notified.wait_for(guard, std::chrono::milliseconds(ticksToWait * portTICK_PERIOD_MS), pending);
+
+    if (task->deleted)
+        throw TaskDeleted();
+
+    uint32_t value = task->notifications;
+    if (value > 0)
+        task->notifications = clearCountOnExit ? 0 : value - 1;
+    return value;
+}
@@ -0,0 +1,170 @@
+#include "LittleFS.h"
+
+#include <filesystem>
+#include <string>
+
+#include "NorFlash.h"
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+File::Handle::~Handle() {
+    if (fp) {
+        if (!modelled.empty() && nativehal::flashModel())
+            nativehal::flashModel()->sync(modelled);
+        fclose(fp);
+        nativehal::counters().fileCloses++;
+    }
+}
+
+File::File(FILE* fp, const std::string& modelled, bool append) : _h(std::make_shared<Handle>()) {
+    _h->fp = fp;
+    _h->modelled = modelled;
+    _h->append = append;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+    if (!*this)
+        return 0;
+    size_t allowed = nativehal::writeAllowance(size);
+    nativehal::LfsModel* model = _h->modelled.empty() ? nullptr : nativehal::flashModel();
+    size_t pos = !model ? 0 : (_h->append ? File::size() : position());
+    size_t n = allowed ? fwrite(buffer, 1, allowed, _h->fp) : 0;
+    nativehal::counters().bytesWritten += n;
+    if (model)
+        model->write(_h->modelled, pos, n);
+    if (n < size) {
+        fflush(_h->fp);
+        nativehal::shortWrite();
+    }
+    return n;
+}
+
+int File::available() {
+    if (!*this)
+        return 0;
+    return (int)(size() - position());
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+    if (!*this)
+        return 0;
+    size_t n = fread(buffer, 1, size, _h->fp);
+    nativehal::counters().bytesRead += n;
+    return n;
+}
+
+String File::readStringUntil(char terminator) {
+    std::string s;
+    int c;
+    while ((c = read()) >= 0 && c != terminator)
+        s += (char)c;
+    return String(s);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!*this)
+        return false;
+    int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+    return fseek(_h->fp, pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!*this)
+        return 0;
+    return (size_t)ftell(_h->fp);
+}
+
+size_t File::size() const {
+    if (!*this)
+        return 0;
+    long pos = ftell(_h->fp);
+    fseek(_h->fp, 0, SEEK_END);
+    long end = ftell(_h->fp);
+    fseek(_h->fp, pos, SEEK_SET);
+    return (size_t)end;
+}
+
+void File::flush() {
+    if (!*this)
+        return;
+    fflush(_h->fp);
+    if (!_h->modelled.empty() && nativehal::flashModel())
+        nativehal::flashModel()->sync(_h->modelled);
+}
+
+void File::close() {
+    _h.reset();
+}
+
+File FS::open(const char* path, const char* mode, const bool create) {
+    nativehal::UncountedAllocations uncounted;
+    std::string host = nativehal::hostPath(_volume, path);
+    std::string m = mode;
+
+    if (create)
+        std::filesystem::create_directories(std::filesystem::path(host).parent_path());
+
+    bool existed = std::filesystem::exists(host);
+    if (m == "r+" && !existed)
+        return File();
+
+    FILE* fp = fopen(host.c_str(), (m + "b").c_str());
+    if (!fp)
+        return File();
+
+    nativehal::counters().fileOpens++;
+    nativehal::waitFileLatency();
+
+    nativehal::LfsModel* model = nativehal::flashModel();
+    if (!model || std::string(_volume) != "littlefs")
+        return File(fp);
+
+    model->open(path, mode, existed);
+    return File(fp, path, m[0] == 'a');
+}
+
+bool FS::exists(const char* path) {
+    nativehal::UncountedAllocations uncounted;
+    return std::filesystem::exists(nativehal::hostPath(_volume, path));
+}
+
+bool FS::remove(const char* path) {
+    nativehal::UncountedAllocations uncounted;
+    std::error_code ec;
+    bool removed = std::filesystem::remove(nativehal::hostPath(_volume, path), ec);
+    if (removed && nativehal::flashModel() && std::string(_volume) == "littlefs")
+        nativehal::flashModel()->remove(path);
+    return removed;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+    nativehal::UncountedAllocations uncounted;
+    std::error_code ec;
+    std::filesystem::rename(nativehal::hostPath(_volume, pathFrom), nativehal::hostPath(_volume, pathTo), ec);
+    if (!ec && nativehal::flashModel() && std::string(_volume) == "littlefs")
+        nativehal::flashModel()->rename(pathFrom, pathTo);
+    return !ec;
+}
+
+bool LittleFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+    (void)formatOnFail; (void)basePath; (void)maxOpenFiles; (void)partitionLabel;
+    nativehal::waitInitLatency(nativehal::PeripheralFlash);
+    std::error_code ec;
+    std::filesystem::create_directories(nativehal::hostPath("littlefs", "/"), ec);
+    return !ec;
+}
+
+bool LittleFSFS::format() {
+    std::error_code ec;
+    std::filesystem::remove_all(nativehal::hostPath("littlefs", "/"), ec);
+    return begin();
+}
+
+}
@@ -0,0 +1,83 @@
+/**
+ * File :      LittleFS.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Arduino-ESP32 LittleFS API backed by a host directory (see NativeHal::hostPath).
+*/
+#ifndef LITTLEFS_H
+#define LITTLEFS_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+/**
+ * Open file, copies share the same handle like the real fs::File.
+ */
+class File : public Print {
+private:
+    struct Handle {
+        FILE* fp = nullptr;
+        std::string modelled;       // Path reported to the flash wear model (see NorFlash.h), empty if none
+        bool append = false;
+        ~Handle();
+    };
+    std::shared_ptr<Handle> _h;
+
+public:
+    File() = default;
+    explicit File(FILE* fp, const std::string& modelled = std::string(), bool append = false);
+
+    operator bool() const { return _h && _h->fp; }
+
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int available();
+    int read();
+    size_t read(uint8_t* buffer, size_t size);
+    String readStringUntil(char terminator);
+
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void flush();
+    void close();
+};
+
+class FS {
+private:
+    const char* _volume;
+
+public:
+    explicit FS(const char* volume) : _volume(volume) {}
+
+    File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* pathFrom, const char* pathTo);
+};
+
+class LittleFSFS : public FS {
+public:
+    LittleFSFS() : FS("littlefs") {}
+
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs");
+    bool format();
+    void end() {}
+};
+
+}
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,513 @@
+#include "NativeHal.h"
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SPI.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include <malloc.h>
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint64_t period;                            // 0 for a one-shot timer
+    uint64_t nextFire;
+    bool active;
+};
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+SPIClass SPI;
+
+namespace nativehal {
+
+static const int PinCount = 40;
+
+struct PinState {
+    int level = LOW;
+    uint32_t risingEdges = 0;
+    uint64_t lastChange = 0;
+    uint64_t highMicros = 0;
+};
+
+struct PinEvent {
+    uint8_t pin;
+    int level;
+};
+
+static std::recursive_mutex lock;               // Clock, pins, schedule and timers
+static std::atomic<uint64_t> now{0};
+static PinState pins[PinCount];
+static std::multimap<uint64_t, PinEvent> schedule;
+static std::vector<esp_timer*> timers;
+
+static uint64_t deadline = 0;
+static void (*deadlineHandler)() = nullptr;
+
+static bool rtcIsPresent = true;
+static uint64_t rtcBaseEpochMicros = 1577836800000000ULL;  // 2020-01-01T00:00:00
+static uint64_t rtcBaseMicros = 0;
+static int32_t rtcDriftPpm = 0;
+
+static std::string root;
+static uint32_t fileLatency = 0;
+static std::atomic<uint32_t> initLatency[PeripheralCount];
+static uint32_t writeFailures = 0;
+static uint64_t powerCutBudget = 0;
+static void (*powerCutHandler)() = nullptr;
+static Counters counterValues;
+
+void reset() {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    now = 0;
+    for (PinState& p : pins)
+        p = PinState();
+    schedule.clear();
+    for (esp_timer* t : timers)
+        t->active = false;
+    deadline = 0;
+    deadlineHandler = nullptr;
+    rtcIsPresent = true;
+    rtcBaseEpochMicros = 1577836800000000ULL;
+    rtcBaseMicros = 0;
+    rtcDriftPpm = 0;
+    writeFailures = 0;
+    powerCutHandler = nullptr;
+    counterValues = Counters();
+}
+
+uint64_t nowMicros() {
+    return now;
+}
+
+/**
+ * Earliest active timer due before target, nullptr if none.
+ */
+static esp_timer* nextTimer(uint64_t target) {
+    esp_timer* next = nullptr;
+    for (esp_timer* t : timers)
+        if (t->active && t->nextFire <= target && (!next || t->nextFire < next->nextFire))
+            next = t;
+    return next;
+}
+
+/**
+ * Moves the clock to now + us, applying events in time order. When coalescing, a periodic
+ * timer fires once at most, then skips to its first period after the target.
+ */
+static void advance(uint64_t us, bool coalesce) {
+    std::unique_lock<std::recursive_mutex> guard(lock);
+    uint64_t target = now + us;
+
+    while (true) {
+        esp_timer* t = nextTimer(target);
+        bool pinFirst = !schedule.empty() && schedule.begin()->first <= target
+            && (!t || schedule.begin()->first <= t->nextFire);
+
+        if (pinFirst) {
+            auto it = schedule.begin();
+            now = it->first;
+            PinEvent e = it->second;
+            schedule.erase(it);
+            setPin(e.pin, e.level);
+        }
+        else if (t) {
+            now = t->nextFire;
+            if (t->period && coalesce && t->nextFire + t->period <= target)
+                t->nextFire += ((target - t->nextFire) / t->period + 1) * t->period;
+            else if (t->period)
+                t->nextFire += t->period;
+            else
+                t->active = false;
+            t->callback(t->arg);
+        }
+        else
+            break;
+    }
+    now = target;
+
+    if (deadlineHandler && now >= deadline) {
+        void (*handler)() = deadlineHandler;
+        deadlineHandler = nullptr;
+        guard.unlock();
+        handler();
+    }
+}
+
+void advanceMicros(uint64_t us) {
+    advance(us, false);
+}
+
+void warpMicros(uint64_t us) {
+    advance(us, true);
+}
+
+void setPin(uint8_t pin, int level) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    if (pin >= PinCount)
+        return;
+    PinState& p = pins[pin];
+    level = level ? HIGH : LOW;
+    if (level == p.level)
+        return;
+    if (level == HIGH)
+        p.risingEdges++;
+    else
+        p.highMicros += now - p.lastChange;
+    p.level = level;
+    p.lastChange = now;
+}
+
+int pinLevel(uint8_t pin) {
+    return pin < PinCount ? pins[pin].level : LOW;
+}
+
+uint32_t pinRisingEdges(uint8_t pin) {
+    return pin < PinCount ? pins[pin].risingEdges : 0;
+}
+
+uint64_t pinHighMicros(uint8_t pin) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    if (pin >= PinCount)
+        return 0;
+    const PinState& p = pins[pin];
+    return p.highMicros + (p.level == HIGH ? now - p.lastChange : 0);
+}
+
+void schedulePin(uint8_t pin, int level, uint64_t atMicros) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    schedule.insert({atMicros, PinEvent{pin, level}});
+}
+
+void pressKey(uint8_t pin, uint64_t atMicros, uint32_t holdMillis) {
+    schedulePin(pin, HIGH, atMicros);
+    schedulePin(pin, LOW, atMicros + holdMillis * 1000ULL);
+}
+
+bool hasScheduledEvents() {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    return !schedule.empty();
+}
+
+void setDeadline(uint64_t atMicros, void (*onDeadline)()) {
+    deadline = atMicros;
+    deadlineHandler = onDeadline;
+}
+
+void setRtcPresent(bool present) {
+    rtcIsPresent = present;
+}
+
+bool rtcPresent() {
+    return rtcIsPresent;
+}
+
+/**
+ * RTC time in us, it runs rtcDriftPpm faster than the virtual clock.
+ */
+static uint64_t rtcMicros() {
+    int64_t elapsed = now - rtcBaseMicros;
+    return rtcBaseEpochMicros + elapsed + elapsed * rtcDriftPpm / 1000000;
+}
+
+void setRtcEpoch(uint32_t epoch) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    rtcBaseEpochMicros = epoch * 1000000ULL;
+    rtcBaseMicros = now;
+}
+
+uint32_t rtcEpoch() {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    return rtcMicros() / 1000000ULL;
+}
+
+void setRtcDrift(int32_t ppm) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    rtcBaseEpochMicros = rtcMicros();
+    rtcBaseMicros = now;
+    rtcDriftPpm = ppm;
+}
+
+void shiftRtc(int64_t seconds) {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    rtcBaseEpochMicros += seconds * 1000000;
+}
+
+uint64_t rtcEpochMicros() {
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    return rtcMicros();
+}
+
+void setFsRoot(const std::string& path) {
+    root = path;
+}
+
+const std::string& fsRoot() {
+    if (root.empty()) {
+        const char* env = getenv("RTB_NATIVE_FS");
+        root = env ? env : ".native_fs";
+    }
+    return root;
+}
+
+std::string hostPath(const char* volume, const char* path) {
+    std::string p = fsRoot() + "/" + volume;
+    if (path[0] != '/')
+        p += '/';
+    return p + path;
+}
+
+void wipeFs() {
+    std::error_code ec;
+    std::filesystem::remove_all(fsRoot(), ec);
+}
+
+void setFileLatency(uint32_t micros) {
+    fileLatency = micros;
+}
+
+void waitFileLatency() {
+    if (fileLatency)
+        std::this_thread::sleep_for(std::chrono::microseconds(fileLatency));
+}
+
+void setInitLatency(Peripheral peripheral, uint32_t micros) {
+    initLatency[peripheral] = micros;
+}
+
+void waitInitLatency(Peripheral peripheral) {
+    if (initLatency[peripheral])
+        std::this_thread::sleep_for(std::chrono::microseconds(initLatency[peripheral]));
+}
+
+void setWriteFailures(uint32_t count) {
+    writeFailures = count;
+}
+
+void setPowerCut(uint64_t afterBytes, void (*onPowerCut)()) {
+    powerCutBudget = afterBytes;
+    powerCutHandler = onPowerCut;
+}
+
+size_t writeAllowance(size_t size) {
+    if (writeFailures > 0) {
+        writeFailures--;
+        return 0;
+    }
+    if (!powerCutHandler)
+        return size;
+    size_t allowed = size < powerCutBudget ? size : (size_t)powerCutBudget;
+    powerCutBudget -= allowed;
+    return allowed;
+}
+
+void shortWrite() {
+    if (powerCutHandler && powerCutBudget == 0) {
+        void (*handler)() = powerCutHandler;
+        powerCutHandler = nullptr;
+        handler();
+    }
+}
+
+Counters& counters() {
+    return counterValues;
+}
+
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    (void)pin; (void)mode;
+}
+
+int digitalRead(uint8_t pin) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    nativehal::counters().digitalReads++;
+    return nativehal::pinLevel(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    nativehal::counters().digitalWrites++;
+    nativehal::setPin(pin, val);
+}
+
+void delay(uint32_t ms) {
+    nativehal::counters().delays++;
+    nativehal::advanceMicros(ms * 1000ULL);
+}
+
+void delayMicroseconds(uint32_t us) {
+    nativehal::advanceMicros(us);
+}
+
+unsigned long millis() {
+    return (unsigned long)(nativehal::nowMicros() / 1000ULL);
+}
+
+unsigned long micros() {
+    return (unsigned long)nativehal::nowMicros();
+}
+
+void yield() {}
+
+void String::trim() {
+    size_t b = 0, e = _s.size();
+    while (b < e && isspace((unsigned char)_s[b]))
+        b++;
+    while (e > b && isspace((unsigned char)_s[e - 1]))
+        e--;
+    _s = _s.substr(b, e - b);
+}
+
+size_t Print::print(long n, int base) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), base == HEX ? "%lx" : "%ld", n);
+    return print(buffer);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), base == HEX ? "%lx" : "%lu", n);
+    return print(buffer);
+}
+
+size_t Print::print(double d, int digits) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, d);
+    return print(buffer);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+// Free DRAM heap of an ESP32 running the Arduino core, before the firmware allocates
+static const size_t HeapSize = 300 * 1024;
+
+static thread_local int uncountedDepth = 0;
+
+nativehal::UncountedAllocations::UncountedAllocations() {
+    uncountedDepth++;
+}
+
+nativehal::UncountedAllocations::~UncountedAllocations() {
+    uncountedDepth--;
+}
+
+bool nativehal::allocationsCounted() {
+    return uncountedDepth == 0;
+}
+
+static size_t hostHeapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;                 // Small blocks, and the large ones malloc maps apart
+}
+
+static std::atomic<size_t> heapInUseAtStart{hostHeapInUse()};
+static std::atomic<size_t> heapMinimumFree{HeapSize};
+
+void nativehal::resetHeap() {
+    heapInUseAtStart = hostHeapInUse();
+    heapMinimumFree = HeapSize;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    (void)caps;
+    size_t used = hostHeapInUse();
+    size_t start = heapInUseAtStart;
+    used = used > start ? used - start : 0;
+    size_t free = used < HeapSize ? HeapSize - used : 0;
+
+    size_t minimum = heapMinimumFree;
+    while (free < minimum && !heapMinimumFree.compare_exchange_weak(minimum, free)) {}
+    return free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    heap_caps_get_free_size(caps);
+    return heapMinimumFree;
+}
+
+uint32_t EspClass::getCycleCount() {
+    static const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+int HardwareSerial::read() {
+    if (_rx.empty())
+        return -1;
+    int c = (unsigned char)_rx[0];
+    _rx.erase(0, 1);
+    return c;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    if (!create_args || !create_args->callback || !out_handle)
+        return ESP_ERR_INVALID_ARG;
+    *out_handle = new esp_timer{create_args->callback, create_args->arg, 0, 0, false};
+    nativehal::timers.push_back(*out_handle);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    if (timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->period = 0;
+    timer->nextFire = nativehal::nowMicros() + timeout_us;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    if (timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->period = period;
+    timer->nextFire = nativehal::nowMicros() + period;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    if (!timer->active)
+        return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    for (size_t i = 0; i < nativehal::timers.size(); i++)
+        if (nativehal::timers[i] == timer)
+            nativehal::timers.erase(nativehal::timers.begin() + i);
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::recursive_mutex> guard(nativehal::lock);
+    return timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)nativehal::nowMicros();
+}
@@ -0,0 +1,109 @@
+/**
+ * File :      NativeHal.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Control surface of the simulated board used by the native (host) build.
+ *             Time is virtual : delay() advances it instantly, so a run is deterministic
+ *             and as fast as the CPU allows. Pins, RTC and file systems are plain memory
+ *             or host files that a driver program can script and inspect.
+ *             Firmware tasks (see freertos/task.h) are real threads : the clock, pins and
+ *             timers are guarded by one lock, so any thread may touch them.
+*/
+#ifndef NATIVEHAL_H
+#define NATIVEHAL_H
+
+#include <cstdint>
+#include <string>
+
+struct tskTaskControlBlock;
+
+namespace nativehal {
+
+/**
+ * Number of hardware accesses done by the firmware since the last reset().
+ */
+struct Counters {
+    uint64_t digitalReads = 0;
+    uint64_t digitalWrites = 0;
+    uint64_t delays = 0;
+    uint64_t rtcReads = 0;
+    uint64_t fileOpens = 0;
+    uint64_t fileCloses = 0;
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+};
+
+void reset();                                   // Pins, clock, scheduled events and counters back to power-on values
+
+// Virtual clock
+uint64_t nowMicros();
+void advanceMicros(uint64_t us);                // Applies every scheduled event that falls in the elapsed interval
+void warpMicros(uint64_t us);                   // Same, but periodic timers fire once at most : skips days of idle keypad sampling
+
+// Pins
+void setPin(uint8_t pin, int level);
+int pinLevel(uint8_t pin);
+uint32_t pinRisingEdges(uint8_t pin);           // How often the firmware drove the pin HIGH
+uint64_t pinHighMicros(uint8_t pin);            // Virtual time spent HIGH, pulse in progress included
+void schedulePin(uint8_t pin, int level, uint64_t atMicros);
+void pressKey(uint8_t pin, uint64_t atMicros, uint32_t holdMillis);
+bool hasScheduledEvents();
+
+/**
+ * Once the virtual clock reaches atMicros, onDeadline is called (typically to print a report and exit).
+ * It is the only way out of firmware code that waits forever, e.g. the State::Problem loop.
+ */
+void setDeadline(uint64_t atMicros, void (*onDeadline)());
+
+// DS3231
+void setRtcPresent(bool present);
+bool rtcPresent();
+void setRtcEpoch(uint32_t epoch);               // RTC reading at the current virtual instant
+uint32_t rtcEpoch();
+uint64_t rtcEpochMicros();                      // Same, in us
+void shiftRtc(int64_t seconds);                 // Sets the RTC forward (backward if negative), keeps the phase of its second
+void setRtcDrift(int32_t ppm);                  // The RTC runs ppm faster (negative : slower) than the virtual clock
+
+// File systems, LittleFS lives in <root>/littlefs and the SD card in <root>/sd
+void setFsRoot(const std::string& path);
+const std::string& fsRoot();
+std::string hostPath(const char* volume, const char* path);
+void wipeFs();
+void setFileLatency(uint32_t micros);           // Real time every file open takes, e.g. to mimic an SD card
+void waitFileLatency();
+
+// Real time the peripherals take to start (RTC.begin(), LittleFS.begin(), SD card begin()), 0 by default
+enum Peripheral { PeripheralRtc, PeripheralFlash, PeripheralSd, PeripheralCount };
+void setInitLatency(Peripheral peripheral, uint32_t micros);
+void waitInitLatency(Peripheral peripheral);
+
+// The file system stand-ins allocate through operator new (paths, handles) where the ESP32 libraries
+// use malloc : while one runs, its allocations aren't counted by the firmware (see MemoryStats.h)
+class UncountedAllocations {
+public:
+    UncountedAllocations();
+    ~UncountedAllocations();
+};
+bool allocationsCounted();
+
+// Free heap (heap_caps_get_free_size) counted from now on, what the driver allocated so far excluded
+void resetHeap();
+
+// xTaskCreatePinnedToCore() fails for the task of that name, nullptr for none
+void failTaskCreation(const char* name);
+
+// Stack a task used on the host, its frames are larger than on the ESP32 (see uxTaskGetStackHighWaterMark)
+size_t taskStackUsed(tskTaskControlBlock* task);
+
+// Faults of the file systems, for both volumes
+void setWriteFailures(uint32_t count);          // The next count writes fail, nothing is written
+void setPowerCut(uint64_t afterBytes, void (*onPowerCut)());    // Once afterBytes more bytes are written, the write is cut there and
+                                                // onPowerCut is called (it doesn't return, e.g. _exit()), nullptr disarms
+size_t writeAllowance(size_t size);             // Called by the backends before a write : bytes that may be written
+void shortWrite();                              // Called by the backends after a write got less than it asked, once flushed
+
+Counters& counters();
+
+}
+
+#endif
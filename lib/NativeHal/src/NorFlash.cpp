@@ -0,0 +1,275 @@
+#include "NorFlash.h"
+
+#include <algorithm>
+
+namespace nativehal {
+
+static LfsModel* model = nullptr;
+
+static const uint32_t NoBlock = UINT32_MAX;
+static const size_t TagSize = 4;
+static const size_t CrcSize = 8;            // CRC tag and CRC ending each commit
+static const size_t CtzStructSize = 8;      // Head block and size of a file out of its directory
+static const size_t SuperblockSize = TagSize + 8 + TagSize + 24;    // "littlefs" name and superblock struct
+
+void setFlashModel(LfsModel* m) {
+    model = m;
+}
+
+LfsModel* flashModel() {
+    return model;
+}
+
+NorFlash::NorFlash(const NorGeometry& geometry, WearStats& stats)
+    : _geometry(geometry), _erases(geometry.blockCount, 0), _fill(geometry.blockCount, 0), _stats(stats) {}
+
+void NorFlash::erase(uint32_t block) {
+    if (block >= _geometry.blockCount)
+        return;
+    _erases[block]++;
+    _fill[block] = 0;
+    _stats.erases++;
+}
+
+/**
+ * Bytes before the block's fill have been programmed since its last erase, programming them again is a violation.
+ */
+void NorFlash::program(uint32_t block, uint32_t offset, uint32_t length) {
+    if (block >= _geometry.blockCount)
+        return;
+    length = std::min(length, _geometry.blockSize - std::min(offset, _geometry.blockSize));
+    if (offset < _fill[block])
+        _stats.programViolations++;
+    _fill[block] = std::max(_fill[block], offset + length);
+    _stats.programmedBytes += length;
+}
+
+void NorFlash::read(uint32_t length) {
+    _stats.readBytes += length;
+}
+
+/**
+ * Formatted partition : superblock and empty root directory in the metadata pair {0, 1}.
+ */
+LfsModel::LfsModel(const NorGeometry& geometry)
+    : _geometry(geometry), _flash(geometry, _stats), _used(geometry.blockCount, false),
+      _next(2), _pair{0, 1}, _metaFill(0), _revision(0), _expanded(false) {
+    _used[0] = _used[1] = true;
+    _flash.erase(0);
+    _flash.erase(1);
+    _metaFill = roundUp(TagSize + SuperblockSize + CrcSize);
+    _flash.program(_pair[0], 0, _metaFill);
+}
+
+/**
+ * File data held by a CTZ block, the pointers of the skip-list take 8 bytes on average.
+ */
+size_t LfsModel::dataPerBlock() const {
+    return _geometry.blockSize - 2 * TagSize;
+}
+
+/**
+ * littlefs programs whole prog units, the cache is padded when it is flushed.
+ */
+uint32_t LfsModel::roundUp(size_t length) const {
+    return (uint32_t)((length + _geometry.progSize - 1) / _geometry.progSize * _geometry.progSize);
+}
+
+/**
+ * Next free block after the previous allocation, wrapping around : the lookahead buffer of littlefs
+ * walks the partition the same way, which spreads the erases over the free blocks.
+ *
+ * @return The block, erased, NoBlock if the partition is full.
+ */
+uint32_t LfsModel::allocate() {
+    for (uint32_t i = 0; i < _geometry.blockCount; i++) {
+        uint32_t block = (_next + i) % _geometry.blockCount;
+        if (!_used[block]) {
+            _used[block] = true;
+            _next = (block + 1) % _geometry.blockCount;
+            _flash.erase(block);
+            return block;
+        }
+    }
+    _stats.outOfSpace++;
+    return NoBlock;
+}
+
+void LfsModel::release(uint32_t block) {
+    if (block < _geometry.blockCount)
+        _used[block] = false;
+}
+
+/**
+ * Appends a commit to the written block of the root's pair, compacting the pair first if it doesn't fit.
+ *
+ * @param length Bytes of the commit's tags and data, the CRC and the padding are added.
+ */
+void LfsModel::commit(size_t length) {
+    uint32_t size = roundUp(length + CrcSize);
+    if (_metaFill + size > _geometry.blockSize)
+        compact();
+    _flash.program(_pair[0], _metaFill, size);
+    _metaFill += size;
+    _stats.commits++;
+}
+
+/**
+ * Erases the other block of the pair and writes the live entries there. Every blockCycles revisions the
+ * block is replaced by a newly allocated one, and the first time the root leaves the superblock pair.
+ */
+void LfsModel::compact() {
+    size_t live = TagSize + CrcSize;    // Revision count
+    if (!_expanded)
+        live += SuperblockSize;
+    for (const auto& f : _files)
+        live += TagSize + f.first.size() + TagSize + (f.second.blocks.empty() ? f.second.size : CtzStructSize);
+
+    _stats.compactions++;
+    _revision++;
+
+    if (_geometry.blockCycles && _revision % ((_geometry.blockCycles + 1) | 1) == 0) {
+        uint32_t a = allocate();
+        uint32_t b = _expanded ? NoBlock : allocate();
+
+        if (!_expanded && a != NoBlock && b != NoBlock) {
+            _stats.relocations++;
+            _flash.erase(_pair[1]);
+            _flash.program(_pair[1], 0, roundUp(TagSize + SuperblockSize + TagSize + 8 + CrcSize));    // Superblock and tail of the root
+            _expanded = true;
+            _pair[0] = a;
+            _pair[1] = b;
+            _metaFill = roundUp(live - SuperblockSize);
+            _flash.program(_pair[0], 0, _metaFill);
+            return;
+        }
+        if (_expanded && a != NoBlock) {
+            _stats.relocations++;
+            release(_pair[1]);
+            _pair[1] = a;
+        }
+        else {
+            release(a);
+            release(b);
+            _flash.erase(_pair[1]);
+        }
+    }
+    else
+        _flash.erase(_pair[1]);
+
+    std::swap(_pair[0], _pair[1]);
+    _metaFill = roundUp(live);
+    _flash.program(_pair[0], 0, _metaFill);
+}
+
+/**
+ * Moves the written range of a file to new blocks, as lfs_file_flush() does : the block holding the
+ * first written byte is copied up to it into a new block (lfs_ctz_extend), the data follows, then what
+ * was past the written range. Blocks before it stay, those after are freed.
+ */
+void LfsModel::rewrite(FileState& file, size_t newSize) {
+    size_t per = dataPerBlock();
+    size_t from = std::min(file.dirtyFrom, file.size);
+    size_t first = std::min(file.blocks.empty() ? 0 : from / per, file.blocks.size());
+    size_t start = first * per;
+    size_t copied = from - std::min(from, start) + (file.size > file.dirtyEnd ? file.size - file.dirtyEnd : 0);
+
+    _stats.copiedBytes += copied;
+    _flash.read((uint32_t)copied);
+
+    for (size_t i = first; i < file.blocks.size(); i++)
+        release(file.blocks[i]);
+    file.blocks.resize(first);
+
+    for (size_t pos = start; pos < newSize; pos += per) {
+        uint32_t block = allocate();
+        size_t index = file.blocks.size();
+        size_t pointers = index ? TagSize * (__builtin_ctzll(index) + 1) : 0;
+
+        _flash.program(block, 0, roundUp(pointers + std::min(per, newSize - pos)));
+        file.blocks.push_back(block);
+    }
+}
+
+/**
+ * A file opened with "w" is truncated, one that doesn't exist yet is created by a commit right away.
+ *
+ * @param existed The file was there before the open.
+ */
+void LfsModel::open(const std::string& path, const char* mode, bool existed) {
+    if (mode[0] == 'r' && mode[1] != '+')
+        return;
+
+    FileState& f = _files[path];
+    if (!existed)
+        commit(TagSize + TagSize + path.size() + TagSize);
+
+    if (mode[0] == 'w' && existed) {
+        for (uint32_t block : f.blocks)
+            release(block);
+        f.blocks.clear();
+        f.size = 0;
+        f.dirtyFrom = 0;                // Committed empty on the next sync
+        f.dirtyEnd = 0;
+    }
+}
+
+void LfsModel::write(const std::string& path, size_t position, size_t length) {
+    if (!length)
+        return;
+
+    FileState& f = _files[path];
+    f.dirtyFrom = std::min(f.dirtyFrom, position);
+    f.dirtyEnd = std::max(f.dirtyEnd, position + length);
+    _stats.logicalBytes += length;
+}
+
+/**
+ * Sync or close : a small file is rewritten whole into the directory, a larger one gets its written
+ * range moved to new blocks and a commit of its new CTZ head.
+ */
+void LfsModel::sync(const std::string& path) {
+    auto it = _files.find(path);
+    if (it == _files.end() || it->second.dirtyFrom == SIZE_MAX)
+        return;
+
+    FileState& f = it->second;
+    size_t newSize = std::max(f.size, f.dirtyEnd);
+    size_t inlineMax = std::min(_geometry.cacheSize, _geometry.blockSize / 8);
+
+    if (f.blocks.empty() && newSize <= inlineMax)
+        commit(TagSize + newSize);
+    else {
+        rewrite(f, newSize);
+        commit(TagSize + CtzStructSize);
+    }
+
+    f.size = newSize;
+    f.dirtyFrom = SIZE_MAX;
+    f.dirtyEnd = 0;
+}
+
+void LfsModel::remove(const std::string& path) {
+    auto it = _files.find(path);
+    if (it == _files.end())
+        return;
+
+    for (uint32_t block : it->second.blocks)
+        release(block);
+    _files.erase(it);
+    commit(TagSize);
+}
+
+void LfsModel::rename(const std::string& pathFrom, const std::string& pathTo) {
+    auto it = _files.find(pathFrom);
+    if (it == _files.end())
+        return;
+
+    remove(pathTo);
+    FileState f = it->second;
+    _files.erase(pathFrom);
+    _files[pathTo] = f;
+    commit(TagSize + TagSize + pathTo.size() + TagSize + CtzStructSize + TagSize);
+}
+
+}
@@ -0,0 +1,124 @@
+/**
+ * File :      NorFlash.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Wear model of the LittleFS partition for the native (host) build. NorFlash counts
+ *             erases and programs of a NOR flash with the ESP32's geometry, LfsModel replays on it
+ *             what littlefs does for each file operation (metadata commits and compactions, inline
+ *             files, CTZ block copies, block allocation). Files still live in host directories :
+ *             the model only sees their operations, through the hooks of LittleFS.cpp.
+ *             It follows littlefs 2.x with esp_littlefs's default configuration, it is an estimate
+ *             of the flash traffic, not a byte exact copy of the on-disk format.
+*/
+#ifndef NORFLASH_H
+#define NORFLASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace nativehal {
+
+/**
+ * Flash and littlefs parameters, defaults are those of an ESP32 built with Arduino-ESP32.
+ */
+struct NorGeometry {
+    uint32_t blockSize = 4096;      // Erase unit (sector) of the SPI flash
+    uint32_t blockCount = 368;      // "spiffs" partition of the default partition table : 0x170000 bytes at 0x290000
+    uint32_t progSize = 128;        // esp_littlefs : CONFIG_LITTLEFS_WRITE_SIZE
+    uint32_t cacheSize = 512;       // esp_littlefs : CONFIG_LITTLEFS_CACHE_SIZE, also the largest inline file
+    uint32_t blockCycles = 512;     // esp_littlefs : CONFIG_LITTLEFS_BLOCK_CYCLES, erases before a metadata pair moves
+    uint32_t endurance = 100000;    // Erase cycles a sector is rated for
+};
+
+/**
+ * Flash traffic since the model was created.
+ */
+struct WearStats {
+    uint64_t logicalBytes = 0;      // Written by the application
+    uint64_t programmedBytes = 0;   // Programmed on the flash, metadata included
+    uint64_t readBytes = 0;         // Read back by littlefs itself, to copy data
+    uint64_t erases = 0;
+    uint64_t commits = 0;           // Metadata commits, one per sync of a modified file
+    uint64_t compactions = 0;       // Full metadata block rewritten into the other block of its pair
+    uint64_t relocations = 0;       // Metadata block moved after blockCycles compactions
+    uint64_t copiedBytes = 0;       // File data copied into a new block to append or overwrite
+    uint64_t programViolations = 0; // Programs of bytes that weren't erased, must stay 0
+    uint64_t outOfSpace = 0;        // Allocations that found no free block
+};
+
+/**
+ * NOR flash : erasing a block sets its bytes, programming can only clear bits of erased bytes.
+ * Blocks are programmed in order, as littlefs does, so an erased block is tracked by its fill.
+ */
+class NorFlash {
+private:
+    NorGeometry _geometry;
+    std::vector<uint32_t> _erases;
+    std::vector<uint32_t> _fill;    // Bytes programmed since the block's last erase
+    WearStats& _stats;
+
+public:
+    NorFlash(const NorGeometry& geometry, WearStats& stats);
+
+    void erase(uint32_t block);
+    void program(uint32_t block, uint32_t offset, uint32_t length);
+    void read(uint32_t length);
+
+    const std::vector<uint32_t>& erasesPerBlock() const { return _erases; }
+};
+
+/**
+ * littlefs on a NorFlash, with every file in the root directory.
+ */
+class LfsModel {
+private:
+    struct FileState {
+        size_t size = 0;
+        std::vector<uint32_t> blocks;   // CTZ skip-list, empty while the file is inline
+        size_t dirtyFrom = SIZE_MAX;    // Range written since the last sync
+        size_t dirtyEnd = 0;
+    };
+
+    NorGeometry _geometry;
+    WearStats _stats;
+    NorFlash _flash;
+    std::map<std::string, FileState> _files;
+    std::vector<bool> _used;
+    uint32_t _next;                 // Where the allocator looks for a free block
+    uint32_t _pair[2];              // Metadata pair of the root directory, [0] is written
+    uint32_t _metaFill;
+    uint32_t _revision;
+    bool _expanded;                 // Root moved out of the superblock pair
+
+    size_t dataPerBlock() const;
+    uint32_t roundUp(size_t length) const;
+    uint32_t allocate();
+    void release(uint32_t block);
+    void commit(size_t length);
+    void compact();
+    void rewrite(FileState& file, size_t newSize);
+
+public:
+    explicit LfsModel(const NorGeometry& geometry = NorGeometry());
+    LfsModel(const LfsModel &m) = delete;
+
+    void open(const std::string& path, const char* mode, bool existed);
+    void write(const std::string& path, size_t position, size_t length);
+    void sync(const std::string& path);
+    void remove(const std::string& path);
+    void rename(const std::string& pathFrom, const std::string& pathTo);
+
+    const NorGeometry& geometry() const { return _geometry; }
+    const WearStats& stats() const { return _stats; }
+    const std::vector<uint32_t>& erasesPerBlock() const { return _flash.erasesPerBlock(); }
+};
+
+void setFlashModel(LfsModel* model);   // LittleFS operations are reported to model, nullptr stops it
+LfsModel* flashModel();
+
+}
+
+#endif
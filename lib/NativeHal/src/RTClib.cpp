@@ -0,0 +1,165 @@
+#include "RTClib.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const uint8_t daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+/**
+ * Number of days since 2000/01/01, valid for 2001..2099.
+ */
+static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d) {
+    if (y >= 2000U)
+        y -= 2000U;
+    uint16_t days = d;
+    for (uint8_t i = 1; i < m; ++i)
+        days += daysInMonth[i - 1];
+    if (m > 2 && y % 4 == 0)
+        ++days;
+    return days + 365 * y + (y + 3) / 4 - 1;
+}
+
+static uint32_t time2ulong(uint16_t days, uint8_t h, uint8_t m, uint8_t s) {
+    return ((days * 24UL + h) * 60 + m) * 60 + s;
+}
+
+static uint8_t conv2d(const char* p) {
+    uint8_t v = 0;
+    if ('0' <= *p && *p <= '9')
+        v = *p - '0';
+    return 10 * v + *++p - '0';
+}
+
+DateTime::DateTime(uint32_t t) {
+    t -= SECONDS_FROM_1970_TO_2000;
+
+    ss = t % 60;
+    t /= 60;
+    mm = t % 60;
+    t /= 60;
+    hh = t % 24;
+    uint16_t days = t / 24;
+    uint8_t leap;
+    for (yOff = 0;; ++yOff) {
+        leap = yOff % 4 == 0;
+        if (days < 365U + leap)
+            break;
+        days -= 365 + leap;
+    }
+    for (m = 1; m < 12; ++m) {
+        uint8_t daysPerMonth = daysInMonth[m - 1];
+        if (leap && m == 2)
+            ++daysPerMonth;
+        if (days < daysPerMonth)
+            break;
+        days -= daysPerMonth;
+    }
+    d = days + 1;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec) {
+    if (year >= 2000U)
+        year -= 2000U;
+    yOff = year;
+    m = month;
+    d = day;
+    hh = hour;
+    mm = min;
+    ss = sec;
+}
+
+DateTime::DateTime(const char* date, const char* time) {
+    yOff = conv2d(date + 9);
+    switch (date[0]) {
+    case 'J': m = (date[1] == 'a') ? 1 : ((date[2] == 'n') ? 6 : 7); break;
+    case 'F': m = 2; break;
+    case 'A': m = date[2] == 'r' ? 4 : 8; break;
+    case 'M': m = date[2] == 'r' ? 3 : 5; break;
+    case 'S': m = 9; break;
+    case 'O': m = 10; break;
+    case 'N': m = 11; break;
+    case 'D': m = 12; break;
+    default: m = 0; break;
+    }
+    d = conv2d(date + 4);
+    hh = conv2d(time);
+    mm = conv2d(time + 3);
+    ss = conv2d(time + 6);
+}
+
+DateTime::DateTime(const char* iso8601dateTime) {
+    char ref[] = "2000-01-01T00:00:00";
+    size_t len = strlen(iso8601dateTime);
+    memcpy(ref, iso8601dateTime, len < sizeof(ref) - 1 ? len : sizeof(ref) - 1);
+    yOff = conv2d(ref + 2);
+    m = conv2d(ref + 5);
+    d = conv2d(ref + 8);
+    hh = conv2d(ref + 11);
+    mm = conv2d(ref + 14);
+    ss = conv2d(ref + 17);
+}
+
+bool DateTime::isValid() const {
+    if (yOff >= 100)
+        return false;
+    DateTime other(unixtime());
+    return yOff == other.yOff && m == other.m && d == other.d && hh == other.hh && mm == other.mm && ss == other.ss;
+}
+
+String DateTime::timestamp(timestampOpt opt) const {
+    char buffer[25];
+
+    switch (opt) {
+    case TIMESTAMP_TIME:
+        snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", hh, mm, ss);
+        break;
+    case TIMESTAMP_DATE:
+        snprintf(buffer, sizeof(buffer), "%u-%02d-%02d", 2000U + yOff, m, d);
+        break;
+    default:
+        snprintf(buffer, sizeof(buffer), "%u-%02d-%02dT%02d:%02d:%02d", 2000U + yOff, m, d, hh, mm, ss);
+    }
+    return String(buffer);
+}
+
+uint8_t DateTime::dayOfTheWeek() const {
+    uint16_t day = date2days(yOff, m, d);
+    return (day + 6) % 7;                       // Jan 1, 2000 is a Saturday, i.e. returns 6
+}
+
+uint32_t DateTime::secondstime() const {
+    return time2ulong(date2days(yOff, m, d), hh, mm, ss);
+}
+
+uint32_t DateTime::unixtime() const {
+    return secondstime() + SECONDS_FROM_1970_TO_2000;
+}
+
+DateTime DateTime::operator+(const TimeSpan& span) const {
+    return DateTime(unixtime() + span.totalseconds());
+}
+
+DateTime DateTime::operator-(const TimeSpan& span) const {
+    return DateTime(unixtime() - span.totalseconds());
+}
+
+TimeSpan DateTime::operator-(const DateTime& right) const {
+    return TimeSpan((int32_t)(unixtime() - right.unixtime()));
+}
+
+bool DateTime::operator<(const DateTime& right) const {
+    return unixtime() < right.unixtime();
+}
+
+bool DateTime::operator==(const DateTime& right) const {
+    return unixtime() == right.unixtime();
+}
+
+void RTC_DS3231::adjust(const DateTime& dt) {
+    nativehal::setRtcEpoch(dt.unixtime());
+}
+
+DateTime RTC_DS3231::now() {
+    nativehal::counters().rtcReads++;
+    return DateTime(nativehal::rtcEpoch());
+}
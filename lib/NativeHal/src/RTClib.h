@@ -0,0 +1,96 @@
+/**
+ * File :      RTClib.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   DateTime, TimeSpan and RTC_DS3231 with the same behaviour as Adafruit RTClib.
+ *             The DS3231 reads its time from the NativeHal virtual clock.
+*/
+#ifndef RTCLIB_H
+#define RTCLIB_H
+
+#include <cstdint>
+#include "Arduino.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class TimeSpan;
+
+/**
+ * Calendar date and time, valid from 2000 to 2099.
+ */
+class DateTime {
+public:
+    enum timestampOpt { TIMESTAMP_FULL, TIMESTAMP_TIME, TIMESTAMP_DATE };
+
+    DateTime(uint32_t t = SECONDS_FROM_1970_TO_2000);
+    DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+    DateTime(const char* date, const char* time);   // __DATE__, __TIME__
+    DateTime(const char* iso8601dateTime);          // 2020-06-25T15:29:37
+
+    bool isValid() const;
+    String timestamp(timestampOpt opt = TIMESTAMP_FULL) const;
+
+    uint16_t year() const { return 2000U + yOff; }
+    uint8_t month() const { return m; }
+    uint8_t day() const { return d; }
+    uint8_t hour() const { return hh; }
+    uint8_t minute() const { return mm; }
+    uint8_t second() const { return ss; }
+    uint8_t dayOfTheWeek() const;
+
+    uint32_t secondstime() const;
+    uint32_t unixtime() const;
+
+    DateTime operator+(const TimeSpan& span) const;
+    DateTime operator-(const TimeSpan& span) const;
+    TimeSpan operator-(const DateTime& right) const;
+    bool operator<(const DateTime& right) const;
+    bool operator>(const DateTime& right) const { return right < *this; }
+    bool operator<=(const DateTime& right) const { return !(*this > right); }
+    bool operator>=(const DateTime& right) const { return !(*this < right); }
+    bool operator==(const DateTime& right) const;
+    bool operator!=(const DateTime& right) const { return !(*this == right); }
+
+protected:
+    uint8_t yOff;
+    uint8_t m;
+    uint8_t d;
+    uint8_t hh;
+    uint8_t mm;
+    uint8_t ss;
+};
+
+/**
+ * Signed duration in seconds.
+ */
+class TimeSpan {
+public:
+    TimeSpan(int32_t seconds = 0) : _seconds(seconds) {}
+    TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+        : _seconds((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+
+    int16_t days() const { return _seconds / 86400L; }
+    int8_t hours() const { return _seconds / 3600 % 24; }
+    int8_t minutes() const { return _seconds / 60 % 60; }
+    int8_t seconds() const { return _seconds % 60; }
+    int32_t totalseconds() const { return _seconds; }
+
+    TimeSpan operator+(const TimeSpan& right) const { return TimeSpan(_seconds + right._seconds); }
+    TimeSpan operator-(const TimeSpan& right) const { return TimeSpan(_seconds - right._seconds); }
+
+protected:
+    int32_t _seconds;
+};
+
+/**
+ * DS3231 model : answers from NativeHal::rtcEpoch(), begin() fails when the RTC is marked absent.
+ */
+class RTC_DS3231 {
+public:
+    bool begin() { nativehal::waitInitLatency(nativehal::PeripheralRtc); return nativehal::rtcPresent(); }
+    void adjust(const DateTime& dt);
+    DateTime now();
+    bool lostPower() { return false; }
+};
+
+#endif
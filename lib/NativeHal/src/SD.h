@@ -0,0 +1,10 @@
+/**
+ * File :      SD.h
+ * Purpose :   Included by mSdCard.h on the device, everything used lives in SdFat.h.
+*/
+#ifndef SD_H
+#define SD_H
+
+#include "SdFat.h"
+
+#endif
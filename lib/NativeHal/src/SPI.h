@@ -0,0 +1,15 @@
+/**
+ * File :      SPI.h
+ * Purpose :   SPI bus stand-in, the SD card model in SdFat.h does not need a real bus.
+*/
+#ifndef SPI_H
+#define SPI_H
+
+class SPIClass {
+public:
+    void begin() {}
+};
+
+extern SPIClass SPI;
+
+#endif
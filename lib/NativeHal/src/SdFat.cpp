@@ -0,0 +1,153 @@
+#include "SdFat.h"
+
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+bool SdFile::open(const char* path, oflag_t oflag) {
+    nativehal::UncountedAllocations uncounted;
+    close();
+
+    std::string host = nativehal::hostPath("sd", path);
+    bool exists = std::filesystem::exists(host);
+    int access = oflag & O_ACCMODE;
+
+    if (!exists && !(oflag & O_CREAT))
+        return false;
+
+    const char* mode;
+    if (oflag & O_TRUNC || !exists)
+        mode = access == O_RDONLY ? "rb" : "w+b";
+    else
+        mode = access == O_RDONLY ? "rb" : "r+b";
+
+    if (!exists && access == O_RDONLY) {       // O_CREAT | O_RDONLY still creates the file
+        FILE* created = fopen(host.c_str(), "wb");
+        if (!created)
+            return false;
+        fclose(created);
+    }
+
+    _fp = fopen(host.c_str(), mode);
+    if (!_fp)
+        return false;
+
+    _append = oflag & O_APPEND;
+    nativehal::counters().fileOpens++;
+    nativehal::waitFileLatency();
+    return true;
+}
+
+bool SdFile::close() {
+    if (!_fp)
+        return false;
+    fclose(_fp);
+    _fp = nullptr;
+    nativehal::counters().fileCloses++;
+    return true;
+}
+
+size_t SdFile::write(const uint8_t* buffer, size_t size) {
+    if (!_fp)
+        return 0;
+    if (_append)
+        fseek(_fp, 0, SEEK_END);
+    size_t allowed = nativehal::writeAllowance(size);
+    size_t n = allowed ? fwrite(buffer, 1, allowed, _fp) : 0;
+    nativehal::counters().bytesWritten += n;
+    if (n < size) {
+        fflush(_fp);
+        nativehal::shortWrite();
+    }
+    return n;
+}
+
+int SdFile::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int SdFile::read(void* buffer, size_t size) {
+    if (!_fp)
+        return -1;
+    size_t n = fread(buffer, 1, size, _fp);
+    nativehal::counters().bytesRead += n;
+    return (int)n;
+}
+
+/**
+ * Same contract as SdFat : reads at most num - 1 characters, stops after the
+ * delimiter (default '\n', kept in str), returns the length or 0 at end of file.
+ */
+int SdFile::fgets(char* str, int num, char* delim) {
+    int n = 0;
+    int c;
+    while (n < num - 1 && (c = read()) >= 0) {
+        str[n++] = (char)c;
+        if (delim ? strchr(delim, c) != nullptr : c == '\n')
+            break;
+    }
+    str[n] = 0;
+    return n;
+}
+
+bool SdFile::seekSet(uint32_t pos) {
+    return _fp && fseek(_fp, pos, SEEK_SET) == 0;
+}
+
+bool SdFile::seekEnd(int32_t offset) {
+    return _fp && fseek(_fp, offset, SEEK_END) == 0;
+}
+
+uint32_t SdFile::curPosition() const {
+    return _fp ? (uint32_t)ftell(_fp) : 0;
+}
+
+uint32_t SdFile::fileSize() const {
+    if (!_fp)
+        return 0;
+    long pos = ftell(_fp);
+    fseek(_fp, 0, SEEK_END);
+    long end = ftell(_fp);
+    fseek(_fp, pos, SEEK_SET);
+    return (uint32_t)end;
+}
+
+bool SdFile::truncate(uint32_t length) {
+    if (!_fp)
+        return false;
+    fflush(_fp);
+    if (ftruncate(fileno(_fp), length) != 0)
+        return false;
+    return fseek(_fp, length, SEEK_SET) == 0;
+}
+
+bool SdFile::sync() {
+    return _fp && fflush(_fp) == 0;
+}
+
+bool SdFat::begin(uint8_t csPin, uint32_t maxSck) {
+    (void)csPin; (void)maxSck;
+    nativehal::waitInitLatency(nativehal::PeripheralSd);
+    std::error_code ec;
+    std::filesystem::create_directories(nativehal::hostPath("sd", "/"), ec);
+    return !ec;
+}
+
+bool SdFat::exists(const char* path) {
+    nativehal::UncountedAllocations uncounted;
+    return std::filesystem::exists(nativehal::hostPath("sd", path));
+}
+
+bool SdFat::remove(const char* path) {
+    nativehal::UncountedAllocations uncounted;
+    std::error_code ec;
+    return std::filesystem::remove(nativehal::hostPath("sd", path), ec);
+}
+
+bool SdFat::rename(const char* oldPath, const char* newPath) {
+    nativehal::UncountedAllocations uncounted;
+    std::error_code ec;
+    std::filesystem::rename(nativehal::hostPath("sd", oldPath), nativehal::hostPath("sd", newPath), ec);
+    return !ec;
+}
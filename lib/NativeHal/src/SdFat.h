@@ -0,0 +1,68 @@
+/**
+ * File :      SdFat.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   SdFat 2.x API subset backed by a host directory (see NativeHal::hostPath).
+*/
+#ifndef SDFAT_H
+#define SDFAT_H
+
+#include <cstdio>
+#include <fcntl.h>
+#include "Arduino.h"
+
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+#ifndef O_WRITE
+#define O_WRITE O_WRONLY
+#endif
+
+#define SD_SCK_MHZ(maxMhz) (1000000UL * (maxMhz))
+
+typedef int oflag_t;
+
+/**
+ * File on the simulated card, a single instance can be reopened as often as needed.
+ */
+class SdFile : public Print {
+private:
+    FILE* _fp = nullptr;
+    bool _append = false;
+
+public:
+    SdFile() = default;
+    SdFile(const SdFile&) = delete;
+    ~SdFile() { close(); }
+
+    bool open(const char* path, oflag_t oflag = O_RDONLY);
+    bool close();
+    bool isOpen() const { return _fp != nullptr; }
+
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int read();
+    int read(void* buffer, size_t size);
+    int fgets(char* str, int num, char* delim = nullptr);
+
+    bool seekSet(uint32_t pos);
+    bool seekEnd(int32_t offset = 0);
+    uint32_t curPosition() const;
+    uint32_t fileSize() const;
+    int available() { return (int)(fileSize() - curPosition()); }
+    bool truncate(uint32_t length);
+    bool sync();
+};
+
+class SdFat {
+public:
+    bool begin(uint8_t csPin, uint32_t maxSck);
+    void initErrorPrint() { Serial.println("SD initialization failed."); }
+
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* oldPath, const char* newPath);
+};
+
+#endif
@@ -0,0 +1,15 @@
+/**
+ * File :      Wire.h
+ * Purpose :   I2C bus stand-in, the DS3231 model in RTClib.h does not need a real bus.
+*/
+#ifndef WIRE_H
+#define WIRE_H
+
+class TwoWire {
+public:
+    bool begin() { return true; }
+};
+
+extern TwoWire Wire;
+
+#endif
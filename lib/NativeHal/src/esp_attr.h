@@ -0,0 +1,15 @@
+/**
+ * File :      esp_attr.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Placement attributes of ESP-IDF. The host has no RTC memory : variables are plain
+ *             globals, zeroed at start, as after a cold boot.
+*/
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ * File :      esp_heap_caps.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Heap queries of ESP-IDF. The host models the DRAM heap of the ESP32 : a fixed
+ *             size from which the bytes malloc hands out since the start of the program are
+ *             taken. It doesn't fragment, the largest free block is all of the free bytes.
+*/
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_DEFAULT      (1 << 12)
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);     // Lowest free size seen by a query, on the host
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * File :      FreeRTOS.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   FreeRTOS pieces used by the firmware. Critical sections are spinlocks,
+ *             as on the dual-core ESP32. Tasks are declared in freertos/task.h.
+*/
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <atomic>
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  1
+#define pdFAIL                  0
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+typedef struct {
+    std::atomic<bool> locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {false}
+
+inline void vPortEnterCritical(portMUX_TYPE* mux) {
+    while (mux->locked.exchange(true, std::memory_order_acquire)) {}
+}
+
+inline void vPortExitCritical(portMUX_TYPE* mux) {
+    mux->locked.store(false, std::memory_order_release);
+}
+
+BaseType_t xPortGetCoreID();        // Core a task was pinned to, setup() and loop() run on core 1 as with the Arduino core
+
+#define portENTER_CRITICAL(mux)         vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)          vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)      vPortExitCritical(mux)
+
+#endif
@@ -0,0 +1,29 @@
+/**
+ * File :      task.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   FreeRTOS tasks on top of std::thread. Core affinity is only reported by
+ *             xPortGetCoreID(), priorities are ignored, ticks are real milliseconds (not the virtual clock).
+*/
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+#define tskNO_AFFINITY          0x7fffffff
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* parameters);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char* name, uint32_t stackDepth, void* parameters,
+                                   UBaseType_t priority, TaskHandle_t* createdTask, BaseType_t coreId);
+void vTaskDelete(TaskHandle_t task);            // Another task ends at its next vTaskDelay() or ulTaskNotifyTake()
+TaskHandle_t xTaskGetCurrentTaskHandle();       // A thread that isn't a task (e.g. the one running setup()) gets one too
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);    // Bytes of stack never used, as on the ESP32 (nullptr : the calling task)
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+
+#endif
@@ -0,0 +1,153 @@
+"""
+File :      size_report.py
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Static RAM and flash taken by each translation unit, read from the sections of its
+            object file : flash (code, constants, initial values), IRAM (code kept in RAM),
+            DRAM (initialized and zeroed variables) and RTC memory. Compared with a previous
+            report, it shows what grew, and can fail the build past a given growth.
+            As a PlatformIO extra script, adds the "size_report" target to every environment,
+            compared with the previous report of the same environment.
+
+Usage :     pio run -e esp32dev -t size_report
+            python3 scripts/size_report.py [--size TOOL] [--baseline report.json] [--save report.json]
+                                           [--max-growth BYTES] object_dir...
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+COLUMNS = ("flash", "iram", "dram", "rtc")
+
+# Section name prefixes, first match wins. Data sections are in flash (initial values) and in DRAM
+SECTIONS = (
+    ((".debug", ".comment", ".note", ".xt.", ".xtensa", ".group", ".rela", ".reloc", ".gnu", ".ARM."), ()),
+    ((".rtc",), ("rtc",)),
+    ((".iram",), ("flash", "iram")),
+    ((".data", ".sdata", ".dram", ".tdata"), ("flash", "dram")),
+    ((".bss", ".sbss", "COMMON", ".tbss"), ("dram",)),
+    ((".text", ".literal", ".rodata", ".flash", ".irom", ".eh_frame", ".gcc_except_table",
+      ".init_array", ".fini_array", ".ctors", ".dtors"), ("flash",)),
+)
+
+
+def classify(section):
+    for prefixes, columns in SECTIONS:
+        if section.startswith(prefixes):
+            return columns
+    return None
+
+
+def measure(size_tool, path):
+    """Bytes of each column for one object file, from the System V output of size."""
+    output = subprocess.run([size_tool, "-A", path], check=True, capture_output=True, text=True).stdout
+    usage = dict.fromkeys(COLUMNS, 0)
+    unknown = {}
+
+    for line in output.splitlines()[2:]:
+        fields = line.split()
+        if len(fields) < 2 or fields[0] == "Total" or not fields[1].isdigit():
+            continue
+        columns = classify(fields[0])
+        if columns is None:
+            unknown[fields[0]] = unknown.get(fields[0], 0) + int(fields[1])
+        for column in columns or ():
+            usage[column] += int(fields[1])
+
+    return usage, unknown
+
+
+def collect(size_tool, directories):
+    units = {}
+    unknown = {}
+    for directory in directories:
+        for root, _, files in os.walk(directory):
+            for name in sorted(files):
+                if not name.endswith(".o"):
+                    continue
+                path = os.path.join(root, name)
+                unit = os.path.relpath(path, directory)[:-2]
+                units[unit], sections = measure(size_tool, path)
+                for section, size in sections.items():
+                    unknown[section] = unknown.get(section, 0) + size
+    return units, unknown
+
+
+def growth(usage, previous):
+    """Bytes of RAM (IRAM, DRAM, RTC) and flash gained since the previous report."""
+    previous = previous or dict.fromkeys(COLUMNS, 0)
+    return {column: usage[column] - previous.get(column, 0) for column in COLUMNS}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Static RAM and flash per translation unit")
+    parser.add_argument("directories", nargs="+", help="directories holding the object files")
+    parser.add_argument("--size", default="size", help="size tool of the toolchain, e.g. xtensa-esp32-elf-size")
+    parser.add_argument("--baseline", help="previous report (JSON) to compare with")
+    parser.add_argument("--save", help="where to write this report (JSON)")
+    parser.add_argument("--max-growth", type=int, help="fail if a unit gains more than this many bytes of RAM or flash")
+    options = parser.parse_args()
+
+    units, unknown = collect(options.size, options.directories)
+    if not units:
+        print("No object file in " + ", ".join(options.directories) + ", build first.", file=sys.stderr)
+        return 1
+
+    baseline = {}
+    if options.baseline and os.path.exists(options.baseline):
+        with open(options.baseline) as f:
+            baseline = json.load(f)
+
+    print("%-40s %9s %9s %9s %7s   %s" % ("unit", "flash", "iram", "dram", "rtc", "since baseline" if baseline else ""))
+    totals = dict.fromkeys(COLUMNS, 0)
+    too_large = []
+
+    for unit in sorted(units, key=lambda u: (-(units[u]["dram"] + units[u]["iram"] + units[u]["rtc"]), -units[u]["flash"], u)):
+        usage = units[unit]
+        for column in COLUMNS:
+            totals[column] += usage[column]
+
+        delta = ""
+        if baseline:
+            d = growth(usage, baseline.get(unit))
+            delta = " ".join("%s %+d" % (column, d[column]) for column in COLUMNS if d[column]) or "="
+            if unit not in baseline:
+                delta = "new, " + delta
+            if options.max_growth is not None and max(d.values()) > options.max_growth:
+                too_large.append(unit)
+
+        print("%-40s %9d %9d %9d %7d   %s" % (unit, usage["flash"], usage["iram"], usage["dram"], usage["rtc"], delta))
+
+    print("%-40s %9d %9d %9d %7d" % ("total", totals["flash"], totals["iram"], totals["dram"], totals["rtc"]))
+    if baseline:
+        for unit in sorted(set(baseline) - set(units)):
+            print("%-40s removed" % unit)
+    if unknown:
+        print("Sections not counted : " + ", ".join("%s (%d)" % item for item in sorted(unknown.items())), file=sys.stderr)
+
+    if options.save:
+        with open(options.save, "w") as f:
+            json.dump(units, f, indent=1, sort_keys=True)
+
+    if too_large:
+        print("Grew by more than %d bytes : %s" % (options.max_growth, ", ".join(too_large)), file=sys.stderr)
+        return 1
+    return 0
+
+
+try:
+    Import("env")   # noqa: F821, run by PlatformIO
+except NameError:
+    sys.exit(main())
+else:
+    script = os.path.join("$PROJECT_DIR", "scripts", "size_report.py")
+    report = os.path.join("$BUILD_DIR", "size_report.json")
+    env.AddCustomTarget(   # noqa: F821
+        name="size_report",
+        dependencies="$BUILD_DIR/${PROGNAME}${PROGSUFFIX}",
+        actions=['"$PYTHONEXE" "%s" --size "%s" --baseline "%s" --save "%s" "$BUILD_DIR/src"'
+                 % (script, env.get("SIZETOOL", "size"), report, report)],   # noqa: F821
+        title="Size report",
+        description="Static RAM and flash per translation unit, against the previous report")
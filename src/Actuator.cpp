@@ -0,0 +1,187 @@
+#include "Actuator.h"
+
+#include <Arduino.h>
+
+/**
+ * Creates the timer, the pin must already be configured as output.
+ *
+ * @return True, if the operation was successful, false otherwise.
+ */
+bool Actuator::begin(){
+    esp_timer_create_args_t args = {};
+    args.callback = &Actuator::onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "actuator";
+
+    digitalWrite(_pin, LOW);
+
+    return esp_timer_create(&args, &_timer) == ESP_OK;
+}
+
+/**
+ * Energises the pin once, returns immediately. A pulse in progress is replaced.
+ *
+ * @param onMillis Duration of the pulse in milliseconds.
+ * @return True, if the pulse has been started, false otherwise.
+ */
+bool Actuator::pulse(uint32_t onMillis){
+    return pulseTrain(onMillis, 0, 1);
+}
+
+/**
+ * Energises the pin count times, returns immediately. A pulse in progress is replaced.
+ *
+ * @param onMillis Duration of each pulse in milliseconds.
+ * @param offMillis Time between two pulses in milliseconds.
+ * @param count Number of pulses, ACTUATOR_FOREVER to never stop.
+ * @return True, if the first pulse has been started, false otherwise.
+ */
+bool Actuator::pulseTrain(uint32_t onMillis, uint32_t offMillis, int32_t count){
+    if(!_timer || count == 0)
+        return false;
+
+    esp_timer_stop(_timer);
+
+    // A step() dispatched before the stop finds a later deadline and leaves this pulse alone
+    portENTER_CRITICAL(&_mux);
+    _onMicros = onMillis * 1000;
+    _offMicros = offMillis * 1000;
+    _pulsesLeft = count == ACTUATOR_FOREVER ? ACTUATOR_FOREVER : count - 1;
+    bool started = !_energised;
+    if(started)
+        energise();
+    _dueAt = micros() + _onMicros;
+    uint32_t onMicros = _onMicros;
+    portEXIT_CRITICAL(&_mux);
+
+    if(started)
+        writePin();
+
+    // The callback may have re-armed the timer between stop and now
+    if(esp_timer_start_once(_timer, onMicros) != ESP_OK){
+        esp_timer_stop(_timer);
+        return esp_timer_start_once(_timer, onMicros) == ESP_OK;
+    }
+    return true;
+}
+
+/**
+ * De-energises the pin and cancels what was planned.
+ */
+void Actuator::stop(){
+    if(_timer)
+        esp_timer_stop(_timer);
+
+    portENTER_CRITICAL(&_mux);
+    _pulsesLeft = 0;
+    bool released = _energised;
+    if(released)
+        release();
+    portEXIT_CRITICAL(&_mux);
+
+    if(released)
+        writePin();
+}
+
+/**
+ * True while a pulse is in progress or another one is planned.
+ */
+bool Actuator::busy() const{
+    portENTER_CRITICAL(&_mux);
+    bool busy = _energised || _pulsesLeft != 0;
+    portEXIT_CRITICAL(&_mux);
+    return busy;
+}
+
+bool Actuator::energised() const{
+    portENTER_CRITICAL(&_mux);
+    bool energised = _energised;
+    portEXIT_CRITICAL(&_mux);
+    return energised;
+}
+
+void Actuator::onTimer(void* arg){
+    static_cast<Actuator*>(arg)->step();
+}
+
+/**
+ * End of a pulse or of a pause, runs in the timer task.
+ */
+void Actuator::step(){
+    portENTER_CRITICAL(&_mux);
+
+    // Dispatched for a deadline pulseTrain() has replaced since
+    if((int32_t)(micros() - _dueAt) < 0){
+        portEXIT_CRITICAL(&_mux);
+        return;
+    }
+
+    bool more = _pulsesLeft != 0;
+    bool changed = _energised || more;
+    uint32_t next = _offMicros;
+
+    if(_energised)
+        release();
+    else if(more){
+        if(_pulsesLeft > 0)
+            _pulsesLeft--;
+        energise();
+        next = _onMicros;
+    }
+
+    if(more)
+        _dueAt = micros() + next;
+    portEXIT_CRITICAL(&_mux);
+
+    if(changed)
+        writePin();
+
+    if(more)
+        esp_timer_start_once(_timer, next);
+}
+
+/**
+ * Starts a pulse, called with _mux taken. writePin() sets the pin once it is released.
+ */
+void Actuator::energise(){
+    _startedAt = micros();
+    _energised = true;
+}
+
+/**
+ * Ends a pulse, called with _mux taken. writePin() clears the pin once it is released.
+ */
+void Actuator::release(){
+    _energised = false;
+
+    uint32_t on = micros() - _startedAt;
+    _stats.pulses++;
+    _stats.lastOnMicros = on;
+    _stats.totalOnMicros += on;
+    if(on > _onMicros && on - _onMicros > _stats.maxOvershootMicros)
+        _stats.maxOvershootMicros = on - _onMicros;
+}
+
+/**
+ * Brings the pin to the state decided under _mux. digitalWrite() isn't called in the critical
+ * section (the host stand-in takes a lock the timer task holds), so the state is read again
+ * after the write : if the other task changed it meanwhile, its write may have come first.
+ */
+void Actuator::writePin(){
+    portENTER_CRITICAL(&_mux);
+    bool level = _energised;
+    portEXIT_CRITICAL(&_mux);
+
+    while(true){
+        digitalWrite(_pin, level ? HIGH : LOW);
+
+        portENTER_CRITICAL(&_mux);
+        bool wanted = _energised;
+        portEXIT_CRITICAL(&_mux);
+
+        if(wanted == level)
+            return;
+        level = wanted;
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * File :      Actuator.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Drives the lock pin without blocking. Pulses and pulse trains are timed by
+ *             an esp_timer one-shot, so loop() keeps running while the solenoid is energised.
+*/
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include <cstdint>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+#define ACTUATOR_FOREVER -1
+
+/**
+ * Timing of the pulses done so far, in microseconds.
+ */
+struct ActuatorStats {
+    uint32_t pulses;            // Completed pulses
+    uint32_t lastOnMicros;      // Measured duration of the last pulse
+    uint32_t maxOvershootMicros;// Worst (measured - requested) duration
+    uint64_t totalOnMicros;     // Time spent energised
+};
+
+class Actuator {
+private:
+    uint8_t _pin;
+    esp_timer_handle_t _timer = nullptr;
+    mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;   // Guards everything below, shared with the timer task
+
+    uint32_t _onMicros = 0;
+    uint32_t _offMicros = 0;
+    int32_t _pulsesLeft = 0;    // Pulses to start after the current one, ACTUATOR_FOREVER for no end
+    bool _energised = false;
+    uint32_t _startedAt = 0;
+    uint32_t _dueAt = 0;        // micros() at which the timer is expected to call step()
+    ActuatorStats _stats = {};
+
+    static void onTimer(void* arg);
+    void step();
+    void energise();
+    void release();
+    void writePin();
+
+public:
+    explicit Actuator(uint8_t pin) : _pin(pin) {}
+    Actuator(const Actuator &a) = delete;
+
+    bool begin();
+
+    bool pulse(uint32_t onMillis);
+    bool pulseTrain(uint32_t onMillis, uint32_t offMillis, int32_t count = ACTUATOR_FOREVER);
+    void stop();
+
+    bool busy() const;
+    bool energised() const;
+    const ActuatorStats& stats() const { return _stats; }
+};
+
+#endif
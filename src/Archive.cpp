@@ -0,0 +1,454 @@
+#include "Archive.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Checksum.h"
+#include "QuotaPolicy.h"
+#include "StorageController.h"
+
+static const char ArchiveMagic[4] = {'R', 'T', 'B', 'A'};
+
+static const uint8_t OtherFlags = 0x01;        // Set in the user varint when the record isn't a plain RecordActivation
+
+size_t ArchiveSegment::bodyOffset() const{
+    return offset + sizeof(ArchiveHeader) + header.userCount * sizeof(ArchiveTotal);
+}
+
+size_t ArchiveSegment::end() const{
+    return bodyOffset() + header.bodyLength;
+}
+
+/**
+ * Hands out the totals table of a segment, by blocks of ARCHIVE_TOTALS_CHUNK entries.
+ *
+ * @param storage Where the archive lives.
+ * @param fileName Archive file name.
+ * @param segment Segment found by forEachSegment(), or being read by it.
+ * @param visitor Called for each block of totals.
+ * @param context Passed as is to the visitor.
+ * @return True, if every entry has been visited, false otherwise (read error, or stopped by the visitor).
+ */
+template<typename Backend>
+bool readTotals(Backend& storage, std::string_view fileName, const ArchiveSegment& segment, TotalVisitor visitor, void* context){
+
+    ArchiveTotal chunk[ARCHIVE_TOTALS_CHUNK];
+    size_t offset = segment.offset + sizeof(ArchiveHeader);
+
+    for(size_t i = 0; i < segment.header.userCount; i += ARCHIVE_TOTALS_CHUNK){
+        size_t n = std::min((size_t)ARCHIVE_TOTALS_CHUNK, segment.header.userCount - i);
+
+        if(!storage.readBytes(fileName, offset + i * sizeof(ArchiveTotal), (uint8_t*)chunk, n * sizeof(ArchiveTotal)))
+            return false;
+        if(!visitor(chunk, n, context))
+            return false;
+    }
+    return true;
+}
+
+static bool crcTotals(const ArchiveTotal* totals, size_t count, void* context){
+    uint32_t& crc = *static_cast<uint32_t*>(context);
+    crc = crc32(totals, count * sizeof(ArchiveTotal), crc);
+    return true;
+}
+
+/**
+ * Reads the segment starting at offset. Its totals are read for the CRC, but not kept.
+ *
+ * @return True, if a complete and valid header is there, false otherwise (end of the archive, or torn segment).
+ */
+template<typename Backend>
+static bool readSegmentHead(Backend& storage, std::string_view fileName, size_t offset, size_t fileSize, ArchiveSegment& segment){
+
+    ArchiveHeader& h = segment.header;
+    segment.offset = offset;
+
+    if(offset + sizeof(h) > fileSize || !storage.readBytes(fileName, offset, (uint8_t*)&h, sizeof(h)))
+        return false;
+
+    if(memcmp(h.magic, ArchiveMagic, sizeof(h.magic)) != 0 || h.version != ARCHIVE_FORMAT_VERSION || segment.end() > fileSize)
+        return false;
+
+    uint32_t crc = crc32(&h, offsetof(ArchiveHeader, crc));
+
+    return readTotals(storage, fileName, segment, crcTotals, &crc) && h.crc == crc;
+}
+
+/**
+ * Hands out the header and totals of every segment, oldest first. Bodies aren't read.
+ * The archive ends at the first segment that isn't valid (torn by a power cut).
+ *
+ * @param storage Where the archive lives.
+ * @param fileName Archive file name.
+ * @param visitor Called for each segment, see SegmentVisitor.
+ * @param context Passed as is to the visitor.
+ * @return True, if every segment has been visited (none if the file doesn't exist), false if stopped by the visitor.
+ */
+template<typename Backend>
+bool forEachSegment(Backend& storage, std::string_view fileName, SegmentVisitor visitor, void* context){
+
+    size_t size;
+
+    if(!storage.fileExist(fileName) || !storage.fileSize(fileName, size))
+        return true;
+
+    ArchiveSegment segment;
+
+    for(size_t offset = 0; readSegmentHead(storage, fileName, offset, size, segment); offset = segment.end())
+        if(!visitor(segment, context))
+            return false;
+
+    return true;
+}
+
+/**
+ * Appends an unsigned LEB128 varint, 7 bits a byte.
+ *
+ * @return Bytes written, 5 at most.
+ */
+static size_t putVarint(uint8_t* out, uint32_t value){
+    size_t n = 0;
+    while(value >= 0x80){
+        out[n++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+ * Reads a varint written by putVarint().
+ *
+ * @return Bytes read, 0 if the varint doesn't end before end.
+ */
+static size_t getVarint(const uint8_t* in, const uint8_t* end, uint32_t& value){
+    value = 0;
+    for(size_t n = 0; n < 5 && in + n < end; n++){
+        value |= (uint32_t)(in[n] & 0x7F) << (7 * n);
+        if(!(in[n] & 0x80))
+            return n + 1;
+    }
+    return 0;
+}
+
+// Deltas are signed : the RTC can be set back between two records
+static uint32_t zigzag(int32_t v){ return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v){ return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+/**
+ * State of the compression of a registry : the users are found by a first pass, the body
+ * encoded by a second one into buffer and written at offset. The totals table is counted
+ * by blocks, the first one along with the body, the others by a pass each.
+ */
+template<typename Backend>
+struct Encoder {
+    Backend& archive;
+    std::string_view archiveName;
+    ArchiveHeader header;
+    uint32_t met[8];                                // Bitmap of the user letters met, the table is in their order
+    ArchiveTotal totals[ARCHIVE_TOTALS_CHUNK];      // Block of the table being counted
+    size_t first;                                   // Index in the table of totals[0]
+    uint32_t previous;
+    size_t offset;
+    uint8_t buffer[ARCHIVE_BUFFER_SIZE];
+    size_t used;
+};
+
+template<typename Backend>
+static bool isMet(const Encoder<Backend>& e, uint8_t user){
+    return e.met[user / 32] >> (user % 32) & 1;
+}
+
+/**
+ * @return Index in the table of a user met : the users met with a lower letter come before it.
+ */
+template<typename Backend>
+static size_t userIndex(const Encoder<Backend>& e, uint8_t user){
+    size_t i = __builtin_popcount(e.met[user / 32] & ((1u << (user % 32)) - 1));
+    for(size_t w = 0; w < user / 32; w++)
+        i += __builtin_popcount(e.met[w]);
+    return i;
+}
+
+/**
+ * Starts counting the block of the table that begins at index first.
+ *
+ * @return Entries of the block.
+ */
+template<typename Backend>
+static size_t startTotals(Encoder<Backend>& e, size_t first){
+    size_t n = std::min((size_t)ARCHIVE_TOTALS_CHUNK, e.header.userCount - first), i = 0;
+
+    e.first = first;
+    for(size_t user = 0; user <= UINT8_MAX && i < first + n; user++){
+        if(!isMet(e, user))
+            continue;
+        if(i >= first)
+            e.totals[i - first] = {(uint8_t)user, {0, 0, 0}, 0};
+        i++;
+    }
+    return n;
+}
+
+template<typename Backend>
+static void countTotal(Encoder<Backend>& e, size_t index){
+    if(index >= e.first && index < e.first + ARCHIVE_TOTALS_CHUNK)
+        e.totals[index - e.first].records++;
+}
+
+template<typename Backend>
+static bool findUsers(const RegistryRecord* records, size_t count, void* context){
+    Encoder<Backend>& e = *static_cast<Encoder<Backend>*>(context);
+
+    for(size_t k = 0; k < count; k++){
+        const RegistryRecord& r = records[k];
+        if(!r.isValid())
+            continue;                           // Left out, as the replay would refuse it
+
+        e.met[r.user / 32] |= 1u << (r.user % 32);
+
+        if(e.header.records++ == 0){
+            e.header.firstEpoch = r.epoch;
+            e.header.minEpoch = r.epoch;
+            e.header.maxEpoch = r.epoch;
+        }
+        e.header.minEpoch = std::min(e.header.minEpoch, r.epoch);
+        e.header.maxEpoch = std::max(e.header.maxEpoch, r.epoch);
+    }
+    return true;
+}
+
+template<typename Backend>
+static bool countRecords(const RegistryRecord* records, size_t count, void* context){
+    Encoder<Backend>& e = *static_cast<Encoder<Backend>*>(context);
+
+    for(size_t k = 0; k < count; k++)
+        if(records[k].isValid())
+            countTotal(e, userIndex(e, records[k].user));
+    return true;
+}
+
+template<typename Backend>
+static bool flushBody(Encoder<Backend>& e){
+    if(e.used == 0)
+        return true;
+
+    bool ok = e.archive.writeBytes(e.archiveName, e.offset, e.buffer, e.used);
+    e.header.bodyCrc = crc32(e.buffer, e.used, e.header.bodyCrc);
+    e.header.bodyLength += e.used;
+    e.offset += e.used;
+    e.used = 0;
+    return ok;
+}
+
+template<typename Backend>
+static bool encodeRecords(const RegistryRecord* records, size_t count, void* context){
+    Encoder<Backend>& e = *static_cast<Encoder<Backend>*>(context);
+
+    for(size_t k = 0; k < count; k++){
+        const RegistryRecord& r = records[k];
+        if(!r.isValid())
+            continue;
+
+        if(e.used + 11 > sizeof(e.buffer) && !flushBody(e))     // 5 bytes of delta, 5 of user, 1 of flags at most
+            return false;
+
+        bool other = r.flags != RecordActivation;
+        size_t index = userIndex(e, r.user);
+
+        e.used += putVarint(e.buffer + e.used, zigzag((int32_t)(r.epoch - e.previous)));
+        e.used += putVarint(e.buffer + e.used, (uint32_t)index << 1 | (other ? OtherFlags : 0));
+        if(other)
+            e.buffer[e.used++] = r.flags;
+
+        countTotal(e, index);
+        e.previous = r.epoch;
+    }
+    return true;
+}
+
+static bool findLast(const ArchiveSegment& segment, void* context){
+    *static_cast<ArchiveSegment*>(context) = segment;
+    return true;
+}
+
+/**
+ * Compresses a registry into a new segment at the end of the archive, unless it is already
+ * its newest segment. Two passes over the registry, by blocks, and one more for each block of
+ * the totals table after the first : memory use depends neither on its size nor on the users.
+ * The header is written last, so an interrupted segment is ignored by the readers and written
+ * again, over it, by the next call.
+ *
+ * @param usage Where the registry lives.
+ * @param registryName Registry file name, e.g. the slot of the month that ended.
+ * @param archive Where the archive lives.
+ * @param archiveName Archive file name, created if needed.
+ * @return True, if the registry is in the archive, false otherwise (invalid registry, more than UINT8_MAX users, write error).
+ */
+template<typename Usage, typename Archive>
+bool archiveRegistry(Usage& usage, std::string_view registryName, Archive& archive, std::string_view archiveName){
+
+    RegistryHeader registry;
+
+    if(!readRegistryHeader(usage, registryName, registry))
+        return false;
+
+    Encoder<Archive> e{archive, archiveName, {}, {}, {}, 0, 0, 0, {}, 0};
+    memcpy(e.header.magic, ArchiveMagic, sizeof(e.header.magic));
+    e.header.version = ARCHIVE_FORMAT_VERSION;
+    e.header.generation = registry.generation;
+
+    if(!forEachRecord(usage, registryName, 0, findUsers<Archive>, &e))
+        return false;
+
+    size_t users = 0;
+    for(uint32_t word : e.met)
+        users += __builtin_popcount(word);
+    if(users > UINT8_MAX)
+        return false;
+
+    e.header.userCount = users;
+    e.header.quotaPeriod = registry.quotaPeriod ? registry.quotaPeriod : e.header.records ? quotaPeriodOf(e.header.firstEpoch) : 0;
+
+    // Already there : archived before a power cut, or at the renewal before this boot
+    ArchiveSegment last;
+    last.offset = 0;
+    last.header = {};
+    forEachSegment(archive, archiveName, findLast, &last);
+
+    bool empty = last.header.version == 0;
+    if(!empty && last.header.generation == e.header.generation && last.header.quotaPeriod == e.header.quotaPeriod
+        && last.header.records == e.header.records)
+        return true;
+
+    size_t start = empty ? 0 : last.end();
+    size_t head = sizeof(ArchiveHeader) + e.header.userCount * sizeof(ArchiveTotal);
+    uint8_t blank[sizeof(ArchiveHeader)] = {};
+
+    // Placeholder header and totals, that readers stop at, until the body is complete
+    for(size_t at = 0; at < head; at += sizeof(blank))
+        if(!archive.writeBytes(archiveName, start + at, blank, std::min(sizeof(blank), head - at)))
+            return false;
+
+    e.offset = start + head;
+    e.previous = e.header.firstEpoch;
+    size_t n = startTotals(e, 0);
+
+    if(!forEachRecord(usage, registryName, 0, encodeRecords<Archive>, &e) || !flushBody(e))
+        return false;
+
+    uint32_t crc = crc32(&e.header, offsetof(ArchiveHeader, crc));
+
+    while(n > 0){
+        if(!archive.writeBytes(archiveName, start + sizeof(ArchiveHeader) + e.first * sizeof(ArchiveTotal), (const uint8_t*)e.totals, n * sizeof(ArchiveTotal)))
+            return false;
+        crc = crc32(e.totals, n * sizeof(ArchiveTotal), crc);
+
+        if(e.first + n == e.header.userCount)
+            break;
+        n = startTotals(e, e.first + n);
+        if(!forEachRecord(usage, registryName, 0, countRecords<Archive>, &e))
+            return false;
+    }
+
+    e.header.crc = crc;
+    return archive.writeBytes(archiveName, start, (const uint8_t*)&e.header, sizeof(ArchiveHeader));
+}
+
+/**
+ * User letters of a totals table, by index.
+ */
+struct TableLetters {
+    uint8_t letters[UINT8_MAX];
+    size_t count;
+};
+
+static bool copyLetters(const ArchiveTotal* totals, size_t count, void* context){
+    TableLetters& t = *static_cast<TableLetters*>(context);
+    for(size_t i = 0; i < count; i++)
+        t.letters[t.count++] = totals[i].user;
+    return true;
+}
+
+/**
+ * Decodes the records of a segment, by blocks of REGISTRY_READ_CHUNK, as forEachRecord() does
+ * for the registry. The body CRC is checked once every record has been handed out.
+ *
+ * @param storage Where the archive lives.
+ * @param fileName Archive file name.
+ * @param segment Segment found by forEachSegment().
+ * @param visitor Called for each block of records.
+ * @param context Passed as is to the visitor.
+ * @return True, if every record has been visited and the body is intact, false otherwise.
+ */
+template<typename Backend>
+bool readSegment(Backend& storage, std::string_view fileName, const ArchiveSegment& segment, RecordVisitor visitor, void* context){
+
+    const ArchiveHeader& h = segment.header;
+    uint8_t buffer[ARCHIVE_BUFFER_SIZE];
+    RegistryRecord chunk[REGISTRY_READ_CHUNK];
+    const uint8_t* p = buffer;
+    const uint8_t* end = buffer;
+    size_t offset = segment.bodyOffset(), left = h.bodyLength, n = 0;
+    uint32_t crc = 0, epoch = h.firstEpoch, decoded = 0;
+    TableLetters table;
+
+    table.count = 0;
+    if(!readTotals(storage, fileName, segment, copyLetters, &table))
+        return false;
+
+    while(decoded < h.records){
+        // Keeps the buffer full enough for a whole record
+        if(end - p < 11 && left > 0){
+            size_t kept = end - p;
+            memmove(buffer, p, kept);
+
+            size_t read = std::min(left, sizeof(buffer) - kept);
+            if(!storage.readBytes(fileName, offset, buffer + kept, read))
+                return false;
+            crc = crc32(buffer + kept, read, crc);
+            offset += read;
+            left -= read;
+            p = buffer;
+            end = buffer + kept + read;
+        }
+
+        uint32_t delta, user;
+        size_t k;
+
+        if(!(k = getVarint(p, end, delta)))
+            return false;
+        p += k;
+        if(!(k = getVarint(p, end, user)) || (user >> 1) >= h.userCount)
+            return false;
+        p += k;
+
+        uint8_t flags = RecordActivation;
+        if(user & OtherFlags){
+            if(p == end)
+                return false;
+            flags = *p++;
+        }
+
+        epoch += unzigzag(delta);
+        chunk[n++] = RegistryRecord::make((char)table.letters[user >> 1], epoch, flags);
+        decoded++;
+
+        if((n == REGISTRY_READ_CHUNK || decoded == h.records) && !visitor(chunk, n, context))
+            return false;
+        if(n == REGISTRY_READ_CHUNK)
+            n = 0;
+    }
+
+    return p == end && left == 0 && crc == h.bodyCrc;
+}
+
+// Host tools go through Storage, the firmware moves the registry from its backend into the archive one
+template bool archiveRegistry(Storage&, std::string_view, Storage&, std::string_view);
+template bool archiveRegistry(RtbStorage::UsageStorage&, std::string_view, RtbStorage::ArchiveStorage&, std::string_view);
+template bool forEachSegment(Storage&, std::string_view, SegmentVisitor, void*);
+template bool forEachSegment(RtbStorage::ArchiveStorage&, std::string_view, SegmentVisitor, void*);
+template bool readTotals(Storage&, std::string_view, const ArchiveSegment&, TotalVisitor, void*);
+template bool readTotals(RtbStorage::ArchiveStorage&, std::string_view, const ArchiveSegment&, TotalVisitor, void*);
+template bool readSegment(Storage&, std::string_view, const ArchiveSegment&, RecordVisitor, void*);
+template bool readSegment(RtbStorage::ArchiveStorage&, std::string_view, const ArchiveSegment&, RecordVisitor, void*);
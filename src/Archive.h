@@ -0,0 +1,87 @@
+/**
+ * File :      Archive.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   History of the months that ended. At each renewal the registry of the month
+ *             that ended is compressed into a segment appended to the archive file, never
+ *             rewritten afterwards : timestamps as deltas to the previous record and users as
+ *             indexes in the segment's table, both as varints (3 bytes a record instead of 8
+ *             in the registry, 22 in the text lines). The table at the head of each segment
+ *             holds the records of every user, so monthly totals are read without the body, and
+ *             the header their time span, so queries skip the segment (see Audit.h).
+*/
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "Storage.h"
+#include "RegistryFormat.h"
+
+#define ARCHIVE_FORMAT_VERSION 2    // Layout of ArchiveHeader, ArchiveTotal and of the body
+#define ARCHIVE_BUFFER_SIZE 64      // Bytes of body encoded or decoded at once
+#define ARCHIVE_TOTALS_CHUNK 16     // Entries of the totals table read or written at once
+
+static_assert(UserCount <= UINT8_MAX, "UsersPrep has more users than the table of a segment can hold");
+
+/**
+ * First bytes of a segment, written last : its CRC covers it and the totals that follow.
+ */
+struct ArchiveHeader {
+    char magic[4];                  // "RTBA"
+    uint8_t version;
+    uint8_t userCount;              // Entries of the totals table after the header, in letter order
+    uint16_t reserved;
+    uint32_t generation;            // Of the registry the records come from, see RegistryHeader
+    uint32_t quotaPeriod;           // Month of the records, see quotaPeriodOf()
+    uint32_t firstEpoch;            // Unix time of the first record, the deltas start from it
+    uint32_t records;
+    uint32_t bodyLength;            // Bytes of encoded records after the totals
+    uint32_t bodyCrc;
+    uint32_t minEpoch;              // Oldest and newest records, so queries skip the segment without
+    uint32_t maxEpoch;              // decoding it (the RTC may have been set back during the month)
+    uint32_t crc;
+};
+
+/**
+ * Records of one user in a segment.
+ */
+struct ArchiveTotal {
+    uint8_t user;                   // User letter
+    uint8_t reserved[3];
+    uint32_t records;
+};
+
+static_assert(sizeof(ArchiveHeader) == 44, "ArchiveHeader must stay 44 bytes long");
+static_assert(sizeof(ArchiveTotal) == 8, "ArchiveTotal must stay 8 bytes long");
+
+/**
+ * A segment found in the archive, without its totals nor its body (see readTotals() and readSegment()).
+ */
+struct ArchiveSegment {
+    size_t offset;                  // Of its header in the file
+    ArchiveHeader header;
+
+    size_t bodyOffset() const;
+    size_t end() const;
+};
+
+/**
+ * Called by forEachSegment() for every segment, oldest first. Returning false stops the reading.
+ */
+typedef bool (*SegmentVisitor)(const ArchiveSegment& segment, void* context);
+
+/**
+ * Called by readTotals() for each block of the totals table. Returning false stops the reading.
+ */
+typedef bool (*TotalVisitor)(const ArchiveTotal* totals, size_t count, void* context);
+
+// Instantiated for Storage, and for the usage and archive storages of the firmware (see StorageController.h)
+template<typename Usage, typename Archive> bool archiveRegistry(Usage& usage, std::string_view registryName, Archive& archive, std::string_view archiveName);
+template<typename Backend> bool forEachSegment(Backend& storage, std::string_view fileName, SegmentVisitor visitor, void* context);
+template<typename Backend> bool readTotals(Backend& storage, std::string_view fileName, const ArchiveSegment& segment, TotalVisitor visitor, void* context);
+template<typename Backend> bool readSegment(Backend& storage, std::string_view fileName, const ArchiveSegment& segment, RecordVisitor visitor, void* context);
+
+#endif
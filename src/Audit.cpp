@@ -0,0 +1,469 @@
+#include "Audit.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "StorageController.h"
+
+/**
+ * The index no longer matches the registry (another slot, or unknown content) : the next query builds it again.
+ */
+void TimeIndex::invalidate(){
+    _built = false;
+}
+
+/**
+ * The registry has just been created empty.
+ */
+void TimeIndex::reset(){
+    _blockRecords = AUDIT_INDEX_BLOCK;
+    _records = 0;
+    _ordered = true;
+    _built = true;
+}
+
+/**
+ * Every block is used : two neighbours become one block twice as long.
+ */
+void TimeIndex::merge(){
+    for(size_t i = 0; i < AUDIT_INDEX_SIZE / 2; i++)
+        _blocks[i] = {std::min(_blocks[2 * i].minEpoch, _blocks[2 * i + 1].minEpoch),
+                      std::max(_blocks[2 * i].maxEpoch, _blocks[2 * i + 1].maxEpoch)};
+    _blockRecords *= 2;
+}
+
+/**
+ * Counts the record just appended to the registry. Ignored until the index has been built,
+ * the build reads it anyway.
+ *
+ * @param epoch Unix time of the record, 0 for a record that isn't valid (it matches no query).
+ * @return Void.
+ */
+void TimeIndex::add(uint32_t epoch){
+    if(!_built)
+        return;
+
+    if(_records == AUDIT_INDEX_SIZE * _blockRecords)
+        merge();
+
+    size_t b = _records / _blockRecords;
+    bool starts = _records % _blockRecords == 0;
+
+    // Older than the record before, or an invalid one whose empty span breaks the order of the blocks
+    if(epoch == 0 || (_records > 0 && epoch < _blocks[starts ? b - 1 : b].maxEpoch))
+        _ordered = false;
+
+    if(starts)
+        _blocks[b] = {epoch ? epoch : UINT32_MAX, epoch};
+    else if(epoch){
+        _blocks[b].minEpoch = std::min(_blocks[b].minEpoch, epoch);
+        _blocks[b].maxEpoch = std::max(_blocks[b].maxEpoch, epoch);
+    }
+    _records++;
+}
+
+static bool indexRecords(const RegistryRecord* records, size_t count, void* context){
+    TimeIndex& index = *static_cast<TimeIndex*>(context);
+
+    for(size_t k = 0; k < count; k++)
+        index.add(records[k].isValid() ? records[k].epoch : 0);
+    return true;
+}
+
+/**
+ * Indexes the whole registry, one pass by blocks of REGISTRY_READ_CHUNK.
+ *
+ * @param storage Where the registry lives.
+ * @param fileName Registry file name.
+ * @return True, if the registry has been read, false otherwise (the index stays unbuilt).
+ */
+template<typename Backend>
+bool TimeIndex::build(Backend& storage, std::string_view fileName){
+    reset();
+    if(forEachRecord(storage, fileName, 0, indexRecords, this))
+        return true;
+
+    _built = false;
+    return false;
+}
+
+/**
+ * Records of the registry that may be in [from, to) : only the blocks in between can hold some.
+ * Searched by halves while the records are in time order, else every block is looked at (in RAM).
+ *
+ * @param first Filled with the index of the first record to read.
+ * @param last Filled with the index after the last record to read, first if there is none.
+ * @return Void.
+ */
+void TimeIndex::candidates(uint32_t from, uint32_t to, size_t& first, size_t& last) const{
+    size_t blocks = (_records + _blockRecords - 1) / _blockRecords;
+    size_t begin = 0, end = 0;
+
+    if(_ordered){
+        const Block* b = _blocks;
+        begin = std::partition_point(b, b + blocks, [from](const Block& x){ return x.maxEpoch < from; }) - b;
+        end = std::partition_point(b + begin, b + blocks, [to](const Block& x){ return x.minEpoch < to; }) - b;
+    }
+    else{
+        begin = blocks;
+        for(size_t i = 0; i < blocks; i++)
+            if(_blocks[i].minEpoch < to && _blocks[i].maxEpoch >= from){
+                begin = std::min(begin, i);
+                end = i + 1;
+            }
+    }
+
+    first = std::min(begin * _blockRecords, _records);
+    last = std::max(first, std::min(end * _blockRecords, _records));
+}
+
+/**
+ * State of a query : the records that pass are gathered in chunk and handed out by blocks.
+ */
+struct AuditFilter {
+    uint32_t from;
+    uint32_t to;
+    char user;                      // 0 for every user
+    RecordVisitor visitor;
+    void* context;
+    AuditStats stats;
+    AuditCounts* counts;            // Count query : segments may be counted from their totals
+    RegistryRecord chunk[REGISTRY_READ_CHUNK];
+    size_t count;
+    bool stopped;                   // By the visitor
+    bool failed;                    // Read error
+};
+
+static bool flushFilter(AuditFilter& f){
+    bool ok = f.count == 0 || f.visitor(f.chunk, f.count, f.context);
+    f.count = 0;
+    f.stopped |= !ok;
+    return ok;
+}
+
+static bool filterRecords(const RegistryRecord* records, size_t count, void* context){
+    AuditFilter& f = *static_cast<AuditFilter*>(context);
+    f.stats.recordsRead += count;
+
+    for(size_t k = 0; k < count; k++){
+        const RegistryRecord& r = records[k];
+
+        if(!r.isValid() || r.epoch < f.from || r.epoch >= f.to || (f.user && r.user != (uint8_t)f.user))
+            continue;
+
+        f.chunk[f.count++] = r;
+        if(f.count == REGISTRY_READ_CHUNK && !flushFilter(f))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @return Column of a user letter in AuditCounts : its place in UsersPrep, UserCount if it isn't there (removed user).
+ */
+static size_t userColumn(uint8_t user){
+    size_t i = 0;
+    while(i < UserCount && (uint8_t)UsersPrep[i].username != user)
+        i++;
+    return i;
+}
+
+/**
+ * Bucket of a count query that a whole segment falls in.
+ */
+struct TotalsCount {
+    AuditCounts& counts;
+    size_t bucket;
+};
+
+static bool countTotals(const ArchiveTotal* totals, size_t count, void* context){
+    TotalsCount& t = *static_cast<TotalsCount*>(context);
+    for(size_t i = 0; i < count; i++)
+        t.counts.counts[t.bucket][userColumn(totals[i].user)] += totals[i].records;
+    return true;
+}
+
+/**
+ * Archive state while its segments are walked through.
+ */
+template<typename Usage, typename Archive>
+struct ArchiveWalk {
+    AuditStore<Usage, Archive>& store;
+    AuditFilter& filter;
+    uint32_t newestGeneration;      // Of the segments read, 0 if none
+};
+
+/**
+ * A count query doesn't need the body of a segment that lies in one of its buckets : the totals are enough.
+ */
+template<typename Usage, typename Archive>
+static bool countFromTotals(ArchiveWalk<Usage, Archive>& w, const ArchiveSegment& segment){
+    const ArchiveHeader& h = segment.header;
+    AuditFilter& f = w.filter;
+    AuditCounts* c = f.counts;
+
+    if(!c || f.user || h.minEpoch < f.from || h.maxEpoch >= f.to || (h.minEpoch - c->from) / c->width != (h.maxEpoch - c->from) / c->width)
+        return false;
+
+    TotalsCount t{*c, (h.minEpoch - c->from) / c->width};
+    if(!readTotals(*w.store.archive, w.store.archiveName, segment, countTotals, &t))
+        f.failed = true;
+    return true;
+}
+
+template<typename Usage, typename Archive>
+static bool walkSegment(const ArchiveSegment& segment, void* context){
+    ArchiveWalk<Usage, Archive>& w = *static_cast<ArchiveWalk<Usage, Archive>*>(context);
+    AuditFilter& f = w.filter;
+    const ArchiveHeader& h = segment.header;
+
+    w.newestGeneration = std::max(w.newestGeneration, h.generation);
+
+    if(h.records == 0 || h.maxEpoch < f.from || h.minEpoch >= f.to || countFromTotals(w, segment)){
+        f.stats.segmentsSkipped++;
+        return !f.failed;
+    }
+
+    f.stats.segmentsRead++;
+    if(!readSegment(*w.store.archive, w.store.archiveName, segment, filterRecords, &f)){
+        f.failed |= !f.stopped;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads records [first, last) of a registry through the filter.
+ */
+template<typename Backend>
+static bool walkRegistry(AuditFilter& f, Backend& storage, std::string_view fileName, size_t first, size_t last){
+    RegistryRecord chunk[REGISTRY_READ_CHUNK];
+
+    for(size_t i = first; i < last; i += REGISTRY_READ_CHUNK){
+        size_t n = std::min((size_t)REGISTRY_READ_CHUNK, last - i);
+
+        if(!readRecords(storage, fileName, i, chunk, n)){
+            f.failed = true;
+            return false;
+        }
+        if(!filterRecords(chunk, n, &f))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Goes through the history oldest first : the archive, the previous registry if it isn't
+ * archived yet, then the registry in use through its index (built if it isn't yet).
+ *
+ * @return True, if every source has been read and the visitor never stopped, false otherwise.
+ */
+template<typename Usage, typename Archive>
+static bool walkHistory(AuditStore<Usage, Archive>& store, AuditFilter& f){
+
+    ArchiveWalk<Usage, Archive> w{store, f, 0};
+
+    if(!forEachSegment(*store.archive, store.archiveName, walkSegment<Usage, Archive>, &w) || f.failed)
+        return false;
+
+    RegistryHeader current, previous;
+    std::string_view name = RegistrySlots[store.slot];
+    std::string_view previousName = RegistrySlots[1 - store.slot];
+    size_t count;
+
+    if(!readRegistryHeader(*store.usage, name, current)){
+        f.failed = true;
+        return false;
+    }
+
+    // The month that ended, when a power cut or a missing SD card kept it out of the archive
+    if(readRegistryHeader(*store.usage, previousName, previous) && previous.generation + 1 == current.generation
+        && previous.generation > w.newestGeneration && registryRecordCount(*store.usage, previousName, count)
+        && !walkRegistry(f, *store.usage, previousName, 0, count))
+        return false;
+
+    if(!store.index->built() && !store.index->build(*store.usage, name)){
+        f.failed = true;
+        return false;
+    }
+
+    size_t first, last;
+    store.index->candidates(f.from, f.to, first, last);
+
+    return walkRegistry(f, *store.usage, name, first, last) && flushFilter(f);
+}
+
+/**
+ * Hands out the records of [from, to), oldest first, by blocks as forEachRecord() does.
+ *
+ * @param store Where the history lives.
+ * @param from Unix time of the start of the range.
+ * @param to Unix time of its end, excluded.
+ * @param user Only the records of this user letter, 0 for every user.
+ * @param visitor Called for each block of records, returning false stops the query.
+ * @param context Passed as is to the visitor.
+ * @param stats Filled with what the query read, if not null.
+ * @return True, if the whole history has been gone through, false otherwise (read error, or stopped by the visitor).
+ */
+template<typename Usage, typename Archive>
+bool auditRecords(AuditStore<Usage, Archive>& store, uint32_t from, uint32_t to, char user, RecordVisitor visitor, void* context, AuditStats* stats){
+
+    AuditFilter f{from, to, user, visitor, context, {}, nullptr, {}, 0, false, false};
+    bool ok = walkHistory(store, f);
+
+    if(stats)
+        *stats = f.stats;
+    return ok;
+}
+
+static bool countRecords(const RegistryRecord* records, size_t count, void* context){
+    AuditCounts& c = *static_cast<AuditCounts*>(context);
+
+    for(size_t k = 0; k < count; k++)
+        c.counts[(records[k].epoch - c.from) / c.width][userColumn(records[k].user)]++;
+    return true;
+}
+
+/**
+ * Counts the records of each user in the buckets [from + i * width, from + (i + 1) * width) up to to.
+ *
+ * @param store Where the history lives.
+ * @param from Unix time of the start of the first bucket.
+ * @param to Unix time of the end of the range, excluded.
+ * @param width Length of a bucket in seconds, e.g. 604800 for weeks.
+ * @param counts Filled with the result.
+ * @param stats Filled with what the query read, if not null.
+ * @return True, if the whole history has been counted, false otherwise (more than AUDIT_MAX_BUCKETS buckets, read error).
+ */
+template<typename Usage, typename Archive>
+bool auditCounts(AuditStore<Usage, Archive>& store, uint32_t from, uint32_t to, uint32_t width, AuditCounts& counts, AuditStats* stats){
+
+    if(width == 0 || to <= from || (to - from - 1) / width >= AUDIT_MAX_BUCKETS)
+        return false;
+
+    memset(&counts, 0, sizeof(counts));
+    counts.from = from;
+    counts.width = width;
+    counts.buckets = (to - from - 1) / width + 1;
+
+    AuditFilter f{from, to, 0, countRecords, &counts, {}, &counts, {}, 0, false, false};
+    bool ok = walkHistory(store, f);
+
+    if(stats)
+        *stats = f.stats;
+    return ok;
+}
+
+/**
+ * Reads a date of a command : 2026-06-25T15:29:37, or only its start (2026-06-25, 2026-06).
+ */
+static bool parseDate(const char* text, uint32_t& epoch){
+    if(strlen(text) < 4)
+        return false;
+
+    DateTime date(text);
+    if(!date.isValid())
+        return false;
+
+    epoch = date.unixtime();
+    return true;
+}
+
+static bool printRecords(const RegistryRecord* records, size_t count, void* context){
+    Print& out = *static_cast<Print*>(context);
+    char text[32];
+
+    for(size_t k = 0; k < count; k++){
+        records[k].toText(text, sizeof(text));
+        out.println(text);
+    }
+    return true;
+}
+
+/**
+ * @return True, if a column of AuditCounts has records in any bucket.
+ */
+static bool columnUsed(const AuditCounts& counts, size_t column){
+    for(size_t b = 0; b < counts.buckets; b++)
+        if(counts.counts[b][column])
+            return true;
+    return false;
+}
+
+/**
+ * Runs a query typed on the serial port (or given to the host tool) and prints its result :
+ *   who FROM TO [USER]     records of [FROM, TO), as the text registry held them (e.g. a2020-06-25T15:29:37)
+ *   count FROM TO [DAYS]   records per user in buckets of DAYS days from FROM, 7 by default, ? for the removed users
+ * Dates are 2026-06-25T15:29:37, or a start of it (2026-06-25, 2026-06).
+ *
+ * @param store Where the history lives.
+ * @param line The command.
+ * @param out Where the result is printed.
+ * @return True, if the query has been answered, false otherwise (the reason is printed).
+ */
+template<typename Usage, typename Archive>
+bool runAuditCommand(AuditStore<Usage, Archive>& store, const char* line, Print& out){
+
+    char buffer[AUDIT_LINE_SIZE];
+    char* words[4] = {};
+    size_t n = 0;
+
+    strncpy(buffer, line, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+
+    for(char* w = strtok(buffer, " \t\r\n"); w && n < 4; w = strtok(nullptr, " \t\r\n"))
+        words[n++] = w;
+
+    uint32_t from, to;
+    bool who = n >= 3 && strcmp(words[0], "who") == 0;
+    bool count = n >= 3 && strcmp(words[0], "count") == 0;
+
+    if((!who && !count) || !parseDate(words[1], from) || !parseDate(words[2], to) || to <= from){
+        out.println("Usage : who FROM TO [USER] | count FROM TO [DAYS], dates as 2026-06-25T15:29:37 or 2026-06-25");
+        return false;
+    }
+
+    if(who){
+        if(!auditRecords(store, from, to, n > 3 ? words[3][0] : 0, printRecords, &out)){
+            out.println("Couldn't read the history.");
+            return false;
+        }
+        return true;
+    }
+
+    // Only the storage stage runs commands, one at a time : kept off its stack
+    static AuditCounts counts;
+    long days = n > 3 ? atol(words[3]) : 7;
+
+    if(days <= 0 || !auditCounts(store, from, to, (uint32_t)days * 86400, counts)){
+        out.println("Couldn't count : too many buckets, or the history couldn't be read.");
+        return false;
+    }
+
+    for(size_t b = 0; b < counts.buckets; b++){
+        out.print(DateTime(from + b * counts.width).timestamp(DateTime::TIMESTAMP_DATE).c_str());
+        for(size_t i = 0; i <= UserCount; i++){
+            if(!columnUsed(counts, i))
+                continue;
+            out.print(' ');
+            out.print(i < UserCount ? UsersPrep[i].username : '?');
+            out.print(':');
+            out.print((unsigned long)counts.counts[b][i]);
+        }
+        out.println();
+    }
+    return true;
+}
+
+// The host tools query any Storage, the serial command queries the storages of the firmware
+typedef AuditStore<RtbStorage::UsageStorage, RtbStorage::ArchiveStorage> FirmwareAuditStore;
+
+template bool TimeIndex::build(Storage&, std::string_view);
+template bool TimeIndex::build(RtbStorage::UsageStorage&, std::string_view);
+template bool auditRecords(AuditStore<>&, uint32_t, uint32_t, char, RecordVisitor, void*, AuditStats*);
+template bool auditRecords(FirmwareAuditStore&, uint32_t, uint32_t, char, RecordVisitor, void*, AuditStats*);
+template bool auditCounts(AuditStore<>&, uint32_t, uint32_t, uint32_t, AuditCounts&, AuditStats*);
+template bool auditCounts(FirmwareAuditStore&, uint32_t, uint32_t, uint32_t, AuditCounts&, AuditStats*);
+template bool runAuditCommand(AuditStore<>&, const char*, Print&);
+template bool runAuditCommand(FirmwareAuditStore&, const char*, Print&);
@@ -0,0 +1,98 @@
+/**
+ * File :      Audit.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Queries over the whole history, on the device (serial command) or on the host
+ *             (src/native/AuditCli.cpp) : the records of a time range, and the records per
+ *             user per bucket of time (e.g. per week). The archive segments outside the range
+ *             are skipped by their header, the registry in use is reached through a sparse
+ *             time index kept in RAM, so a query only reads the blocks of records it needs.
+*/
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <Arduino.h>
+
+#include "Storage.h"
+#include "RegistryFormat.h"
+#include "Archive.h"
+
+#define AUDIT_INDEX_SIZE 64         // Blocks of the time index, they are merged two by two when all are used
+#define AUDIT_INDEX_BLOCK 16        // Records of a block at first
+#define AUDIT_MAX_BUCKETS 32        // Buckets of a count query
+#define AUDIT_LINE_SIZE 64          // Characters of a serial command
+
+/**
+ * Sparse index of a registry : oldest and newest time of each block of records. Built by one
+ * pass over the registry the first time it is needed, then kept up to date on each append.
+ */
+class TimeIndex {
+private:
+    struct Block {
+        uint32_t minEpoch;
+        uint32_t maxEpoch;
+    };
+
+    Block _blocks[AUDIT_INDEX_SIZE];
+    size_t _blockRecords = AUDIT_INDEX_BLOCK;
+    size_t _records = 0;
+    bool _built = false;
+    bool _ordered = true;           // No record is older than the previous one, blocks can be searched by halves
+
+    void merge();
+
+public:
+    void invalidate();
+    void reset();
+    void add(uint32_t epoch);
+    template<typename Backend> bool build(Backend& storage, std::string_view fileName);
+    void candidates(uint32_t from, uint32_t to, size_t& first, size_t& last) const;
+
+    bool built() const{ return _built; }
+    size_t records() const{ return _records; }
+};
+
+/**
+ * Where the history lives : the registry slots, the index of the one in use and the archive.
+ * Any Storage by default (host tools), the storages of StorageController.h in the firmware.
+ */
+template<typename Usage = Storage, typename Archive = Storage>
+struct AuditStore {
+    Usage* usage;
+    size_t slot;                    // Registry in use, see RegistrySlots
+    TimeIndex* index;               // Of the registry in use
+    Archive* archive;
+    std::string_view archiveName;
+};
+
+/**
+ * Result of auditCounts() : records per user in each bucket of width seconds from from.
+ */
+struct AuditCounts {
+    uint32_t from;
+    uint32_t width;
+    size_t buckets;
+    uint32_t counts[AUDIT_MAX_BUCKETS][UserCount + 1];      // Same order as UsersPrep, then the letters it doesn't hold
+};
+
+/**
+ * Bytes and blocks a query went through, to compare it with a whole read.
+ */
+struct AuditStats {
+    uint32_t segmentsRead;          // Archive segments decoded
+    uint32_t segmentsSkipped;       // Archive segments outside the range, or counted from their totals
+    uint32_t recordsRead;           // Records decoded or read from a registry
+};
+
+template<typename Usage, typename Archive>
+bool auditRecords(AuditStore<Usage, Archive>& store, uint32_t from, uint32_t to, char user, RecordVisitor visitor, void* context, AuditStats* stats = nullptr);
+template<typename Usage, typename Archive>
+bool auditCounts(AuditStore<Usage, Archive>& store, uint32_t from, uint32_t to, uint32_t width, AuditCounts& counts, AuditStats* stats = nullptr);
+template<typename Usage, typename Archive>
+bool runAuditCommand(AuditStore<Usage, Archive>& store, const char* line, Print& out);
+
+#endif
@@ -0,0 +1,153 @@
+#include "BootSequence.h"
+
+#include <algorithm>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "MemoryStats.h"
+
+/**
+ * Starts the profile, at the very beginning of setup().
+ */
+void BootProfile::begin(){
+    _origin = std::chrono::steady_clock::now();
+    _count = 0;
+    _readyMicros = 0;
+}
+
+/**
+ * @return Microseconds since begin().
+ */
+uint32_t BootProfile::elapsed() const{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _origin).count();
+}
+
+/**
+ * Starts timing a phase.
+ *
+ * @param name Name of the phase, must outlive the profile (a literal).
+ * @return Number of the phase for end(), -1 if the profile is full.
+ */
+int BootProfile::start(const char* name){
+    if(_count == BOOT_PROFILE_SIZE)
+        return -1;
+
+    _phases[_count] = {name, elapsed(), 0, false};
+    return _count++;
+}
+
+/**
+ * A phase that waited for its turn starts now.
+ */
+void BootProfile::restart(int phase){
+    if(phase >= 0)
+        _phases[phase].startMicros = elapsed();
+}
+
+/**
+ * Ends a phase, may be called by another task than the one that started it.
+ */
+void BootProfile::end(int phase, bool ok){
+    if(phase < 0)
+        return;
+
+    _phases[phase].endMicros = elapsed();
+    _phases[phase].ok = ok;
+}
+
+/**
+ * The controller accepts codes from now on.
+ */
+void BootProfile::ready(){
+    _readyMicros = elapsed();
+}
+
+/**
+ * Prints the phases, one per line : name, start and end in microseconds since the start of setup().
+ */
+void BootProfile::print(Print& out) const{
+    for(size_t i = 0; i < _count; i++){
+        const BootPhase& p = _phases[i];
+        out.print(p.name);
+        out.print(' ');
+        out.print((unsigned long)p.startMicros);
+        out.print(' ');
+        out.print((unsigned long)p.endMicros);
+        out.println(p.ok ? " ok" : " failed");
+    }
+
+    out.print("ready ");
+    out.println((unsigned long)_readyMicros);
+}
+
+/**
+ * A step and what became of it.
+ */
+struct StepRun {
+    const BootStep* step;
+    BootProfile* profile;
+    int phase;
+    bool ok;
+    TaskHandle_t parent;            // Notified once the step is done, when it runs in a task
+};
+
+static void runStep(StepRun& r){
+    r.profile->restart(r.phase);
+    r.ok = r.step->run();
+    r.profile->end(r.phase, r.ok);
+}
+
+static void stepTask(void* parameters){
+    MemoryScope memoryScope(MemoryBoot);
+    StepRun& r = *static_cast<StepRun*>(parameters);
+
+    runStep(r);
+    xTaskNotifyGive(r.parent);
+    vTaskDelete(NULL);
+}
+
+/**
+ * Runs a group of independent steps. Concurrently, every step but the first gets a task and the
+ * first runs in the calling task, which then waits for the others. A step whose task can't be
+ * created runs in the calling task as well, after the first.
+ *
+ * @param steps Steps of the group, BOOT_PROFILE_SIZE at most.
+ * @param count Number of steps.
+ * @param profile Times each step.
+ * @param concurrently False runs them one after the other, in the calling task.
+ * @return True, if every step succeeded, false otherwise (the failure of each step that failed is logged).
+ */
+bool runBootSteps(const BootStep* steps, size_t count, BootProfile& profile, bool concurrently){
+
+    StepRun runs[BOOT_PROFILE_SIZE];
+    bool inTask[BOOT_PROFILE_SIZE] = {};
+    uint32_t tasks = 0;
+    TaskHandle_t self = concurrently ? xTaskGetCurrentTaskHandle() : nullptr;
+
+    count = std::min(count, (size_t)BOOT_PROFILE_SIZE);
+
+    for(size_t i = 0; i < count; i++){
+        runs[i] = {&steps[i], &profile, profile.start(steps[i].name), false, self};
+
+        if(concurrently && i > 0 && xTaskCreatePinnedToCore(stepTask, steps[i].name, BOOT_TASK_STACK_SIZE, &runs[i], BOOT_TASK_PRIORITY, nullptr, tskNO_AFFINITY) == pdPASS){
+            inTask[i] = true;
+            tasks++;
+        }
+    }
+
+    for(size_t i = 0; i < count; i++)
+        if(!inTask[i])
+            runStep(runs[i]);
+
+    for(uint32_t done = 0; done < tasks; )
+        done += ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    bool ok = true;
+    for(size_t i = 0; i < count; i++){
+        if(!runs[i].ok)
+            logEvent(runs[i].step->failure);
+        ok &= runs[i].ok;
+    }
+    return ok;
+}
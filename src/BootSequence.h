@@ -0,0 +1,71 @@
+/**
+ * File :      BootSequence.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Start of the peripherals that don't depend on each other (RTC over I2C, LittleFS
+ *             on the internal flash, SD card over SPI) at the same time, one task each, so the
+ *             boot waits for the slowest instead of their sum. Every phase of setup() is timed
+ *             into the boot profile, printed by the "boot" serial command and by the native build.
+*/
+#ifndef BOOTSEQUENCE_H
+#define BOOTSEQUENCE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+#include "EventLog.h"
+
+#define BOOT_PROFILE_SIZE 16        // Phases a boot profile holds, later ones aren't timed
+#define BOOT_TASK_STACK_SIZE 4096
+#define BOOT_TASK_PRIORITY 2
+
+/**
+ * One step of the boot, that only needs what was started before the group it belongs to.
+ */
+struct BootStep {
+    const char* name;
+    bool (*run)();
+    EventCode failure;              // Logged when run() fails
+};
+
+/**
+ * A timed phase, in microseconds since the start of setup().
+ */
+struct BootPhase {
+    const char* name;
+    uint32_t startMicros;
+    uint32_t endMicros;
+    bool ok;
+};
+
+/**
+ * Phases of the last boot. Times come from the steady clock, esp_timer on the ESP32, the
+ * host's clock on the native build (its virtual clock doesn't see tasks running side by side).
+ */
+class BootProfile {
+private:
+    std::chrono::steady_clock::time_point _origin;
+    BootPhase _phases[BOOT_PROFILE_SIZE];
+    size_t _count = 0;
+    uint32_t _readyMicros = 0;
+
+public:
+    void begin();
+    uint32_t elapsed() const;
+    int start(const char* name);
+    void restart(int phase);
+    void end(int phase, bool ok = true);
+    void ready();
+    void print(Print& out) const;
+
+    size_t count() const{ return _count; }
+    const BootPhase& phase(size_t i) const{ return _phases[i]; }
+    uint32_t readyMicros() const{ return _readyMicros; }
+};
+
+bool runBootSteps(const BootStep* steps, size_t count, BootProfile& profile, bool concurrently);
+
+#endif
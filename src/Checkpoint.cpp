@@ -0,0 +1,87 @@
+#include "Checkpoint.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "Checksum.h"
+#include "StorageController.h"
+
+static const char CheckpointMagic[4] = {'R', 'T', 'B', 'C'};
+
+/**
+ * Fills the identification fields and computes the CRC, to be called last before writing.
+ */
+void Checkpoint::seal(){
+    memcpy(magic, CheckpointMagic, sizeof(magic));
+    version = CHECKPOINT_FORMAT_VERSION;
+    reserved = 0;
+    userCount = UserCount;
+    crc = crc32(this, offsetof(Checkpoint, crc));
+}
+
+bool Checkpoint::isValid() const{
+    return memcmp(magic, CheckpointMagic, sizeof(magic)) == 0
+        && version == CHECKPOINT_FORMAT_VERSION
+        && userCount == UserCount
+        && crc == crc32(this, offsetof(Checkpoint, crc));
+}
+
+/**
+ * Seals and writes the checkpoint over the older copy, the newest one stays untouched.
+ * A failed write is tried again in the same copy at the next save.
+ *
+ * @param storage Where the checkpoint lives.
+ * @param fileName Checkpoint file name.
+ * @param checkpoint Counters to be saved, its sequence is increased.
+ * @return True, if the operation was successful, false otherwise.
+ */
+template<typename Backend>
+bool saveCheckpoint(Backend& storage, std::string_view fileName, Checkpoint& checkpoint){
+    checkpoint.sequence++;
+    checkpoint.seal();
+
+    // The first save goes to the first copy, the file never has a hole
+    size_t offset = (checkpoint.sequence - 1) % 2 * sizeof(checkpoint);
+
+    if(storage.writeBytes(fileName, offset, (const uint8_t*)&checkpoint, sizeof(checkpoint)))
+        return true;
+
+    checkpoint.sequence--;
+    return false;
+}
+
+/**
+ * Reads the newest valid copy of the checkpoint back.
+ *
+ * @param storage Where the checkpoint lives.
+ * @param fileName Checkpoint file name.
+ * @param checkpoint Filled with the saved counters.
+ * @return True, if a complete and valid checkpoint has been read, false otherwise (e.g. no save yet, other user setup).
+ */
+template<typename Backend>
+bool loadCheckpoint(Backend& storage, std::string_view fileName, Checkpoint& checkpoint){
+
+    size_t size;
+    Checkpoint copy;
+    bool found = false;
+
+    if(!storage.fileSize(fileName, size))
+        return false;
+
+    for(size_t offset = 0; offset + sizeof(copy) <= size && offset < 2 * sizeof(copy); offset += sizeof(copy)){
+        if(!storage.readBytes(fileName, offset, (uint8_t*)&copy, sizeof(copy)) || !copy.isValid())
+            continue;
+
+        if(!found || copy.sequence > checkpoint.sequence)
+            checkpoint = copy;
+        found = true;
+    }
+
+    return found;
+}
+
+// The checkpoint sits next to the registry : on its backend in the firmware, on any Storage in the host tools
+template bool saveCheckpoint(Storage&, std::string_view, Checkpoint&);
+template bool saveCheckpoint(RtbStorage::UsageStorage&, std::string_view, Checkpoint&);
+template bool loadCheckpoint(Storage&, std::string_view, Checkpoint&);
+template bool loadCheckpoint(RtbStorage::UsageStorage&, std::string_view, Checkpoint&);
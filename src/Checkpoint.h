@@ -0,0 +1,57 @@
+/**
+ * File :      Checkpoint.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Persisted snapshot of the users' counters, rewritten after every access.
+ *             Boot restores it in O(users) and only replays the registry records
+ *             written after it, instead of the whole registry.
+ *             The file holds two copies written in turn, a torn write only spoils the
+ *             one being written and boot falls back on the other.
+*/
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "Storage.h"
+#include "QuotaPolicy.h"
+
+#define CHECKPOINT_FORMAT_VERSION 3   // 3 : two copies, registry generation
+
+/**
+ * Counters of one user.
+ */
+struct CheckpointUser {
+    uint8_t user;               // User letter
+    uint8_t reserved;
+    uint16_t usedTokens;
+    uint32_t lastActivation;    // Unix time of the user's newest registry record
+    QuotaState quota;           // See QuotaPolicy.h
+};
+
+/**
+ * One copy of the checkpoint, written in one go and validated by its CRC.
+ */
+struct Checkpoint {
+    char magic[4];              // "RTBC"
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t userCount;
+    uint32_t sequence;          // Number of saves, tells the newest copy
+    uint32_t registryGeneration;// Registry the records below were counted in, see RegistryHeader
+    uint32_t quotaPeriod;       // Month the counters belong to, see quotaPeriodOf()
+    uint32_t registryRecords;   // Number of registry records already counted below
+    uint32_t lastActivation;    // Unix time of the newest registry record
+    CheckpointUser users[UserCount];
+    uint32_t crc;
+
+    void seal();
+    bool isValid() const;
+};
+
+// Instantiated for Storage and for the usage storage of the firmware (see StorageController.h)
+template<typename Backend> bool saveCheckpoint(Backend& storage, std::string_view fileName, Checkpoint& checkpoint);
+template<typename Backend> bool loadCheckpoint(Backend& storage, std::string_view fileName, Checkpoint& checkpoint);
+
+#endif
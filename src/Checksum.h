@@ -0,0 +1,15 @@
+/**
+ * File :      Checksum.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   CRC-32 (IEEE 802.3) used to validate what is read back from storage.
+*/
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+#endif
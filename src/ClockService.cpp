@@ -0,0 +1,136 @@
+#include "ClockService.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <esp_timer.h>
+
+#include "Trace.h"
+
+/**
+ * Reads the DS3231 a first time, otherwise the first call to now() does it.
+ *
+ * @return Void.
+ */
+void ClockService::begin(){
+    resync(esp_timer_get_time());
+}
+
+/**
+ * Current unix time. Reads the DS3231 only when a resync is due or has been requested.
+ * Not thread safe : called by the policy stage only (and setup() before it starts).
+ *
+ * @return Seconds since 1970/01/01.
+ */
+uint32_t ClockService::now(){
+    int64_t at = esp_timer_get_time();
+    _stats.calls++;
+
+    if(_resyncRequested.exchange(false) || !_started || at >= _nextResync)
+        resync(at);
+    else
+        _stats.savedReads++;
+
+    uint32_t epoch = extrapolate(at) / 1000000;
+    if(epoch < _lastEpoch)
+        epoch = _lastEpoch;
+    _lastEpoch = epoch;
+    return epoch;
+}
+
+/**
+ * The next call to now() reads the DS3231, e.g. after it has been set. Any task may call it.
+ *
+ * @return Void.
+ */
+void ClockService::requestResync(){
+    _resyncRequested = true;
+}
+
+/**
+ * Unix time at an esp_timer time, in us, from the last read and the measured drift.
+ */
+int64_t ClockService::extrapolate(int64_t at) const{
+    int64_t elapsed = at - _anchorMicros;
+    return _anchorEpochMicros + elapsed + elapsed * _stats.driftPpb / 1000000000;
+}
+
+/**
+ * Reads the DS3231 and corrects the extrapolation. A reading only says the time lies within
+ * [epoch, epoch + 1s), so the service keeps an interval the time lies in : the previous one,
+ * widened by what the drift may have added since, intersected with the second read.
+ * Readings taken at different phases of the second narrow it well below one second.
+ * The drift is measured between the base read and this one, the base moves to reads that
+ * know the time much better.
+ *
+ * @param at esp_timer time of the read.
+ * @return Void.
+ */
+void ClockService::resync(int64_t at){
+    uint32_t traceStart = traceCycles();
+    DateTime date = _rtc.now();
+    TRACE_RECORD(TraceRtcNow, traceStart, 0);
+
+    int64_t low = (int64_t)date.unixtime() * 1000000;
+    int64_t high = low + 999999;
+    int64_t predicted = extrapolate(at);
+    int64_t spread = _uncertaintyMicros + (at - _anchorMicros) * _driftUncertaintyPpb / 1000000000;
+
+    _stats.reads++;
+    _valid = date.isValid();
+    _nextResync = at + CLOCK_RESYNC_PERIOD_S * 1000000LL;
+
+    // First read, or the RTC has been set : start over from the middle of the second
+    if(!_started || predicted < low - CLOCK_STEP_THRESHOLD_S * 1000000LL || predicted > high + CLOCK_STEP_THRESHOLD_S * 1000000LL){
+        if(_started)
+            _stats.steps++;
+        _started = true;
+        _anchorMicros = at;
+        _anchorEpochMicros = low + 500000;
+        _uncertaintyMicros = 500000;
+        _baseMicros = at;
+        _baseEpochMicros = _anchorEpochMicros;
+        _baseUncertaintyMicros = _uncertaintyMicros;
+        _lastEpoch = 0;
+        _stats.uncertaintyMicros = _uncertaintyMicros;
+        return;
+    }
+
+    // Outside of the interval, the drift has been larger than thought : trust the reading
+    int64_t from = std::max(predicted - spread, low);
+    int64_t to = std::min(predicted + spread, high);
+    if(from > to){
+        from = low;
+        to = high;
+    }
+
+    int64_t corrected = (from + to) / 2;
+    int32_t correction = corrected - predicted;
+
+    _stats.lastCorrectionMicros = correction;
+    if((uint32_t)abs(correction) > _stats.maxCorrectionMicros)
+        _stats.maxCorrectionMicros = abs(correction);
+
+    _anchorMicros = at;
+    _anchorEpochMicros = corrected;
+    _uncertaintyMicros = (to - from) / 2;
+    _stats.uncertaintyMicros = _uncertaintyMicros;
+
+    // Kept only when it is better known than the one in use, none measured on the tick of the base read
+    int64_t baseline = at - _baseMicros;
+    if(baseline > 0){
+        int64_t driftUncertainty = (_baseUncertaintyMicros + _uncertaintyMicros) * 1000000000 / baseline;
+        if(driftUncertainty < _driftUncertaintyPpb){
+            double drift = (double)(corrected - _baseEpochMicros - baseline) / baseline * 1e9;
+            double bound = CLOCK_MAX_DRIFT_PPM * 1000.0;
+            _stats.driftPpb = drift < -bound ? -bound : (drift > bound ? bound : drift);
+            _driftUncertaintyPpb = driftUncertainty;
+        }
+    }
+
+    // The time is now known much better than at the base read, measure from here on
+    if(_uncertaintyMicros * 4 < _baseUncertaintyMicros){
+        _baseMicros = at;
+        _baseEpochMicros = corrected;
+        _baseUncertaintyMicros = _uncertaintyMicros;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * File :      ClockService.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Wall-clock time without an I2C transaction per call. The DS3231 is read at boot
+ *             and every CLOCK_RESYNC_PERIOD_S, in between the time is extrapolated from
+ *             esp_timer, corrected by the drift measured between the two clocks.
+*/
+#ifndef CLOCKSERVICE_H
+#define CLOCKSERVICE_H
+
+#include <atomic>
+#include <cstdint>
+#include "RTClib.h"
+
+#define CLOCK_RESYNC_PERIOD_S 600           // Time between two DS3231 reads
+#define CLOCK_STEP_THRESHOLD_S 2            // A reading further than this from the extrapolation is a new time (RTC adjusted)
+#define CLOCK_MAX_DRIFT_PPM 200             // Worst drift assumed until it has been measured, crystals are rated for less
+
+/**
+ * Reads of the DS3231 and how well the extrapolation followed it.
+ */
+struct ClockStats {
+    uint32_t calls;                 // now() calls
+    uint32_t reads;                 // DS3231 reads (I2C transactions)
+    uint32_t savedReads;            // Calls answered without reading the DS3231
+    uint32_t steps;                 // Readings that weren't close to the extrapolation, i.e. the RTC was set
+    int32_t driftPpb;               // Measured drift, how much faster the DS3231 runs than esp_timer (parts per billion)
+    int32_t lastCorrectionMicros;   // Error of the extrapolation fixed by the last read
+    uint32_t maxCorrectionMicros;   // Worst of them
+    uint32_t uncertaintyMicros;     // The time was known within +/- this much at the last read
+};
+
+class ClockService {
+private:
+    RTC_DS3231& _rtc;
+
+    int64_t _anchorMicros = 0;      // esp_timer time of the last read...
+    int64_t _anchorEpochMicros = 0; // ... the unix time it stood for, in us...
+    int64_t _uncertaintyMicros = 0; // ... within +/- this much
+    int64_t _baseMicros = 0;        // Same for the first read since boot or the last step, the drift is measured from it
+    int64_t _baseEpochMicros = 0;
+    int64_t _baseUncertaintyMicros = 0;
+    int64_t _driftUncertaintyPpb = CLOCK_MAX_DRIFT_PPM * 1000LL;
+    int64_t _nextResync = 0;
+    uint32_t _lastEpoch = 0;        // Last answer, time never goes back between two steps
+    bool _started = false;
+    bool _valid = false;
+    std::atomic<bool> _resyncRequested{false};
+    ClockStats _stats = {};
+
+    int64_t extrapolate(int64_t at) const;
+    void resync(int64_t at);
+
+public:
+    explicit ClockService(RTC_DS3231& rtc) : _rtc(rtc) {}
+    ClockService(const ClockService &c) = delete;
+
+    void begin();
+    uint32_t now();
+    void requestResync();
+
+    bool valid() const { return _valid; }
+    const ClockStats& stats() const { return _stats; }
+};
+
+#endif
@@ -1,5 +1,8 @@
 #pragma once
+#include <cstddef>
+#include <string_view>
 #include "RTClib.h"				// Library for RTC
+#include "QuotaPolicy.h"		// Per-user token policies
 
 /*******************************************
  * Section intended to be modified
@@ -9,11 +12,22 @@
  *  Make sure that no password are the same, number 1 to 3 only, any size is allowed.
  *  Username is one character only. */
 
-/** User parameters */
-struct UsersConfig { const char username; const std::string password; const int tokens;};
-const UsersConfig UsersPrep[] = {
+/** Tokens are per calendar month unless another policy is given, e.g. :
+ *    {'b', "2121", 4, RollingQuota(30)}                     4 tokens over any 30 days
+ *    {'c', "3311", 3, TokenBucket(7 * 86400)}               3 tokens at most, one more every week
+ *    {'d', "1232", 2, MonthlyQuota().during(8, 20)}         2 tokens per month, from 8h to 20h only
+ *  .activatedFor(seconds) replaces ActivatedTime after an access of that user. */
+
+/** User parameters, checked at compile time (see UserIndex.h and User.hpp) */
+struct UsersConfig { const char username; const char* password; const int tokens; const QuotaConfig quota = MonthlyQuota();};
+#ifndef RTB_SIM_USERS
+constexpr UsersConfig UsersPrep[] = {
 	{'a', "123123", (int)2 },
 };
+#else
+#include "native/SimUsers.hpp"		// Synthetic users of the host simulator (see platformio.ini)
+#endif
+constexpr size_t UserCount = sizeof(UsersPrep) / sizeof(UsersPrep[0]);
 
 /**
  * On first time use, set BOTH to "true" if it's your case, remember to change both to false afterwards
@@ -25,7 +39,7 @@ const UsersConfig UsersPrep[] = {
 /** Format littlefs so you can use internal memory */
 #define FORMAT_LITTLEFS_IF_FAILED false
 
-/** Is the amount of time before another token is needed to open the lock */
+/** Is the amount of time before another token is needed to open the lock (unless the user's policy says otherwise) */
 const TimeSpan ActivatedTime(1,0,0,0);
 
 /** 
@@ -34,17 +48,45 @@ const TimeSpan ActivatedTime(1,0,0,0);
 
 /**  Choose whether to log (everytime the safe box (RTB) gets open) in the internal memory instead of the sd card
  *   Also if set to true, don't forget to upload the filesystem (littlefs) */
+#ifndef USE_INTERNAL_MEMORY
 #define USE_INTERNAL_MEMORY true
+#endif
 
 /** Choose if you want to instantiate the sd card class or not,
  *  false also means that no log for errors will be created	*/
+#ifndef USE_SD_CARD
 #define USE_SD_CARD true
+#endif
 
 /** If you want debug information to be print in console */
 #define DEBUG_ENABLED false
 
-const std::string Registry = "registre.txt";			// Registry file name, where usage will be saved
-const std::string ErrorLog = "log.txt";					// Log file name (contains any occuring error)
+/** Run input, decision and storage as separate FreeRTOS tasks (see Pipeline.h), instead of one after the other in loop() */
+#ifndef USE_TASK_PIPELINE
+#define USE_TASK_PIPELINE true
+#endif
+
+/** Start the RTC and both storages side by side at boot, one task each (see BootSequence.h), instead of one after the other */
+#ifndef USE_PARALLEL_BOOT
+#define USE_PARALLEL_BOOT USE_TASK_PIPELINE
+#endif
+
+/** Record the hot path tracepoints (see Trace.h), well under a microsecond each. False compiles them out */
+#ifndef USE_TRACING
+#define USE_TRACING true
+#endif
+
+/** Count every operator new and delete under the tag of the code that runs (see MemoryStats.h), 8 bytes more per allocation */
+#ifndef USE_MEMORY_STATS
+#define USE_MEMORY_STATS true
+#endif
+
+constexpr std::string_view RegistrySlots[2] = {"registre.bin", "registre.b.bin"};	// Registry files, where usage will be saved, used in turn (see RegistryFormat.h)
+constexpr std::string_view LegacyRegistry = "registre.txt";		// Text registry of older versions, migrated once to the registry
+constexpr std::string_view UsageCheckpoint = "checkpoint.bin";	// Used tokens per user, saved after every access (see Checkpoint.h)
+constexpr std::string_view RegistryArchive = "archive.bin";		// Registries of the months that ended, compressed (see Archive.h)
+constexpr std::string_view ErrorLog = "log.bin";					// Log file name, the newest errors (see RingLog.h)
+constexpr std::string_view LegacyErrorLog = "log.txt";			// Text log of older versions, left as it is
 
 
 // Pins configuration
@@ -61,6 +103,9 @@ const std::string ErrorLog = "log.txt";					// Log file name (contains any occur
 
 #define SPI_SPEED_RATE SD_SCK_MHZ(21)   // Set SPI rate to 21MHz, otherwise SPI_FULL_SPEED causes to much distortion to the SPI signal
 
+#define MAX_CODE_LENGTH 32				// Longest code the keypad keeps, longer passwords can't be typed
+#define KEYPAD_SAMPLE_PERIOD_US 4000	// Keypad sampling period, a key must be stable for 4 samples (16 ms)
+
 /**
  * Use to represent RTB State : helps managing permission or problem.
  */
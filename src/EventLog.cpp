@@ -0,0 +1,188 @@
+#include "EventLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <esp_attr.h>
+
+#include "StorageController.h"
+
+static const uint32_t EventMagic = 0x52544245;     // "RTBE"
+
+/**
+ * Ring of RTC memory. Slots and drained are only read and written whole (32 bits), RTC memory
+ * doesn't take the atomic read-modify-write instructions : the reservation counter lives in RAM.
+ */
+struct EventRing {
+    uint32_t magic;                 // EventMagic once the ring has been set up, anything after a power-on
+    uint32_t drained;               // Events written to the error log, only drainEvents() changes it
+    struct Slot {
+        std::atomic<uint32_t> sequence;     // Number of the event plus one, 0 for an empty slot
+        Event event;
+    } slots[EVENT_RING_SIZE];
+};
+
+RTC_NOINIT_ATTR static EventRing ring;
+static std::atomic<uint32_t> head{0};              // Events reserved, counted from the same origin as drained
+static std::atomic<uint32_t> eventEpoch{0};
+
+static const char* const EventTexts[EventCodeCount] = {
+    "No event.",
+    "Reset, events of the previous run kept.",
+    "Couldn't start the lock timer.",
+    "Couldn't start the keypad timer.",
+    "Couldn't find RTC.",
+    "Couldn't initialize usage storage.",
+    "Couldn't initialize log storage.",
+    "Couldn't migrate the text registry file.",
+    "Couldn't create registry file.",
+    "Couldn't create log file.",
+    "Couldn't read data from registry file.",
+    "A record of the registry file isn't valid.",
+    "Cannot save the checkpoint file.",
+    "Couldn't start the tasks, running them in loop().",
+    "Cannot append a record in the registry file.",
+    "Couldn't start the registry of the new month.",
+    "Cannot write the buffered records.",
+    "RTC date is not valid.",
+    "Date in global variable \"lastActivation\" isn't valid, see the registry file.",
+    "Couldn't open the lock.",
+    "Events lost before they were written.",
+    "Couldn't archive the registry of the month that ended.",
+};
+
+/**
+ * Takes over the ring left by the previous run, or sets up an empty one after a power-on (RTC memory
+ * then holds anything). Called once, at boot, before any other function of this file.
+ *
+ * @return Number of events of the previous run still waiting to be drained.
+ */
+size_t beginEvents(){
+
+    uint32_t newest = 0;
+    bool valid = ring.magic == EventMagic;
+
+    for(uint32_t i = 0; valid && i < EVENT_RING_SIZE; i++){
+        uint32_t s = ring.slots[i].sequence.load(std::memory_order_relaxed);
+        valid = s == 0 || (s - 1) % EVENT_RING_SIZE == i;
+        newest = std::max(newest, s);
+    }
+
+    if(!valid || newest < ring.drained){
+        ring.magic = EventMagic;
+        ring.drained = 0;
+        for(EventRing::Slot& slot : ring.slots)
+            slot.sequence.store(0, std::memory_order_relaxed);
+        newest = 0;
+    }
+
+    head.store(newest, std::memory_order_relaxed);
+    return newest - ring.drained;
+}
+
+/**
+ * Stores an event, from any task. Doesn't allocate, doesn't wait : one atomic increment and 12 bytes written.
+ *
+ * @param code What happened, see EventCode.
+ * @param arg Detail of the event, see EventCode.
+ * @return Void.
+ */
+void logEvent(EventCode code, uint16_t arg){
+    uint32_t s = head.fetch_add(1, std::memory_order_relaxed);
+    EventRing::Slot& slot = ring.slots[s % EVENT_RING_SIZE];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    slot.event.epoch = eventEpoch.load(std::memory_order_relaxed);
+    slot.event.code = code;
+    slot.event.arg = arg;
+    slot.sequence.store(s + 1, std::memory_order_release);
+}
+
+/**
+ * Time given to the next events, logEvent() doesn't read the clock itself.
+ */
+void setEventTime(uint32_t epoch){
+    eventEpoch.store(epoch, std::memory_order_relaxed);
+}
+
+uint32_t pendingEvents(){
+    return head.load(std::memory_order_acquire) - ring.drained;
+}
+
+/**
+ * Writes the waiting events into the error log, EVENTS_PER_ENTRY per entry. Events overwritten
+ * before they could be drained are counted by an EventLost. An event still being written stops
+ * the drain, the next one takes it. Only one task may drain.
+ *
+ * @param log Error log.
+ * @return True, if the events have been written, false otherwise (they stay in RTC memory).
+ */
+template<typename Backend>
+bool drainEvents(RingLog<Backend>& log){
+
+    uint32_t end = head.load(std::memory_order_acquire);
+
+    while(ring.drained != end){
+        Event batch[EVENTS_PER_ENTRY];
+        size_t n = 0;
+        uint32_t next = ring.drained;
+
+        for(; n < EVENTS_PER_ENTRY && next != end; next++){
+            const EventRing::Slot& slot = ring.slots[next % EVENT_RING_SIZE];
+            uint32_t s = slot.sequence.load(std::memory_order_acquire);
+
+            if(s == next + 1){
+                batch[n] = slot.event;
+                s = slot.sequence.load(std::memory_order_acquire);     // Overwritten while it was copied ?
+            }
+
+            if(s == next + 1)
+                n++;
+            else if(s > next + 1 || s == 0){
+                if(s == 0 && end - next <= EVENT_RING_SIZE)
+                    break;                                          // Still being written
+                if(n > 0 && batch[n - 1].code == EventLost && batch[n - 1].arg < UINT16_MAX)
+                    batch[n - 1].arg++;
+                else
+                    batch[n++] = {eventEpoch.load(std::memory_order_relaxed), EventLost, 1};
+            }
+            else
+                break;                                              // Reserved, not written yet
+        }
+
+        if(n == 0)
+            return true;
+
+        if(!log.append(std::string_view((const char*)batch, n * sizeof(Event)), batch[n - 1].epoch))
+            return false;
+
+        ring.drained = next;
+    }
+
+    return true;
+}
+
+/**
+ * @return Text of an event code, as the error log held it before codes.
+ */
+const char* eventText(uint16_t code){
+    return code < EventCodeCount ? EventTexts[code] : "Unknown event.";
+}
+
+/**
+ * Events of an error log entry.
+ *
+ * @param entry Entry written by drainEvents().
+ * @param events Receives the events, must hold count of them.
+ * @param count Most events to unpack.
+ * @return Number of events unpacked.
+ */
+size_t unpackEvents(const RingLogEntry& entry, Event* events, size_t count){
+    size_t n = std::min(count, (size_t)entry.length / sizeof(Event));
+
+    memcpy(events, entry.text, n * sizeof(Event));
+    return n;
+}
+
+// Only the firmware drains, into its own error log
+template bool drainEvents(RingLog<RtbStorage::LogStorage>& log);
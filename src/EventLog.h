@@ -0,0 +1,72 @@
+/**
+ * File :      EventLog.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Errors and notable events as numeric codes. logEvent() only stores 8 bytes in a ring
+ *             kept in RTC memory that isn't cleared by a warm reset (watchdog, panic, software
+ *             reset), so events logged just before a reset are still there at the next boot.
+ *             drainEvents() packs them into entries of the error log (see RingLog.h), where
+ *             eventText() or the host decoder (src/native/EventDump.cpp) turns them back into text.
+*/
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "RingLog.h"
+
+#define EVENT_RING_SIZE 64          // Events waiting in RTC memory, older ones are overwritten if the log can't be written
+#define EVENTS_PER_ENTRY 10         // Events packed in one error log entry
+
+/**
+ * Meaning of Event::code. Codes are stored, only append new ones.
+ */
+enum EventCode : uint16_t {
+    EventNone = 0,
+    EventBoot,                      // Logged at boot when the previous run left events, arg : how many
+    EventLockTimer,
+    EventKeypadTimer,
+    EventRtcMissing,
+    EventUsageStorageInit,
+    EventLogStorageInit,
+    EventMigration,
+    EventRegistryCreate,
+    EventLogCreate,
+    EventRegistryRead,
+    EventInvalidRecord,
+    EventCheckpointSave,
+    EventTaskStart,
+    EventRecordAppend,
+    EventRegistryClear,
+    EventJournalFlush,              // Unused, the firmware batches no file : kept so the codes after it stay
+    EventRtcInvalid,
+    EventLastActivationInvalid,
+    EventLockOpen,
+    EventLost,                      // arg : events overwritten in RTC memory before they were drained
+    EventArchive,
+    EventCodeCount
+};
+
+/**
+ * One event, stored as is (little endian) in the error log entries.
+ */
+struct Event {
+    uint32_t epoch;                 // Unix time of the latest clock reading (see setEventTime), 0 if none yet
+    uint16_t code;                  // See EventCode
+    uint16_t arg;                   // Meaning depends on the code, 0 if unused
+};
+
+static_assert(sizeof(Event) == 8, "Event must stay 8 bytes long");
+static_assert(EVENTS_PER_ENTRY * sizeof(Event) <= sizeof(RingLogEntry::text), "Events of an entry must fit in a slot");
+
+size_t beginEvents();
+void logEvent(EventCode code, uint16_t arg = 0);
+void setEventTime(uint32_t epoch);
+uint32_t pendingEvents();
+template<typename Backend> bool drainEvents(RingLog<Backend>& log);
+
+const char* eventText(uint16_t code);
+size_t unpackEvents(const RingLogEntry& entry, Event* events, size_t count);
+
+#endif
@@ -5,6 +5,8 @@
 */
 bool FlashMem::init(){
     
+    _handles.closeAll();
+
     if(!LittleFS.begin(FORMAT_LITTLEFS_IF_FAILED))
         return false;
         
@@ -17,112 +19,214 @@ bool FlashMem::init(){
  * @param fileName File name.
  * @return True, if the file exists, false otherwise.
  */
-bool FlashMem::fileExist(const std::string fileName){
+bool FlashMem::fileExist(std::string_view fileName){
+
+    if(_handles.find(fileName))
+        return true;
 
-    std::string path = fileName; // not a necessity, but it shows that the file is located at the root of the filesystem
-    path.insert(0,"/");
+    char path[FILE_PATH_SIZE];  // not a necessity, but it shows that the file is located at the root of the filesystem
 
-    if(LittleFS.exists(path.c_str()))
+    if(makePath(path, "/", fileName) && LittleFS.exists(path))
         return true;
 
     return false;
 }
 
 /**
- * Creates a file with the name provided.
+ * Creates a file with the name provided, an existing file is emptied.
  *
  * @param fileName File name.
  * @return True, if the file has been create, false otherwise.
  */
-bool FlashMem::createFile(const std::string fileName){
+bool FlashMem::createFile(std::string_view fileName){
 
-    std::string path = fileName;
-    path.insert(0,"/");
-    
-    fs::File f = LittleFS.open(path.c_str(), "w");
+    Handle* h = reopen(fileName, "w+");
 
-    if(!f)
+    if(!h)
         return false;
 
-    f.close();
+    _handles.release(*h);
 
     return true;
 }
 
 /**
- * Reads and add all lines in a vector of string, until it reaches a int value n of zero.
- * 
- * If you manually put data into a file, make sure
- * that you press Enter at the end of each string.
- * 
- * @param fileName File name where data are written.
- * @param vect Vector that will be filled with every line found.
+ * Append a line to a file, the file is created if needed.
+ *
+ * @param fileName File name.
+ * @param line Line of text to be added. It puts an /n character after the line to be written.
  * @return True, if the operation was successful, false if the file couldn't be opened.
  */
-bool FlashMem::readFrom(const std::string fileName, std::vector<std::string>& vect){
-
-    std::string path = fileName;
-    path.insert(0,"/");
+bool FlashMem::addLine(std::string_view fileName, std::string_view line){
 
-    fs::File f = LittleFS.open(path.c_str(), "r");
+    Handle* h = handle(fileName, true);
 
-    if(!f)
+    if(!h)
         return false;
-    
-    std::string stemp;
 
-    // Get all the data
-    while(f.available()){
-        stemp = f.readStringUntil('\n').c_str();
+    fs::File& f = h->handle;
+    bool ok = f.seek(0, fs::SeekEnd) && f.write((const uint8_t*)line.data(), line.size()) == line.size()
+        && f.write((const uint8_t*)"\r\n", 2) == 2;
+
+    f.flush();                  // Committed, as a close would do
+    _handles.release(*h);
 
-        if(stemp.length() > 10)
-            vect.push_back(stemp.c_str());
-    }
+    return ok;
+}
+
+/**
+ * Erase every data of a file. Its cached handle is dropped first, then the file is reopened truncated.
+ *
+ * @param fileName File's name that content will be erased.
+ * @return True, if the operation was successful, false if the file name doesn't exist.
+ */
+bool FlashMem::clearFile(std::string_view fileName){
+
+    Handle* h = reopen(fileName, "w+");
+
+    if(!h)
+        return false;
 
-    f.close();
+    _handles.release(*h);
 
     return true;
 }
 
 /**
- * Append a line to a file.
+ * Gives the size of a file.
  *
  * @param fileName File name.
- * @param line Line of text to be added. It puts an /n character after the line to be written.
- * @return True, if the operation was successful, false if the file name doesn't exist.
+ * @param size Filled with the size in bytes.
+ * @return True, if the operation was successful, false if the file couldn't be opened.
  */
-bool FlashMem::addLine(const std::string fileName, const std::string line){
+bool FlashMem::fileSize(std::string_view fileName, size_t& size){
 
-    std::string path = fileName;
-    path.insert(0,"/");
+    Handle* h = handle(fileName, false);
 
-    fs::File f = LittleFS.open(path.c_str(), "a");
-
-    if(!f)
+    if(!h)
         return false;
-    
-    f.println(line.c_str());
 
-    f.close();
+    size = h->handle.size();
+
+    _handles.release(*h);
 
     return true;
 }
 
 /**
- * Erase every data of a file.
+ * Reads exactly length bytes, starting at offset.
  *
- * @param fileName File's name that content will be erased.
- * @return True, if the operation was successful, false if the file name doesn't exist.
+ * @param fileName File name.
+ * @param offset Position of the first byte to read.
+ * @param buffer Receives the data, must hold length bytes.
+ * @param length Number of bytes to read.
+ * @return True, if every byte has been read, false otherwise.
  */
-bool FlashMem::clearFile(const std::string fileName){
+bool FlashMem::readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length){
+
+    Handle* h = handle(fileName, false);
 
-    std::string path = fileName;
-    path.insert(0,"/");
+    if(!h)
+        return false;
+
+    fs::File& f = h->handle;
+    bool ok = f.seek(offset) && f.read(buffer, length) == length;
+
+    _handles.release(*h);
+
+    return ok;
+}
 
-    fs::File f = LittleFS.open(path.c_str(), "w");
+/**
+ * Append raw bytes to a file, the file is created if needed.
+ *
+ * @param fileName File name.
+ * @param data Bytes to be added, nothing is put after them.
+ * @param length Number of bytes.
+ * @return True, if the operation was successful, false if the file couldn't be opened.
+ */
+bool FlashMem::appendBytes(std::string_view fileName, const uint8_t* data, size_t length){
 
-    if(!f)
+    Handle* h = handle(fileName, true);
+
+    if(!h)
         return false;
 
-    return true;
-}
\ No newline at end of file
+    fs::File& f = h->handle;
+    bool ok = f.seek(0, fs::SeekEnd) && f.write(data, length) == length;
+
+    f.flush();
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Overwrite bytes in place, the file is created if needed. Offset can't be past the end of the file.
+ *
+ * @param fileName File name.
+ * @param offset Position of the first byte to write.
+ * @param data Bytes to be written.
+ * @param length Number of bytes.
+ * @return True, if the operation was successful, false otherwise.
+ */
+bool FlashMem::writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length){
+
+    Handle* h = handle(fileName, true);
+
+    if(!h)
+        return false;
+
+    fs::File& f = h->handle;
+    bool ok = f.seek(offset) && f.write(data, length) == length;
+
+    f.flush();
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Open handle of a file, taken from the cache or opened for reading and writing.
+ *
+ * @param fileName File name.
+ * @param create Creates the file if it doesn't exist.
+ * @return The cache entry, nullptr if the file couldn't be opened.
+ */
+FlashMem::Handle* FlashMem::handle(std::string_view fileName, bool create){
+
+    if(Handle* h = _handles.find(fileName))
+        return h;
+
+    Handle* h = _handles.slot(fileName);
+
+    if(!h || (!h->path[0] && !makePath(h->path, "/", fileName)))
+        return nullptr;
+
+    h->handle = LittleFS.open(h->path, "r+");
+
+    if(!h->handle && create)
+        h->handle = LittleFS.open(h->path, "w+");
+
+    h->open = (bool)h->handle;
+
+    return h->open ? h : nullptr;
+}
+
+/**
+ * Drops the cached handle of a file and opens it again with the given mode.
+ */
+FlashMem::Handle* FlashMem::reopen(std::string_view fileName, const char* mode){
+
+    _handles.invalidate(fileName);
+
+    Handle* h = _handles.slot(fileName);
+
+    if(!h || (!h->path[0] && !makePath(h->path, "/", fileName)))
+        return nullptr;
+
+    h->handle = LittleFS.open(h->path, mode);
+    h->open = (bool)h->handle;
+
+    return h->open ? h : nullptr;
+}
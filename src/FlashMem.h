@@ -3,27 +3,41 @@
 #define FLASHMEM_H
 
 #include "Storage.h"
+#include "HandleCache.h"
 
 #include <LittleFS.h>	    // Library for internal storage
 
 /**
  * Child class of Storage
 */
-class FlashMem : public Storage{
+class FlashMem final : public Storage{
+private:
+    typedef HandleCache<fs::File>::Entry Handle;
+
+    HandleCache<fs::File> _handles;             // Files stay open between operations
+
+    Handle* handle(std::string_view fileName, bool create);
+    Handle* reopen(std::string_view fileName, const char* mode);
 
 public:
-    FlashMem() = default;                       // Constructor & destructor
+    explicit FlashMem(size_t cachedHandles = HANDLE_CACHE_SIZE) : _handles(cachedHandles) {}    // Constructor & destructor
     FlashMem(const FlashMem &u) = delete;       // Deletion of copy constructor, security for assuring there's only one instance
 
     ~FlashMem() = default;
 
+    const HandleCacheStats& cacheStats() const { return _handles.stats(); }
+
     bool init() override;
     
-    bool fileExist(const std::string registreName) override;
-    bool createFile(const std::string fileName) override;
-    bool readFrom(const std::string fileName, std::vector<std::string>& vect) override;
-    bool addLine(const std::string fileName, const std::string line) override;
-    bool clearFile(const std::string fileName) override;
+    bool fileExist(std::string_view registreName) override;
+    bool createFile(std::string_view fileName) override;
+    bool addLine(std::string_view fileName, std::string_view line) override;
+    bool clearFile(std::string_view fileName) override;
+
+    bool fileSize(std::string_view fileName, size_t& size) override;
+    bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) override;
+    bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) override;
+    bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+/**
+ * File :      HandleCache.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Open file handles kept by a storage backend, keyed by file name, so the registry,
+ *             the checkpoint and the log aren't looked up and reopened on every operation.
+ *             The least recently used handle is closed when a new file needs a slot. Names and
+ *             paths are kept inline, nothing is allocated once the cache is built.
+*/
+#ifndef HANDLECACHE_H
+#define HANDLECACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "Storage.h"
+
+#define HANDLE_CACHE_SIZE 4         // Registry in use, checkpoint, log and one spare (e.g. the other registry slot)
+#define FILE_PATH_SIZE 40           // Longest backend path, i.e. a directory followed by the file name
+
+/**
+ * Writes prefix then fileName into path, as a C string.
+ *
+ * @return True, if it fits, false otherwise (path is then empty).
+ */
+template<size_t PathSize>
+bool makePath(char (&path)[PathSize], const char* prefix, std::string_view fileName){
+    size_t length = strlen(prefix);
+
+    if(length + fileName.size() >= PathSize){
+        path[0] = 0;
+        return false;
+    }
+
+    memcpy(path, prefix, length);
+    memcpy(path + length, fileName.data(), fileName.size());
+    path[length + fileName.size()] = 0;
+    return true;
+}
+
+/**
+ * How often an operation found its file already open.
+ */
+struct HandleCacheStats {
+    uint32_t hits;
+    uint32_t misses;                // The file had to be opened
+    uint32_t evictions;             // An open handle was closed to make room
+};
+
+template<typename Handle, size_t PathSize = FILE_PATH_SIZE>
+class HandleCache {
+public:
+    struct Entry {
+        char fileName[FILE_NAME_SIZE] = {};
+        char path[PathSize] = {};           // Backend path of fileName, built once by the backend
+        Handle handle;
+        uint32_t lastUse = 0;
+        bool open = false;
+    };
+
+private:
+    std::vector<Entry> _entries;
+    bool _keepOpen;
+    uint32_t _clock = 0;
+    HandleCacheStats _stats = {};
+
+public:
+    /**
+     * @param capacity Handles kept open, 0 closes each handle after use (no caching).
+     */
+    explicit HandleCache(size_t capacity = HANDLE_CACHE_SIZE) : _entries(capacity ? capacity : 1), _keepOpen(capacity > 0) {}
+
+    /**
+     * Open entry of a file, nullptr if it has to be opened.
+     */
+    Entry* find(std::string_view fileName){
+        for(Entry& e : _entries)
+            if(e.open && fileName == e.fileName){
+                e.lastUse = ++_clock;
+                _stats.hits++;
+                return &e;
+            }
+        return nullptr;
+    }
+
+    /**
+     * Entry to open a file into, a free one or the least recently used (its handle is then closed).
+     * The path is kept when the entry already belonged to the same file.
+     *
+     * @return The entry, nullptr if the name is longer than FILE_NAME_SIZE allows.
+     */
+    Entry* slot(std::string_view fileName){
+        if(fileName.size() >= FILE_NAME_SIZE)
+            return nullptr;
+
+        Entry* victim = &_entries[0];
+
+        for(Entry& e : _entries){
+            if(!e.open){
+                victim = &e;
+                break;
+            }
+            if(e.lastUse < victim->lastUse)
+                victim = &e;
+        }
+
+        if(victim->open){
+            victim->handle.close();
+            victim->open = false;
+            _stats.evictions++;
+        }
+
+        if(fileName != victim->fileName){
+            memcpy(victim->fileName, fileName.data(), fileName.size());
+            victim->fileName[fileName.size()] = 0;
+            victim->path[0] = 0;
+        }
+
+        victim->lastUse = ++_clock;
+        _stats.misses++;
+        return victim;
+    }
+
+    /**
+     * End of an operation, the handle is closed when caching is off.
+     */
+    void release(Entry& e){
+        if(!_keepOpen && e.open){
+            e.handle.close();
+            e.open = false;
+        }
+    }
+
+    /**
+     * Closes the handle of a file, e.g. before it is truncated or removed.
+     */
+    void invalidate(std::string_view fileName){
+        for(Entry& e : _entries)
+            if(e.open && fileName == e.fileName){
+                e.handle.close();
+                e.open = false;
+            }
+    }
+
+    void closeAll(){
+        for(Entry& e : _entries)
+            if(e.open){
+                e.handle.close();
+                e.open = false;
+            }
+    }
+
+    const HandleCacheStats& stats() const{ return _stats; }
+};
+
+#endif
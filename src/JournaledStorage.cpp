@@ -0,0 +1,254 @@
+#include "JournaledStorage.h"
+
+#include <Arduino.h>
+#include <cstring>
+
+#include "NullStorage.h"
+#include "Trace.h"
+#include "MemoryStats.h"
+
+/**
+ * Chooses how appends to a file are written. Switching back to JournalSyncPerRecord flushes the file.
+ *
+ * @param fileName File name, a longer one than FILE_NAME_SIZE allows stays written through.
+ * @param policy See JournalPolicy.
+ */
+template<typename Backend>
+void JournaledStorage<Backend>::setPolicy(std::string_view fileName, JournalPolicy policy){
+    BatchedFile* file = find(fileName);
+
+    if(policy == JournalBatched && !file)
+        add(fileName);
+    else if(policy == JournalSyncPerRecord && file){
+        flush(*file);
+        remove(*file);
+    }
+}
+
+/**
+ * Flushes the buffers holding a record older than the maximum age, to be called regularly.
+ * Only traced when it writes, a poll with nothing to do would fill the trace.
+ *
+ * @return True, if every flush was successful, false otherwise.
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::poll(){
+    uint32_t traceStart = traceCycles();
+    bool ok = true;
+    bool flushed = false;
+    uint32_t now = millis();
+
+    for(BatchedFile& file : _files){
+        if(!file.pending.empty() && now - file.since >= _maxAgeMillis){
+            ok = flush(file) && ok;
+            flushed = true;
+        }
+    }
+
+    if(flushed)
+        TRACE_RECORD(TraceJournalPoll, traceStart, 0);
+    return ok;
+}
+
+/**
+ * Writes every buffered record to the backend.
+ *
+ * @return True, if every flush was successful, false otherwise.
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::sync(){
+    TRACE_SCOPE(TraceSync);
+    bool ok = true;
+
+    for(BatchedFile& file : _files)
+        ok = flush(file) && ok;
+
+    return ok && _backend->sync();
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::init(){
+    TRACE_SCOPE(TraceStorageInit);
+    return _backend->init();
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::fileExist(std::string_view fileName){
+    TRACE_SCOPE(TraceFileExist);
+    BatchedFile* file = find(fileName);
+
+    if(file && !file->pending.empty())
+        return true;
+
+    return _backend->fileExist(fileName);
+}
+
+/**
+ * Creates (or empties) a file, its buffered records are dropped.
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::createFile(std::string_view fileName){
+    TRACE_SCOPE(TraceCreateFile);
+
+    if(BatchedFile* file = find(fileName))
+        file->pending.clear();
+
+    return _backend->createFile(fileName);
+}
+
+/**
+ * Append a line to a file, ended like Print::println() does. Refused if it is longer than
+ * forEachLine() can read back (STREAM_BUFFER_SIZE, end of line included).
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::addLine(std::string_view fileName, std::string_view line){
+    TRACE_SCOPE_ARG(TraceAddLine, line.size());
+    uint8_t text[STREAM_BUFFER_SIZE];
+
+    if(line.size() + 2 > sizeof(text))
+        return false;
+
+    memcpy(text, line.data(), line.size());
+    text[line.size()] = '\r';
+    text[line.size() + 1] = '\n';
+
+    return append(fileName, text, line.size() + 2);
+}
+
+/**
+ * Erase every data of a file, its buffered records included.
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::clearFile(std::string_view fileName){
+    TRACE_SCOPE(TraceClearFile);
+
+    if(BatchedFile* file = find(fileName))
+        file->pending.clear();
+
+    return _backend->clearFile(fileName);
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::fileSize(std::string_view fileName, size_t& size){
+    TRACE_SCOPE(TraceFileSize);
+    return flush(fileName) && _backend->fileSize(fileName, size);
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length){
+    TRACE_SCOPE_ARG(TraceReadBytes, length);
+    return flush(fileName) && _backend->readBytes(fileName, offset, buffer, length);
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::appendBytes(std::string_view fileName, const uint8_t* data, size_t length){
+    TRACE_SCOPE_ARG(TraceAppendBytes, length);
+    return append(fileName, data, length);
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length){
+    TRACE_SCOPE_ARG(TraceWriteBytes, length);
+    return flush(fileName) && _backend->writeBytes(fileName, offset, data, length);
+}
+
+/**
+ * Appends the buffered records with a single backend call. They are kept on failure, for a retry.
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::flush(BatchedFile& file){
+    if(file.pending.empty())
+        return true;
+
+    if(!_backend->appendBytes(file.fileName, file.pending.data(), file.pending.size()))
+        return false;
+
+    written(file.pending.size());
+    file.pending.clear();
+
+    return true;
+}
+
+template<typename Backend>
+bool JournaledStorage<Backend>::flush(std::string_view fileName){
+    BatchedFile* file = find(fileName);
+
+    return !file || flush(*file);
+}
+
+/**
+ * Writes through, or buffers the record if the file is batched. A record that doesn't fit
+ * in the buffer flushes it first.
+ *
+ * @return True, if the record has been written or buffered, false otherwise.
+ */
+template<typename Backend>
+bool JournaledStorage<Backend>::append(std::string_view fileName, const uint8_t* data, size_t length){
+    MemoryScope memoryScope(MemoryJournal);
+    received(length);
+
+    BatchedFile* file = find(fileName);
+
+    if(!file){
+        if(!_backend->appendBytes(fileName, data, length))
+            return false;
+
+        written(length);
+        return true;
+    }
+
+    if(!fits(*file, length) && !flush(*file))
+        return false;
+
+    return !buffer(*file, data, length) || flush(*file);
+}
+
+JournalFiles::BatchedFile* JournalFiles::find(std::string_view fileName){
+    for(BatchedFile& file : _files)
+        if(fileName == file.fileName)
+            return &file;
+
+    return nullptr;
+}
+
+/**
+ * Starts batching a file, see setPolicy().
+ */
+void JournalFiles::add(std::string_view fileName){
+    MemoryScope memoryScope(MemoryJournal);
+
+    if(fileName.size() >= FILE_NAME_SIZE)
+        return;
+
+    _files.emplace_back();
+    BatchedFile& added = _files.back();
+    memcpy(added.fileName, fileName.data(), fileName.size());
+    added.fileName[fileName.size()] = 0;
+    added.pending.reserve(_bufferSize);
+    added.since = 0;
+}
+
+void JournalFiles::remove(BatchedFile& file){
+    _files.erase(_files.begin() + (&file - _files.data()));
+}
+
+/**
+ * Keeps a record in the buffer of its file, the caller made room for it.
+ *
+ * @return True, if the buffer is now full and must be flushed, false otherwise.
+ */
+bool JournalFiles::buffer(BatchedFile& file, const uint8_t* data, size_t length){
+    if(file.pending.empty())
+        file.since = millis();
+
+    file.pending.insert(file.pending.end(), data, data + length);
+
+    if(file.pending.size() > _stats.maxPendingBytes)
+        _stats.maxPendingBytes = file.pending.size();
+
+    return file.pending.size() >= _bufferSize;
+}
+
+// Any Storage for the host tools, and a final backend for StorageBench.cpp
+template class JournaledStorage<Storage>;
+template class JournaledStorage<NullStorage>;
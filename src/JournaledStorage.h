@@ -0,0 +1,107 @@
+/**
+ * File :      JournaledStorage.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Storage layer over any other Storage. Appends to "batched" files are kept in RAM
+ *             and written in one go (group commit) when the buffer is full, when it gets too old
+ *             (see poll()) or on sync(). Other files are written through, one append per record.
+ *             Only the host tools of ./native use it : the firmware batches no file, its backends
+ *             are held directly (see StorageController.h). The backend type is a template
+ *             parameter : over a final backend its calls are direct, JournaledStorage<> goes
+ *             through Storage.
+*/
+#ifndef JOURNALEDSTORAGE_H
+#define JOURNALEDSTORAGE_H
+
+#include "Storage.h"
+
+#define JOURNAL_BUFFER_SIZE 512     // Bytes kept in RAM per batched file
+#define JOURNAL_MAX_AGE_MS 1000     // Longest time a batched record stays in RAM
+
+/**
+ * Durability of the appends to a file.
+ */
+enum JournalPolicy : uint8_t {
+    JournalSyncPerRecord,           // Each record reaches the backend before the call returns (default)
+    JournalBatched,                 // Records may stay JOURNAL_MAX_AGE_MS in RAM, lost on power cut
+};
+
+/**
+ * Appends received and appends done on the backend, their ratio is the saving.
+ */
+struct JournalStats {
+    uint32_t records;               // addLine() and appendBytes() calls
+    uint32_t recordBytes;           // Bytes appended by the callers
+    uint32_t flushes;               // Appends done on the backend
+    uint32_t bytesWritten;          // Bytes appended on the backend
+    uint32_t maxPendingBytes;       // Most bytes ever waiting in a buffer
+};
+
+/**
+ * Batched files and counters, the part of the journal that doesn't depend on the backend :
+ * compiled once, whatever the number of backend types.
+ */
+class JournalFiles{
+protected:
+    struct BatchedFile {
+        char fileName[FILE_NAME_SIZE];
+        std::vector<uint8_t> pending;
+        uint32_t since;             // millis() of the oldest pending record
+    };
+
+    std::vector<BatchedFile> _files;
+    size_t _bufferSize;
+    uint32_t _maxAgeMillis;
+    JournalStats _stats = {};
+
+    JournalFiles(size_t bufferSize, uint32_t maxAgeMillis) : _bufferSize(bufferSize), _maxAgeMillis(maxAgeMillis) {}
+
+    BatchedFile* find(std::string_view fileName);
+    void add(std::string_view fileName);
+    void remove(BatchedFile& file);
+    bool buffer(BatchedFile& file, const uint8_t* data, size_t length);
+
+    bool fits(const BatchedFile& file, size_t length) const { return file.pending.size() + length <= _bufferSize; }
+    void received(size_t length) { _stats.records++; _stats.recordBytes += length; }
+    void written(size_t length) { _stats.flushes++; _stats.bytesWritten += length; }
+
+public:
+    const JournalStats& stats() const { return _stats; }
+};
+
+template<typename Backend = Storage>
+class JournaledStorage final : public Storage, public JournalFiles{
+private:
+    Backend* _backend;
+
+    bool flush(BatchedFile& file);
+    bool flush(std::string_view fileName);
+    bool append(std::string_view fileName, const uint8_t* data, size_t length);
+
+public:
+    explicit JournaledStorage(Backend* backend, size_t bufferSize = JOURNAL_BUFFER_SIZE, uint32_t maxAgeMillis = JOURNAL_MAX_AGE_MS)
+        : JournalFiles(bufferSize, maxAgeMillis), _backend(backend) {}
+    JournaledStorage(const JournaledStorage &j) = delete;
+
+    ~JournaledStorage() = default;
+
+    void setPolicy(std::string_view fileName, JournalPolicy policy);
+    bool poll();
+    bool sync() override;
+
+    Backend& backend() { return *_backend; }
+
+    bool init() override;
+
+    bool fileExist(std::string_view registreName) override;
+    bool createFile(std::string_view fileName) override;
+    bool addLine(std::string_view fileName, std::string_view line) override;
+    bool clearFile(std::string_view fileName) override;
+
+    bool fileSize(std::string_view fileName, size_t& size) override;
+    bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) override;
+    bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) override;
+    bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) override;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "Keypad.h"
+
+#include <Arduino.h>
+#include <cstring>
+
+static const uint8_t KeyPins[] = {Button1, Button2, Button3, EnterPin};
+static const char KeyChars[] = {'1', '2', '3', KEY_ENTER};
+
+/**
+ * Starts sampling the keys, pins must already be configured as inputs.
+ *
+ * @param samplePeriodMicros Time between two samples, a press needs 4 equal samples to be registered.
+ * @return True, if the timer has been started, false otherwise.
+ */
+bool Keypad::begin(uint32_t samplePeriodMicros){
+    esp_timer_create_args_t args = {};
+    args.callback = &Keypad::onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "keypad";
+
+    if(esp_timer_create(&args, &_timer) != ESP_OK)
+        return false;
+
+    return esp_timer_start_periodic(_timer, samplePeriodMicros) == ESP_OK;
+}
+
+void Keypad::onTimer(void* arg){
+    static_cast<Keypad*>(arg)->sample();
+}
+
+/**
+ * Reads every key once and advances the debounce counters of all keys in parallel.
+ * A key changes state after 4 consecutive samples that disagree with it.
+ * Runs in the timer task : it only touches the producer side of the queue.
+ */
+void Keypad::sample(){
+    uint8_t raw = 0;
+    for(uint8_t k = 0; k < KeyCount; k++)
+        if(digitalRead(KeyPins[k]) == HIGH)
+            raw |= 1 << k;
+
+    uint32_t now = micros();
+    _stats.samples++;
+
+    uint8_t i = _state ^ raw;           // Keys disagreeing with their debounced state
+
+    uint8_t started = i & ~_changing;   // Remember when each disagreement started
+    for(uint8_t k = 0; k < KeyCount; k++)
+        if(started & (1 << k))
+            _changeSeen[k] = now;
+    _changing = i;
+
+    _ct0 = ~(_ct0 & i);
+    _ct1 = _ct0 ^ (_ct1 & i);
+    i &= _ct0 & _ct1;                   // Counters that rolled over
+    _state ^= i;
+    _changing &= ~i;
+
+    uint8_t pressed = _state & i;
+    if(!pressed)
+        return;
+
+    for(uint8_t k = 0; k < KeyCount; k++){
+        if(!(pressed & (1 << k)))
+            continue;
+
+        if(!_events.push(KeyEvent{KeyChars[k], now})){
+            _stats.dropped++;
+            continue;
+        }
+
+        _stats.events++;
+        _stats.lastEventAt = now;
+        _stats.lastDebounceMicros = now - _changeSeen[k];
+        if(_stats.lastDebounceMicros > _stats.maxDebounceMicros)
+            _stats.maxDebounceMicros = _stats.lastDebounceMicros;
+    }
+}
+
+/**
+ * Takes the oldest key press, if any. Never blocks.
+ */
+bool Keypad::pollEvent(KeyEvent& event){
+    return _events.pop(event);
+}
+
+/**
+ * Consumes the pending key presses. Never blocks, doesn't allocate.
+ *
+ * @param code Receives the whole code once Enter has been pressed, room for MAX_CODE_LENGTH characters.
+ * @param length Receives its number of characters (0 if the code was longer than MAX_CODE_LENGTH).
+ * @return True, if a code has been completed, false if the user is still typing.
+ */
+bool Keypad::pollInput(char* code, size_t& length){
+    KeyEvent e;
+
+    while(_events.pop(e)){
+        if(e.key != KEY_ENTER){
+            if(_length < MAX_CODE_LENGTH)
+                _code[_length++] = e.key;
+            else
+                _overflow = true;
+            continue;
+        }
+
+        length = _overflow ? 0 : _length;
+        memcpy(code, _code, length);
+
+        _length = 0;
+        _overflow = false;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,72 @@
+/**
+ * File :      Keypad.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Non-blocking keypad. A periodic esp_timer samples Button1..3 and EnterPin,
+ *             debounces all of them at once with a vertical counter and pushes key
+ *             events into a lock-free queue that loop() drains with pollInput().
+*/
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <cstdint>
+#include <esp_timer.h>
+
+#include "DEFINITIONS.hpp"
+#include "SpscQueue.h"
+
+#define KEY_ENTER '\n'
+
+/**
+ * A debounced key press.
+ */
+struct KeyEvent {
+    char key;                   // '1', '2', '3' or KEY_ENTER
+    uint32_t at;                // micros() when the press was registered
+};
+
+struct KeypadStats {
+    uint32_t samples;           // Timer callbacks
+    uint32_t events;            // Registered presses
+    uint32_t dropped;           // Presses lost because the queue was full
+    uint32_t lastEventAt;       // micros() of the newest registered press
+    uint32_t lastDebounceMicros;// From the first sample seeing the press to its registration
+    uint32_t maxDebounceMicros;
+};
+
+class Keypad {
+private:
+    static const uint8_t KeyCount = 4;
+
+    // Vertical counter : bit n of each byte belongs to key n
+    uint8_t _state = 0;         // Debounced levels
+    uint8_t _ct0 = 0xFF;
+    uint8_t _ct1 = 0xFF;
+    uint8_t _changing = 0;      // Keys whose raw level differs from the debounced one
+    uint32_t _changeSeen[KeyCount] = {};
+
+    SpscQueue<KeyEvent, 16> _events;
+    esp_timer_handle_t _timer = nullptr;
+    KeypadStats _stats = {};
+
+    // Code being typed, only touched by the consumer
+    char _code[MAX_CODE_LENGTH];
+    size_t _length = 0;
+    bool _overflow = false;
+
+    static void onTimer(void* arg);
+
+public:
+    Keypad() = default;
+    Keypad(const Keypad &k) = delete;
+
+    bool begin(uint32_t samplePeriodMicros = KEYPAD_SAMPLE_PERIOD_US);
+    void sample();
+
+    bool pollEvent(KeyEvent& event);
+    bool pollInput(char* code, size_t& length);
+
+    const KeypadStats& stats() const { return _stats; }
+};
+
+#endif
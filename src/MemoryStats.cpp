@@ -0,0 +1,246 @@
+#include "MemoryStats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <esp_heap_caps.h>
+
+/**
+ * Counters of a tag, updated from any task.
+ */
+struct TagCounters {
+    std::atomic<uint32_t> live;
+    std::atomic<uint32_t> peak;
+    std::atomic<uint32_t> allocations;
+    std::atomic<uint32_t> frees;
+};
+
+static TagCounters tags[MemoryTagCount];
+static TagCounters total;
+static thread_local MemoryTag currentTag = MemoryOther;
+
+struct WatchedTask {
+    const char* name;
+    TaskHandle_t task;
+    uint32_t stackSize;
+};
+
+static WatchedTask watched[MEMORY_WATCHED_TASKS];
+static std::atomic<size_t> watchedCount{0};
+
+static const char* const MemoryTagNames[MemoryTagCount] = {
+    "other",
+    "boot",
+    "input",
+    "policy",
+    "storage",
+    "journal",
+    "archive",
+    "audit",
+};
+
+MemoryScope::MemoryScope(MemoryTag tag) : _previous(currentTag){
+    currentTag = tag;
+}
+
+MemoryScope::~MemoryScope(){
+    currentTag = _previous;
+}
+
+static MemoryTagStats statsOf(const TagCounters& c){
+    return {c.live.load(std::memory_order_relaxed), c.peak.load(std::memory_order_relaxed),
+        c.allocations.load(std::memory_order_relaxed), c.frees.load(std::memory_order_relaxed)};
+}
+
+MemoryTagStats memoryTagStats(uint8_t tag){
+    return tag < MemoryTagCount ? statsOf(tags[tag]) : MemoryTagStats{};
+}
+
+MemoryTagStats memoryTotalStats(){
+    return statsOf(total);
+}
+
+/**
+ * Peaks start again from the live bytes, e.g. to measure one phase.
+ */
+void resetMemoryPeaks(){
+    for(TagCounters& c : tags)
+        c.peak.store(c.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    total.peak.store(total.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+HeapStats heapStats(){
+    return {(uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT), (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+        (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT)};
+}
+
+/**
+ * Adds a task to the report. Only for tasks that are never deleted, watched before the report is asked for.
+ *
+ * @param name Name in the report, must outlive the program (a literal).
+ * @param task Task handle.
+ * @param stackSize Stack size given at its creation.
+ */
+void watchTaskStack(const char* name, TaskHandle_t task, uint32_t stackSize){
+    size_t i = watchedCount.load(std::memory_order_relaxed);
+    if(i == MEMORY_WATCHED_TASKS || task == nullptr)
+        return;
+
+    watched[i] = {name, task, stackSize};
+    watchedCount.store(i + 1, std::memory_order_release);
+}
+
+size_t watchedTaskCount(){
+    return watchedCount.load(std::memory_order_acquire);
+}
+
+TaskStackStats taskStackStats(size_t i){
+    const WatchedTask& w = watched[i];
+    return {w.name, w.task, w.stackSize, (uint32_t)uxTaskGetStackHighWaterMark(w.task)};
+}
+
+const char* memoryTagName(uint8_t tag){
+    return tag < MemoryTagCount ? MemoryTagNames[tag] : "unknown";
+}
+
+/**
+ * Prints the heap, then a line per tag (live, peak, allocations, frees) and per watched task
+ * (stack size, high-water mark), in bytes.
+ */
+void printMemoryReport(Print& out){
+    HeapStats heap = heapStats();
+    out.print("heap free ");
+    out.print((unsigned long)heap.freeBytes);
+    out.print(" largest ");
+    out.print((unsigned long)heap.largestFreeBlock);
+    out.print(" minimum ");
+    out.println((unsigned long)heap.minimumFreeBytes);
+
+    for(uint8_t t = 0; t <= MemoryTagCount; t++){
+        MemoryTagStats s = t < MemoryTagCount ? memoryTagStats(t) : memoryTotalStats();
+        out.print(t < MemoryTagCount ? MemoryTagNames[t] : "total");
+        out.print(' ');
+        out.print((unsigned long)s.liveBytes);
+        out.print(' ');
+        out.print((unsigned long)s.peakBytes);
+        out.print(' ');
+        out.print((unsigned long)s.allocations);
+        out.print(' ');
+        out.println((unsigned long)s.frees);
+    }
+
+    for(size_t i = 0; i < watchedTaskCount(); i++){
+        TaskStackStats s = taskStackStats(i);
+        out.print("stack ");
+        out.print(s.name);
+        out.print(' ');
+        out.print((unsigned long)s.stackSize);
+        out.print(' ');
+        out.println((unsigned long)s.minimumFreeBytes);
+    }
+}
+
+#if USE_MEMORY_STATS
+
+static void raisePeak(std::atomic<uint32_t>& peak, uint32_t live){
+    uint32_t p = peak.load(std::memory_order_relaxed);
+    while(live > p && !peak.compare_exchange_weak(p, live, std::memory_order_relaxed)){}
+}
+
+static void countAllocation(TagCounters& c, uint32_t size){
+    uint32_t live = c.live.fetch_add(size, std::memory_order_relaxed) + size;
+    raisePeak(c.peak, live);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void countFree(TagCounters& c, uint32_t size){
+    c.live.fetch_sub(size, std::memory_order_relaxed);
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * In front of every block : what operator delete needs to count it back. Costs
+ * alignof(max_align_t) bytes per allocation (8 on the ESP32).
+ */
+struct alignas(alignof(std::max_align_t)) AllocationHeader {
+    uint32_t size;
+    uint8_t tag;                    // MemoryTagCount : not counted
+};
+
+static void* countedNew(size_t size){
+    AllocationHeader* header = static_cast<AllocationHeader*>(malloc(sizeof(AllocationHeader) + size));
+    if(!header)
+        return nullptr;
+
+    header->size = (uint32_t)size;
+    header->tag = currentTag;
+
+    #ifdef RTB_NATIVE
+        // Host stand-in of a library that uses malloc on the ESP32 (see NativeHal.h)
+        if(!nativehal::allocationsCounted()){
+            header->tag = MemoryTagCount;
+            return header + 1;
+        }
+    #endif
+
+    countAllocation(tags[header->tag], header->size);
+    countAllocation(total, header->size);
+    return header + 1;
+}
+
+static void countedDelete(void* p){
+    if(!p)
+        return;
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(p) - 1;
+    if(header->tag < MemoryTagCount){
+        countFree(tags[header->tag], header->size);
+        countFree(total, header->size);
+    }
+    free(header);
+}
+
+void* operator new(size_t size){
+    void* p = countedNew(size);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size){
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+    return countedNew(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+    return countedNew(size);
+}
+
+void operator delete(void* p) noexcept{
+    countedDelete(p);
+}
+
+void operator delete[](void* p) noexcept{
+    countedDelete(p);
+}
+
+void operator delete(void* p, size_t) noexcept{
+    countedDelete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept{
+    countedDelete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept{
+    countedDelete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept{
+    countedDelete(p);
+}
+
+#endif
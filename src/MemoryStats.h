@@ -0,0 +1,103 @@
+/**
+ * File :      MemoryStats.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Where the RAM goes on a unit that runs for months : every operator new and delete
+ *             of the firmware is counted under the tag of the code that runs (see MemoryScope),
+ *             live and peak bytes per tag, next to the free heap, its largest free block (a
+ *             fragmented heap has plenty of free bytes but no large block) and the stack
+ *             high-water mark of the tasks. Printed by the "mem" serial command and the native build.
+*/
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "DEFINITIONS.hpp"
+
+#define MEMORY_WATCHED_TASKS 8      // Tasks whose stack is reported
+
+#ifdef ARDUINO_LOOP_STACK_SIZE
+    #define LOOP_TASK_STACK_SIZE ARDUINO_LOOP_STACK_SIZE
+#else
+    #define LOOP_TASK_STACK_SIZE 8192   // Stack of the task running setup() and loop(), Arduino core default
+#endif
+
+/**
+ * Who allocated. Allocations are freed under the tag they were made with.
+ */
+enum MemoryTag : uint8_t {
+    MemoryOther,                    // Static constructors, and code outside any scope
+    MemoryBoot,                     // setup() and the boot steps
+    MemoryInput,
+    MemoryPolicy,
+    MemoryStorage,
+    MemoryJournal,                  // Buffers of the batched files of the host tools (see JournaledStorage.h)
+    MemoryArchive,
+    MemoryAudit,
+    MemoryTagCount
+};
+
+/**
+ * Allocations of a tag, sizes in bytes as asked to operator new (the bookkeeping header excluded).
+ */
+struct MemoryTagStats {
+    uint32_t liveBytes;
+    uint32_t peakBytes;
+    uint32_t allocations;
+    uint32_t frees;
+};
+
+/**
+ * State of the heap, as the allocator sees it (C allocations and headers included).
+ */
+struct HeapStats {
+    uint32_t freeBytes;
+    uint32_t largestFreeBlock;
+    uint32_t minimumFreeBytes;      // Since boot
+};
+
+/**
+ * A task whose stack is watched.
+ */
+struct TaskStackStats {
+    const char* name;
+    TaskHandle_t task;
+    uint32_t stackSize;             // As given to xTaskCreatePinnedToCore
+    uint32_t minimumFreeBytes;      // High-water mark : stack never used since the task started
+};
+
+/**
+ * Allocations of the calling task are counted under a tag while the scope lives. Scopes nest,
+ * the previous tag is back when it ends.
+ */
+class MemoryScope {
+private:
+    MemoryTag _previous;
+
+public:
+    explicit MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+};
+
+MemoryTagStats memoryTagStats(uint8_t tag);
+MemoryTagStats memoryTotalStats();
+void resetMemoryPeaks();
+HeapStats heapStats();
+
+void watchTaskStack(const char* name, TaskHandle_t task, uint32_t stackSize);
+size_t watchedTaskCount();
+TaskStackStats taskStackStats(size_t i);
+
+const char* memoryTagName(uint8_t tag);
+void printMemoryReport(Print& out);
+
+#endif
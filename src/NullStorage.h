@@ -6,24 +6,24 @@
 /**
  * Child class of Storage
 */
-class NullStorage : public Storage{
+class NullStorage final : public Storage{
 public:
-    NullStorage();                                // Constructor & destructor
+    NullStorage() = default;                      // Constructor & destructor
     NullStorage(const NullStorage &u) = delete;   // Deletion of copy constructor, security for assuring there's only one instance
 
-    ~NullStorage();
+    ~NullStorage() = default;
     
     bool init() override {return true;};
 
-    bool fileExist(const std::string registreName) override {return true;};
-    bool createFile(const std::string fileName) override {return true;};
-    bool readFrom(const std::string fileName, std::vector<std::string>& vect) override {return true;};
-    bool addLine(const std::string fileName, const std::string line) override {return true;};
-    bool clearFile(const std::string fileName) override {return true;};
-};
-
-NullStorage::NullStorage() {}
+    bool fileExist(std::string_view registreName) override {return true;};
+    bool createFile(std::string_view fileName) override {return true;};
+    bool addLine(std::string_view fileName, std::string_view line) override {return true;};
+    bool clearFile(std::string_view fileName) override {return true;};
 
-NullStorage::~NullStorage() {}
+    bool fileSize(std::string_view fileName, size_t& size) override {size = 0; return true;};
+    bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) override {return length == 0;};
+    bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) override {return true;};
+    bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) override {return true;};
+};
 
 #endif
\ No newline at end of file
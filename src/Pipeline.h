@@ -0,0 +1,73 @@
+/**
+ * File :      Pipeline.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Messages and task settings of the controller pipeline :
+ *             input task (keypad) -> policy task (decision, lock) -> storage task (registry, log).
+ *             Stages talk through single-producer/single-consumer queues, so the decision
+ *             never waits on flash or SD card I/O.
+*/
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "DEFINITIONS.hpp"
+#include "RegistryFormat.h"
+
+#define CODE_QUEUE_SIZE 8           // Typed codes waiting for a decision
+#define STORAGE_QUEUE_SIZE 16       // Writes waiting for the storage, the policy stalls when it is full
+#define STORAGE_IDLE_MS 1000        // Longest sleep of the storage stage without a write
+
+#define TASK_STACK_SIZE 4096
+#define INPUT_TASK_PRIORITY 2
+#define POLICY_TASK_PRIORITY 3
+#define STORAGE_TASK_PRIORITY 1
+#define INPUT_TASK_CORE 1           // Same core as the policy, close to the lock
+#define POLICY_TASK_CORE 1
+#define STORAGE_TASK_CORE 0         // Flash and SD card latency stays on the other core
+
+/**
+ * A code typed on the keypad, from the input stage to the policy stage.
+ */
+struct CodeEvent {
+    char code[MAX_CODE_LENGTH];
+    uint8_t length;
+    uint32_t at;                    // micros() when Enter has been registered
+};
+
+/**
+ * What the storage stage has to do.
+ */
+enum StorageJobType : uint8_t {
+    JobRecord,                      // Append record to the registry, count it in the checkpoint
+    JobRenewal,                     // New quota period : start a new registry, reset the checkpoint, archive the previous one
+    JobArchive,                     // Archive the registry of the previous period, if it isn't yet
+};
+
+/**
+ * A write, from the policy stage to the storage stage.
+ */
+struct StorageJob {
+    uint8_t type;                   // See StorageJobType
+    uint16_t user;                  // JobRecord : index of the user in UsersPrep
+    uint32_t quotaPeriod;           // JobRenewal : the new period
+    RegistryRecord record;          // JobRecord : the record to append
+};
+
+/**
+ * Activity of the pipeline, each counter is written by one stage only.
+ */
+struct PipelineStats {
+    std::atomic<uint32_t> codes{0};             // Codes handed to the policy stage
+    std::atomic<uint32_t> droppedCodes{0};      // Codes lost because the policy stage was late
+    std::atomic<uint32_t> decisions{0};         // Codes evaluated
+    std::atomic<uint32_t> maxDecisionMicros{0}; // Worst time from Enter to the decision
+    std::atomic<uint32_t> storageJobs{0};       // Jobs queued by the policy stage
+    std::atomic<uint32_t> storedJobs{0};        // Jobs done by the storage stage
+    std::atomic<uint32_t> storageStalls{0};     // Times the policy stage waited for a free queue slot
+    std::atomic<uint32_t> storageQueuePeak{0};  // Most jobs ever waiting
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "QuotaPolicy.h"
+
+#include <algorithm>
+
+#include "RTClib.h"
+
+/**
+ * Identifies a calendar month, monthly quotas are renewed whenever it changes.
+ *
+ * @param epoch Unix time.
+ * @return year * 12 + month - 1, so consecutive months have consecutive ids.
+ */
+uint32_t quotaPeriodOf(uint32_t epoch){
+    DateTime date(epoch);
+    return date.year() * 12U + date.month() - 1;
+}
+
+/**
+ * First second of a calendar month.
+ *
+ * @param period Month, as returned by quotaPeriodOf().
+ * @return Unix time of the 1st of the month at midnight.
+ */
+uint32_t quotaPeriodStart(uint32_t period){
+    return DateTime(period / 12, period % 12 + 1, 1).unixtime();
+}
+
+/**
+ * Brings a quota to now : renews the month, forgets accesses that left the rolling window,
+ * gives the bucket's tokens back. Does nothing before the state's own boundary.
+ *
+ * @param config Policy of the user.
+ * @param state Quota of the user.
+ * @param now Unix time, not older than the previous call.
+ * @return Void.
+ */
+void advanceQuota(const QuotaConfig& config, QuotaState& state, uint32_t now){
+    switch(config.kind){
+        case QuotaMonthly:
+            if(now >= state.periodEnd){
+                state.used = 0;
+                state.periodEnd = quotaPeriodStart(quotaPeriodOf(now) + 1);
+            }
+            break;
+
+        case QuotaRolling:
+            while(state.count > 0 && state.ring[state.head] + config.period <= now){
+                state.head = (state.head + 1) % QUOTA_RING_SIZE;
+                state.count--;
+            }
+            break;
+
+        case QuotaBucket:
+            if(state.used > 0 && now >= state.periodEnd){
+                uint32_t refills = (now - state.periodEnd) / config.period + 1;
+                if(refills >= state.used)
+                    state.used = 0;
+                else{
+                    state.used -= refills;
+                    state.periodEnd += refills * config.period;
+                }
+            }
+            break;
+    }
+}
+
+/**
+ * Spends one token. The storage stage applies the same calls to the checkpoint's copy,
+ * so both stay equal.
+ *
+ * @param config Policy of the user.
+ * @param state Quota of the user.
+ * @param now Unix time of the access.
+ * @return Void.
+ */
+void consumeQuota(const QuotaConfig& config, QuotaState& state, uint32_t now){
+    advanceQuota(config, state, now);
+
+    switch(config.kind){
+        case QuotaMonthly:
+            state.used++;
+            break;
+
+        case QuotaRolling:
+            // A full ring drops its oldest access, see the check on UsersPrep in User.hpp
+            if(state.count == QUOTA_RING_SIZE){
+                state.ring[state.head] = now;
+                state.head = (state.head + 1) % QUOTA_RING_SIZE;
+            }
+            else{
+                state.ring[(state.head + state.count) % QUOTA_RING_SIZE] = now;
+                state.count++;
+            }
+            break;
+
+        case QuotaBucket:
+            if(state.used == 0)
+                state.periodEnd = now + config.period;
+            state.used++;
+            break;
+    }
+}
+
+/**
+ * Whether a token is left, for a state brought to now by advanceQuota().
+ */
+bool quotaLeft(const QuotaConfig& config, int tokens, const QuotaState& state){
+    switch(config.kind){
+        case QuotaRolling:
+            return state.count < tokens;
+        default:
+            return state.used < tokens;
+    }
+}
+
+/**
+ * Next unix time at which advanceQuota() would change the state, QUOTA_NEVER if none.
+ */
+uint32_t quotaBoundary(const QuotaConfig& config, const QuotaState& state){
+    switch(config.kind){
+        case QuotaMonthly:
+            return state.periodEnd;
+        case QuotaRolling:
+            return state.count > 0 ? state.ring[state.head] + config.period : QUOTA_NEVER;
+        default:
+            return state.used > 0 ? state.periodEnd : QUOTA_NEVER;
+    }
+}
+
+void Quota::init(const QuotaConfig& config, int tokens){
+    _config = &config;
+    _tokens = tokens;
+    _state = QuotaState{};
+    _recheckAt = 0;
+}
+
+/**
+ * Takes the state saved in the checkpoint, the next decision is evaluated again.
+ */
+void Quota::restore(const QuotaState& state){
+    _state = state;
+    _recheckAt = 0;
+}
+
+void Quota::consume(uint32_t now){
+    consumeQuota(*_config, _state, now);
+    evaluate(now);
+}
+
+/**
+ * Computes both answers and until when they hold. The daily window is the one that is
+ * open now, or the next one.
+ */
+void Quota::evaluate(uint32_t now){
+    advanceQuota(*_config, _state, now);
+    _tokensLeft = quotaLeft(*_config, _tokens, _state);
+    _recheckAt = quotaBoundary(*_config, _state);
+    _evaluatedAt = now;
+
+    if(_config->fromHour == _config->toHour){
+        _inWindow = true;
+        return;
+    }
+
+    uint32_t from = _config->fromHour * 3600U;
+    uint32_t length = (_config->toHour > _config->fromHour ? _config->toHour - _config->fromHour
+        : _config->toHour + 24 - _config->fromHour) * 3600U;
+    uint32_t start = now - now % 86400 + from;
+
+    if(start > now)
+        start -= 86400;             // Yesterday's window may still be open
+    if(now >= start + length)
+        start += 86400;
+
+    _inWindow = now >= start;
+    _recheckAt = std::min(_recheckAt, _inWindow ? start + length : start);
+}
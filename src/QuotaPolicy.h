@@ -0,0 +1,126 @@
+/**
+ * File :      QuotaPolicy.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   How often each user may spend a token : calendar month quota, rolling window
+ *             of N days or token bucket, optionally only during some hours of the day.
+ *             Every policy knows the next epoch at which its answer can change, so a decision
+ *             is an integer compare until then. Calendar arithmetic only runs at boundaries.
+*/
+#ifndef QUOTAPOLICY_H
+#define QUOTAPOLICY_H
+
+#include <cstdint>
+
+#define QUOTA_RING_SIZE 8           // Accesses remembered by a rolling window, i.e. most tokens of a rolling user
+#define QUOTA_NEVER 0xFFFFFFFF
+
+enum QuotaKind : uint8_t {
+    QuotaMonthly,                   // tokens per calendar month
+    QuotaRolling,                   // tokens per period seconds, counted back from now
+    QuotaBucket,                    // tokens at most, one more every period seconds
+};
+
+/**
+ * Policy of a user, see UsersPrep. Built with MonthlyQuota(), RollingQuota() or TokenBucket(),
+ * then optionally .during(from, to) and .activatedFor(seconds).
+ */
+struct QuotaConfig {
+    uint8_t kind;                   // See QuotaKind
+    uint8_t fromHour;               // Tokens can only be spent from fromHour to toHour (may span midnight),
+    uint8_t toHour;                 // no restriction when they are equal
+    uint32_t period;                // Rolling : length of the window. Bucket : time to get one token back. In seconds
+    uint32_t activatedSeconds;      // How long the RTB stays activated after this user spent a token, 0 for ActivatedTime
+
+    constexpr QuotaConfig during(uint8_t from, uint8_t to) const{
+        return QuotaConfig{kind, from, to, period, activatedSeconds};
+    }
+
+    constexpr QuotaConfig activatedFor(uint32_t seconds) const{
+        return QuotaConfig{kind, fromHour, toHour, period, seconds};
+    }
+};
+
+constexpr QuotaConfig MonthlyQuota(){
+    return QuotaConfig{QuotaMonthly, 0, 0, 0, 0};
+}
+
+constexpr QuotaConfig RollingQuota(uint16_t days){
+    return QuotaConfig{QuotaRolling, 0, 0, days * 86400U, 0};
+}
+
+constexpr QuotaConfig TokenBucket(uint32_t refillSeconds){
+    return QuotaConfig{QuotaBucket, 0, 0, refillSeconds, 0};
+}
+
+/**
+ * How long an access still counts for a policy : the window, the time an empty bucket takes
+ * to fill up, 0 for a monthly quota (its count starts again with the month).
+ */
+constexpr uint32_t quotaLookBack(const QuotaConfig& config, int tokens){
+    return config.kind == QuotaRolling ? config.period : config.kind == QuotaBucket ? config.period * (uint32_t)tokens : 0;
+}
+
+/**
+ * Persistent part of a user's quota, saved in the checkpoint. All zero is a user that never spent a token.
+ */
+struct QuotaState {
+    uint16_t used;                  // Monthly : tokens spent this month. Bucket : tokens not given back yet
+    uint8_t head;                   // Rolling : oldest access in ring
+    uint8_t count;                  // Rolling : accesses in ring
+    uint32_t periodEnd;             // Monthly : start of next month. Bucket : next token given back
+    uint32_t ring[QUOTA_RING_SIZE]; // Rolling : times of the last accesses, oldest at head
+};
+
+uint32_t quotaPeriodOf(uint32_t epoch);
+uint32_t quotaPeriodStart(uint32_t period);
+
+void advanceQuota(const QuotaConfig& config, QuotaState& state, uint32_t now);
+void consumeQuota(const QuotaConfig& config, QuotaState& state, uint32_t now);
+bool quotaLeft(const QuotaConfig& config, int tokens, const QuotaState& state);
+uint32_t quotaBoundary(const QuotaConfig& config, const QuotaState& state);
+
+/**
+ * Quota of one user with its decision cached until the next boundary (period end, token
+ * given back, access leaving the window, daily window opening or closing).
+ */
+class Quota {
+private:
+    const QuotaConfig* _config = nullptr;
+    int _tokens = 0;
+    QuotaState _state = {};
+
+    uint32_t _evaluatedAt = 0;
+    uint32_t _recheckAt = 0;        // The cached answers hold in [_evaluatedAt, _recheckAt)
+    bool _tokensLeft = false;
+    bool _inWindow = false;
+
+    void evaluate(uint32_t now);
+
+public:
+    void init(const QuotaConfig& config, int tokens);
+    void restore(const QuotaState& state);
+    void consume(uint32_t now);
+
+    /**
+     * A token can be spent now.
+     */
+    bool allows(uint32_t now){
+        if(now >= _recheckAt || now < _evaluatedAt)
+            evaluate(now);
+        return _tokensLeft && _inWindow;
+    }
+
+    /**
+     * The daily window is open now, always true without one.
+     */
+    bool inWindow(uint32_t now){
+        if(now >= _recheckAt || now < _evaluatedAt)
+            evaluate(now);
+        return _inWindow;
+    }
+
+    const QuotaState& state() const{ return _state; }
+};
+
+#endif
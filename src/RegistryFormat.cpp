@@ -0,0 +1,372 @@
+#include "RegistryFormat.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "Checksum.h"
+#include "StorageController.h"
+
+static const char RegistryMagic[4] = {'R', 'T', 'B', 'R'};
+
+RegistryHeader RegistryHeader::make(uint32_t generation, uint32_t quotaPeriod){
+    RegistryHeader h;
+    memcpy(h.magic, RegistryMagic, sizeof(h.magic));
+    h.version = REGISTRY_FORMAT_VERSION;
+    h.recordSize = sizeof(RegistryRecord);
+    h.reserved = 0;
+    h.generation = generation;
+    h.quotaPeriod = quotaPeriod;
+    h.crc = crc32(&h, offsetof(RegistryHeader, crc));
+    return h;
+}
+
+bool RegistryHeader::isValid() const{
+    return memcmp(magic, RegistryMagic, sizeof(magic)) == 0
+        && version == REGISTRY_FORMAT_VERSION
+        && recordSize == sizeof(RegistryRecord)
+        && crc == crc32(this, offsetof(RegistryHeader, crc));
+}
+
+/**
+ * Check value of a record, any single corrupted byte changes it.
+ */
+static uint16_t recordCheck(uint32_t epoch, uint8_t user, uint8_t flags){
+    return (uint16_t)(epoch) ^ (uint16_t)(epoch >> 16) ^ (uint16_t)(user << 8 | flags) ^ 0x5254;
+}
+
+RegistryRecord RegistryRecord::make(char user, uint32_t epoch, uint8_t flags){
+    RegistryRecord r;
+    r.epoch = epoch;
+    r.user = (uint8_t)user;
+    r.flags = flags;
+    r.check = recordCheck(r.epoch, r.user, r.flags);
+    return r;
+}
+
+bool RegistryRecord::isValid() const{
+    return check == recordCheck(epoch, user, flags);
+}
+
+/**
+ * Parses a legacy text line, e.g. a2020-06-25T15:29:37
+ *
+ * @param line Text line, anything after the date (e.g. \r) is ignored.
+ * @param record Filled on success.
+ * @return True, if the line holds a user letter and a valid date, false otherwise.
+ */
+bool RegistryRecord::fromText(const char* line, RegistryRecord& record){
+
+    if(strlen(line) < 20)
+        return false;
+
+    DateTime date(line + 1);
+    if(!date.isValid())
+        return false;
+
+    record = make(line[0], date.unixtime(), RecordActivation | RecordMigrated);
+    return true;
+}
+
+/**
+ * Writes the record in the legacy text form, buffer must hold at least 21 characters.
+ */
+void RegistryRecord::toText(char* buffer, size_t size) const{
+    DateTime date(epoch);
+    snprintf(buffer, size, "%c%s", (char)user, date.timestamp(DateTime::TIMESTAMP_FULL).c_str());
+}
+
+/**
+ * Reads the header of a registry file.
+ *
+ * @return True, if the file exists and starts with a valid header, false otherwise.
+ */
+template<typename Backend>
+bool readRegistryHeader(Backend& storage, std::string_view fileName, RegistryHeader& header){
+    return storage.fileExist(fileName)
+        && storage.readBytes(fileName, 0, (uint8_t*)&header, sizeof(header))
+        && header.isValid();
+}
+
+/**
+ * Finds the registry in use : the slot of RegistrySlots whose header is valid and has the
+ * newest generation. Only the two headers are read, whatever the number of records.
+ *
+ * @param storage Where the registry lives.
+ * @param slot Filled with the index of the slot in RegistrySlots.
+ * @param header Filled with its header.
+ * @return True, if a slot holds a valid registry, false otherwise (none created yet, or torn).
+ */
+template<typename Backend>
+bool openRegistry(Backend& storage, size_t& slot, RegistryHeader& header){
+
+    RegistryHeader h[2];
+    bool valid[2];
+
+    for(size_t i = 0; i < 2; i++)
+        valid[i] = readRegistryHeader(storage, RegistrySlots[i], h[i]);
+
+    if(!valid[0] && !valid[1])
+        return false;
+
+    slot = valid[1] && (!valid[0] || h[1].generation > h[0].generation) ? 1 : 0;
+    header = h[slot];
+    return true;
+}
+
+/**
+ * A file holding only the header, whatever it held before : createFile() of some backends
+ * (mSdCard) keeps the content of an existing file.
+ */
+template<typename Backend>
+static bool startFile(Backend& storage, std::string_view fileName, const RegistryHeader& header){
+    return storage.createFile(fileName) && storage.clearFile(fileName)
+        && storage.appendBytes(fileName, (const uint8_t*)&header, sizeof(header));
+}
+
+/**
+ * Creates an empty registry, i.e. a file holding only the header. An existing file is replaced.
+ *
+ * @param storage Where the registry lives.
+ * @param fileName Registry file name.
+ * @param generation Generation of the registry, see RegistryHeader.
+ * @param quotaPeriod Month its records will belong to, 0 if unknown.
+ * @return True, if the operation was successful, false otherwise.
+ */
+template<typename Backend>
+bool createRegistry(Backend& storage, std::string_view fileName, uint32_t generation, uint32_t quotaPeriod){
+
+    return startFile(storage, fileName, RegistryHeader::make(generation, quotaPeriod));
+}
+
+/**
+ * Starts the registry of a new month in the slot that isn't in use. The slot in use isn't
+ * touched : until the new header is completely written, openRegistry() keeps choosing it,
+ * so the header write is the commit. Costs a truncate and 20 bytes, whatever the number of records.
+ *
+ * @param storage Where the registry lives.
+ * @param slot Slot in use, set to the new one on success.
+ * @param header Header of the slot in use, replaced by the new one on success.
+ * @param quotaPeriod Month of the new registry.
+ * @return True, if the operation was successful, false otherwise (the slot in use stays in use).
+ */
+template<typename Backend>
+bool renewRegistry(Backend& storage, size_t& slot, RegistryHeader& header, uint32_t quotaPeriod){
+
+    size_t next = 1 - slot;
+
+    if(!createRegistry(storage, RegistrySlots[next], header.generation + 1, quotaPeriod))
+        return false;
+
+    slot = next;
+    header = RegistryHeader::make(header.generation + 1, quotaPeriod);
+    return true;
+}
+
+/**
+ * Loads every record with a single read, no parsing involved.
+ * A torn record at the end of the file (power cut during an append) is ignored.
+ *
+ * @param storage Where the registry lives.
+ * @param fileName Registry file name.
+ * @param records Replaced by the content of the registry.
+ * @return True, if the file is a valid registry, false otherwise.
+ */
+template<typename Backend>
+bool loadRegistry(Backend& storage, std::string_view fileName, std::vector<RegistryRecord>& records){
+
+    size_t count;
+
+    if(!registryRecordCount(storage, fileName, count))
+        return false;
+
+    records.resize(count);
+
+    if(count > 0 && !readRecords(storage, fileName, 0, records.data(), count))
+        return false;
+
+    if(!records.empty() && !records.back().isValid())
+        records.pop_back();
+
+    for(const RegistryRecord& r : records)
+        if(!r.isValid())
+            return false;
+
+    return true;
+}
+
+/**
+ * Gives the number of complete records of the registry, without reading them.
+ *
+ * @param storage Where the registry lives.
+ * @param fileName Registry file name.
+ * @param count Filled with the number of records.
+ * @return True, if the file is a valid registry, false otherwise.
+ */
+template<typename Backend>
+bool registryRecordCount(Backend& storage, std::string_view fileName, size_t& count){
+
+    size_t size;
+    RegistryHeader h;
+
+    if(!storage.fileSize(fileName, size) || size < sizeof(h))
+        return false;
+
+    if(!storage.readBytes(fileName, 0, (uint8_t*)&h, sizeof(h)) || !h.isValid())
+        return false;
+
+    count = (size - sizeof(h)) / sizeof(RegistryRecord);
+    return true;
+}
+
+/**
+ * Reads count records, starting with record number first (0 being the oldest).
+ *
+ * @param storage Where the registry lives.
+ * @param fileName Registry file name.
+ * @param first Index of the first record to read.
+ * @param records Receives the records, must hold count of them.
+ * @param count Number of records to read.
+ * @return True, if every record has been read, false otherwise.
+ */
+template<typename Backend>
+bool readRecords(Backend& storage, std::string_view fileName, size_t first, RegistryRecord* records, size_t count){
+    return storage.readBytes(fileName, sizeof(RegistryHeader) + first * sizeof(RegistryRecord), (uint8_t*)records, count * sizeof(RegistryRecord));
+}
+
+/**
+ * Hands out the records, from record number first to the last complete one, by blocks
+ * of REGISTRY_READ_CHUNK read into a fixed buffer. Memory use doesn't depend on the registry size.
+ *
+ * @param storage Where the registry lives.
+ * @param fileName Registry file name.
+ * @param first Index of the first record to visit.
+ * @param visitor Called for each block, see RecordVisitor.
+ * @param context Passed as is to the visitor.
+ * @return True, if every record has been visited, false otherwise (invalid registry, read error, or stopped by the visitor).
+ */
+template<typename Backend>
+bool forEachRecord(Backend& storage, std::string_view fileName, size_t first, RecordVisitor visitor, void* context){
+
+    size_t count;
+    if(!registryRecordCount(storage, fileName, count))
+        return false;
+
+    RegistryRecord chunk[REGISTRY_READ_CHUNK];
+
+    for(size_t i = first; i < count; i += REGISTRY_READ_CHUNK){
+        size_t n = std::min((size_t)REGISTRY_READ_CHUNK, count - i);
+
+        if(!readRecords(storage, fileName, i, chunk, n) || !visitor(chunk, n, context))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Appends one record (8 bytes) to the registry. It is written after the last complete record,
+ * over the torn one a power cut during the previous append may have left.
+ */
+template<typename Backend>
+bool appendRecord(Backend& storage, std::string_view fileName, const RegistryRecord& record){
+
+    size_t size;
+
+    if(!storage.fileSize(fileName, size) || size < sizeof(RegistryHeader))
+        return false;
+
+    size_t end = size - (size - sizeof(RegistryHeader)) % sizeof(RegistryRecord);
+
+    return storage.writeBytes(fileName, end, (const uint8_t*)&record, sizeof(record));
+}
+
+/**
+ * State of a migration, records are converted into chunk and appended by blocks.
+ */
+template<typename Backend>
+struct Migration {
+    Backend& storage;
+    std::string_view binaryName;
+    RegistryRecord chunk[REGISTRY_READ_CHUNK];
+    size_t count;
+};
+
+template<typename Backend>
+static bool appendChunk(Migration<Backend>& m){
+    bool ok = m.count == 0 || m.storage.appendBytes(m.binaryName, (const uint8_t*)m.chunk, m.count * sizeof(RegistryRecord));
+    m.count = 0;
+    return ok;
+}
+
+template<typename Backend>
+static bool migrateLine(std::string_view line, void* context){
+    Migration<Backend>& m = *static_cast<Migration<Backend>*>(context);
+
+    char text[32];                          // A registry line is 20 characters long
+    if(line.size() >= sizeof(text))
+        return true;                        // Not a registry line, ignored
+
+    memcpy(text, line.data(), line.size());
+    text[line.size()] = 0;
+
+    if(RegistryRecord::fromText(text, m.chunk[m.count]))
+        m.count++;
+
+    return m.count < REGISTRY_READ_CHUNK || appendChunk(m);
+}
+
+/**
+ * One-shot conversion of the legacy text registry, streamed : memory use doesn't depend on
+ * its size. The header is written last, so an interrupted migration leaves an invalid registry
+ * and the text file untouched, and can be run again. The text file is then emptied so it
+ * won't be imported twice. The registry gets the first generation.
+ *
+ * @param storage Where both registries live.
+ * @param textName Legacy registry, one line per entry.
+ * @param binaryName Binary registry, replaced if it exists.
+ * @return True, if the operation was successful, false otherwise.
+ */
+template<typename Backend>
+bool migrateTextRegistry(Backend& storage, std::string_view textName, std::string_view binaryName){
+
+    RegistryHeader h = {};
+
+    if(!startFile(storage, binaryName, h))
+        return false;
+
+    Migration<Backend> m{storage, binaryName, {}, 0};
+
+    if(!storage.forEachLine(textName, migrateLine<Backend>, &m) || !appendChunk(m))
+        return false;
+
+    h = RegistryHeader::make(1, 0);
+
+    if(!storage.writeBytes(binaryName, 0, (const uint8_t*)&h, sizeof(h)))
+        return false;
+
+    return storage.clearFile(textName);
+}
+
+// Through Storage for the host tools, on the registry backend for the firmware (see StorageController.h)
+template bool readRegistryHeader(Storage&, std::string_view, RegistryHeader&);
+template bool openRegistry(Storage&, size_t&, RegistryHeader&);
+template bool createRegistry(Storage&, std::string_view, uint32_t, uint32_t);
+template bool renewRegistry(Storage&, size_t&, RegistryHeader&, uint32_t);
+template bool loadRegistry(Storage&, std::string_view, std::vector<RegistryRecord>&);
+template bool registryRecordCount(Storage&, std::string_view, size_t&);
+template bool readRecords(Storage&, std::string_view, size_t, RegistryRecord*, size_t);
+template bool forEachRecord(Storage&, std::string_view, size_t, RecordVisitor, void*);
+template bool appendRecord(Storage&, std::string_view, const RegistryRecord&);
+template bool migrateTextRegistry(Storage&, std::string_view, std::string_view);
+
+template bool readRegistryHeader(RtbStorage::UsageStorage&, std::string_view, RegistryHeader&);
+template bool openRegistry(RtbStorage::UsageStorage&, size_t&, RegistryHeader&);
+template bool createRegistry(RtbStorage::UsageStorage&, std::string_view, uint32_t, uint32_t);
+template bool renewRegistry(RtbStorage::UsageStorage&, size_t&, RegistryHeader&, uint32_t);
+template bool loadRegistry(RtbStorage::UsageStorage&, std::string_view, std::vector<RegistryRecord>&);
+template bool registryRecordCount(RtbStorage::UsageStorage&, std::string_view, size_t&);
+template bool readRecords(RtbStorage::UsageStorage&, std::string_view, size_t, RegistryRecord*, size_t);
+template bool forEachRecord(RtbStorage::UsageStorage&, std::string_view, size_t, RecordVisitor, void*);
+template bool appendRecord(RtbStorage::UsageStorage&, std::string_view, const RegistryRecord&);
+template bool migrateTextRegistry(RtbStorage::UsageStorage&, std::string_view, std::string_view);
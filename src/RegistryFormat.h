@@ -0,0 +1,90 @@
+/**
+ * File :      RegistryFormat.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Binary registry file : a 20 bytes header followed by packed 8 bytes records.
+ *             Replaces the ISO-8601 text lines (e.g. a2020-06-25T15:29:37), which are only
+ *             read once more by the migrator.
+ *             Two files take turns (see RegistrySlots) : a new month is started in the slot
+ *             that isn't in use, and committed by its header. Boot keeps the valid slot with
+ *             the newest generation, so a power cut during a renewal leaves the previous
+ *             month whole instead of a half cleared file.
+*/
+#ifndef REGISTRYFORMAT_H
+#define REGISTRYFORMAT_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "Storage.h"
+
+#define REGISTRY_FORMAT_VERSION 2    // Layout of RegistryHeader and RegistryRecord
+#define REGISTRY_READ_CHUNK 32      // Records read at once by forEachRecord()
+
+/**
+ * Meaning of RegistryRecord::flags
+ */
+enum RecordFlag : uint8_t {
+    RecordActivation = 0x01,    // A token has been used to open the safe
+    RecordMigrated = 0x80,      // Imported from the legacy text registry
+};
+
+/**
+ * First bytes of the file, identifies the format and the registry. Written in one go, last,
+ * the CRC tells a torn one.
+ */
+struct RegistryHeader {
+    char magic[4];              // "RTBR"
+    uint8_t version;
+    uint8_t recordSize;
+    uint16_t reserved;
+    uint32_t generation;        // One more at each renewal, the slot with the newest one is in use
+    uint32_t quotaPeriod;       // Month of the records (see quotaPeriodOf), 0 if it's only known from them
+    uint32_t crc;
+
+    static RegistryHeader make(uint32_t generation, uint32_t quotaPeriod);
+    bool isValid() const;
+};
+
+/**
+ * One registry entry, stored as is (little endian) in the file.
+ */
+struct RegistryRecord {
+    uint32_t epoch;             // Unix time of the entry
+    uint8_t user;               // User letter
+    uint8_t flags;              // See RecordFlag
+    uint16_t check;             // Detects torn or corrupted records
+
+    static RegistryRecord make(char user, uint32_t epoch, uint8_t flags = RecordActivation);
+    static bool fromText(const char* line, RegistryRecord& record);
+
+    bool isValid() const;
+    void toText(char* buffer, size_t size) const;
+};
+
+/**
+ * Called by forEachRecord() for every block of records. The block is only valid during
+ * the call. Returning false stops the reading.
+ */
+typedef bool (*RecordVisitor)(const RegistryRecord* records, size_t count, void* context);
+
+static_assert(sizeof(RegistryHeader) == 20, "RegistryHeader must stay 20 bytes long");
+static_assert(sizeof(RegistryRecord) == 8, "RegistryRecord must stay 8 bytes long");
+
+/**
+ * Templates on the storage : Storage for the host tools, the registry backend of the firmware
+ * (see StorageController.h) whose calls are direct. Instantiated in RegistryFormat.cpp.
+ */
+template<typename Backend> bool readRegistryHeader(Backend& storage, std::string_view fileName, RegistryHeader& header);
+template<typename Backend> bool openRegistry(Backend& storage, size_t& slot, RegistryHeader& header);
+template<typename Backend> bool createRegistry(Backend& storage, std::string_view fileName, uint32_t generation = 1, uint32_t quotaPeriod = 0);
+template<typename Backend> bool renewRegistry(Backend& storage, size_t& slot, RegistryHeader& header, uint32_t quotaPeriod);
+template<typename Backend> bool loadRegistry(Backend& storage, std::string_view fileName, std::vector<RegistryRecord>& records);
+template<typename Backend> bool registryRecordCount(Backend& storage, std::string_view fileName, size_t& count);
+template<typename Backend> bool readRecords(Backend& storage, std::string_view fileName, size_t first, RegistryRecord* records, size_t count);
+template<typename Backend> bool forEachRecord(Backend& storage, std::string_view fileName, size_t first, RecordVisitor visitor, void* context);
+template<typename Backend> bool appendRecord(Backend& storage, std::string_view fileName, const RegistryRecord& record);
+template<typename Backend> bool migrateTextRegistry(Backend& storage, std::string_view textName, std::string_view binaryName);
+
+#endif
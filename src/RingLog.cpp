@@ -0,0 +1,226 @@
+#include "RingLog.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "Checksum.h"
+#include "StorageController.h"
+
+static const char RingLogMagic[4] = {'R', 'T', 'B', 'L'};
+static const size_t EntryHeaderSize = offsetof(RingLogEntry, text);
+static const size_t CreateChunkSlots = 8;       // Empty slots appended at once when the file is created
+
+RingLogHeader RingLogHeader::empty(){
+    RingLogHeader h = {};
+    memcpy(h.magic, RingLogMagic, sizeof(h.magic));
+    h.version = RING_LOG_FORMAT_VERSION;
+    h.slotSize = RING_LOG_SLOT_SIZE;
+    h.slotCount = RING_LOG_SLOTS;
+    h.next = 0;
+    h.crc = crc32(&h, offsetof(RingLogHeader, crc));
+    return h;
+}
+
+/**
+ * @return True, if the header hasn't been torn, whatever its format.
+ */
+bool RingLogHeader::isIntact() const{
+    return memcmp(magic, RingLogMagic, sizeof(magic)) == 0 && crc == crc32(this, offsetof(RingLogHeader, crc));
+}
+
+bool RingLogHeader::isValid() const{
+    return isIntact()
+        && version == RING_LOG_FORMAT_VERSION
+        && slotSize == RING_LOG_SLOT_SIZE
+        && slotCount == RING_LOG_SLOTS;
+}
+
+/**
+ * Check value of an entry, covers its header and its text.
+ */
+static uint16_t entryCheck(const RingLogEntry& e){
+    uint32_t crc = crc32(&e, offsetof(RingLogEntry, check));
+    crc = crc32(e.text, std::min((size_t)e.length, sizeof(e.text)), crc);
+    return (uint16_t)(crc ^ (crc >> 16)) ^ 0x524C;
+}
+
+/**
+ * @return True, if the slot holds entry number sequence, complete.
+ */
+static bool isEntry(const RingLogEntry& e, uint32_t sequence){
+    return e.sequence == sequence && e.length <= sizeof(e.text) && e.check == entryCheck(e);
+}
+
+template<typename Backend>
+size_t RingLog<Backend>::slotOffset(uint32_t sequence) const{
+    return sizeof(RingLogHeader) + (size_t)(sequence % RING_LOG_SLOTS) * sizeof(RingLogEntry);
+}
+
+template<typename Backend>
+uint32_t RingLog<Backend>::entries() const{
+    return std::min(_header.next, (uint32_t)RING_LOG_SLOTS);
+}
+
+/**
+ * Opens the log, creates it if it doesn't exist or isn't a ring of this size and format. A header
+ * torn by a power cut is rebuilt from the slots, one left behind the last entry is moved forward.
+ *
+ * @return True, if the log can be written, false otherwise.
+ */
+template<typename Backend>
+bool RingLog<Backend>::open(){
+
+    size_t size = 0;
+    size_t expected = sizeof(RingLogHeader) + RING_LOG_SLOTS * sizeof(RingLogEntry);
+
+    _ready = false;
+
+    if(!_storage.fileExist(_fileName) || !_storage.fileSize(_fileName, size) || size != expected)
+        return _ready = create();
+
+    if(!_storage.readBytes(_fileName, 0, (uint8_t*)&_header, sizeof(_header)) || _header.isIntact() != _header.isValid())
+        return _ready = create();
+
+    if(!_header.isValid())
+        return _ready = recover() || create();
+
+    // A power cut between a slot and the header : the slot is there, the header doesn't count it
+    RingLogEntry e;
+    bool behind = false;
+
+    for(uint32_t i = 0; i < RING_LOG_SLOTS && readSlot(_header.next, e); i++){
+        _header.next++;
+        behind = true;
+    }
+
+    return _ready = !behind || writeHeader();
+}
+
+/**
+ * Writes one entry over the oldest one.
+ *
+ * @param text Entry, cut at RING_LOG_SLOT_SIZE - 12 bytes.
+ * @param epoch Unix time of the entry, 0 if unknown.
+ * @return True, if the entry and the header have been written, false otherwise.
+ */
+template<typename Backend>
+bool RingLog<Backend>::append(std::string_view text, uint32_t epoch){
+
+    if(!_ready)
+        return false;
+
+    RingLogEntry e;
+    e.sequence = _header.next;
+    e.epoch = epoch;
+    e.length = (uint16_t)std::min(text.size(), sizeof(e.text));
+    memcpy(e.text, text.data(), e.length);
+    e.check = entryCheck(e);
+
+    if(!_storage.writeBytes(_fileName, slotOffset(e.sequence), (const uint8_t*)&e, EntryHeaderSize + e.length))
+        return false;
+
+    _header.next++;
+
+    return writeHeader();
+}
+
+/**
+ * Hands out up to count entries, newest first, reading only their slots. Slots a power cut has
+ * torn are skipped.
+ *
+ * @param count Most entries to visit.
+ * @param visitor Called for each entry, see LogEntryVisitor.
+ * @param context Passed as is to the visitor.
+ * @return True, if the entries have been visited, false otherwise (read error, or stopped by the visitor).
+ */
+template<typename Backend>
+bool RingLog<Backend>::forEachNewest(size_t count, LogEntryVisitor visitor, void* context){
+
+    if(!_ready)
+        return false;
+
+    RingLogEntry e;
+    uint32_t oldest = _header.next - entries();
+
+    for(uint32_t s = _header.next; s > oldest && count > 0; s--, count--){
+        if(!_storage.readBytes(_fileName, slotOffset(s - 1), (uint8_t*)&e, sizeof(e)))
+            return false;
+
+        if(isEntry(e, s - 1) && !visitor(e, context))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Empty ring : header, then every slot zeroed, so the file never changes size afterwards.
+ */
+template<typename Backend>
+bool RingLog<Backend>::create(){
+
+    static const uint8_t empty[CreateChunkSlots * sizeof(RingLogEntry)] = {};
+
+    _header = RingLogHeader::empty();
+
+    // createFile() of some backends keeps the content of an existing file
+    if(!_storage.createFile(_fileName) || !_storage.clearFile(_fileName)
+        || !_storage.appendBytes(_fileName, (const uint8_t*)&_header, sizeof(_header)))
+        return false;
+
+    for(size_t i = 0; i < RING_LOG_SLOTS; i += CreateChunkSlots){
+        size_t n = std::min(CreateChunkSlots, RING_LOG_SLOTS - i);
+
+        if(!_storage.appendBytes(_fileName, empty, n * sizeof(RingLogEntry)))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Rebuilds a torn header from the slots : the next entry follows the one with the highest sequence.
+ * Only happens after a power cut during a header write, it reads the whole ring.
+ *
+ * @return True, if the file holds a ring and its header has been written again, false otherwise.
+ */
+template<typename Backend>
+bool RingLog<Backend>::recover(){
+
+    RingLogEntry e;
+    uint32_t next = 0;
+
+    for(uint32_t i = 0; i < RING_LOG_SLOTS; i++){
+        if(!_storage.readBytes(_fileName, slotOffset(i), (uint8_t*)&e, sizeof(e)))
+            return false;
+
+        if(e.sequence % RING_LOG_SLOTS == i && isEntry(e, e.sequence))
+            next = std::max(next, e.sequence + 1);
+    }
+
+    _header = RingLogHeader::empty();
+    _header.next = next;
+
+    return writeHeader();
+}
+
+/**
+ * Reads entry number sequence.
+ *
+ * @return True, if its slot holds it, complete, false otherwise.
+ */
+template<typename Backend>
+bool RingLog<Backend>::readSlot(uint32_t sequence, RingLogEntry& entry){
+    return _storage.readBytes(_fileName, slotOffset(sequence), (uint8_t*)&entry, sizeof(entry)) && isEntry(entry, sequence);
+}
+
+template<typename Backend>
+bool RingLog<Backend>::writeHeader(){
+    _header.crc = crc32(&_header, offsetof(RingLogHeader, crc));
+    return _storage.writeBytes(_fileName, 0, (const uint8_t*)&_header, sizeof(_header));
+}
+
+// The error log of the storage configuration (see StorageController.h), any Storage for the host tools
+template class RingLog<Storage>;
+template class RingLog<RtbStorage::LogStorage>;
@@ -0,0 +1,92 @@
+/**
+ * File :      RingLog.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Error log of fixed size : a small header followed by RING_LOG_SLOTS slots written
+ *             in turn, the newest entry overwriting the oldest one. Replaces the text log that
+ *             grew forever. An entry costs two writes (its slot, then the header), whatever the
+ *             age of the log, and the newest entries are read without going through the file.
+*/
+#ifndef RINGLOG_H
+#define RINGLOG_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "Storage.h"
+
+#define RING_LOG_FORMAT_VERSION 2   // 2 : entries hold events (see EventLog.h) instead of text
+#define RING_LOG_SLOTS 128          // Entries kept, the file is 12 KB long
+#define RING_LOG_SLOT_SIZE 96       // Bytes per entry, longer data is cut
+
+/**
+ * First bytes of the file. next is rewritten after each entry, the CRC tells a torn header.
+ */
+struct RingLogHeader {
+    char magic[4];                  // "RTBL"
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t slotSize;
+    uint16_t slotCount;
+    uint16_t reserved2;
+    uint32_t next;                  // Sequence number of the next entry, it goes in slot next % slotCount
+    uint32_t crc;
+
+    static RingLogHeader empty();
+    bool isIntact() const;
+    bool isValid() const;
+};
+
+/**
+ * One slot. Only the first length bytes of text are written, they may be binary (e.g. packed events).
+ */
+struct RingLogEntry {
+    uint32_t sequence;              // Number of entries written before this one
+    uint32_t epoch;                 // Unix time, 0 if the RTC wasn't available
+    uint16_t length;                // Bytes of text used
+    uint16_t check;                 // Detects torn or stale slots
+    char text[RING_LOG_SLOT_SIZE - 12];
+
+    std::string_view view() const { return std::string_view(text, length); }
+};
+
+/**
+ * Called by forEachNewest() for every entry, newest first. Returning false stops the reading.
+ */
+typedef bool (*LogEntryVisitor)(const RingLogEntry& entry, void* context);
+
+static_assert(sizeof(RingLogHeader) == 20, "RingLogHeader must stay 20 bytes long");
+static_assert(sizeof(RingLogEntry) == RING_LOG_SLOT_SIZE, "RingLogEntry must fill its slot");
+
+/**
+ * The storage type is a template parameter : over the log storage of the firmware (see
+ * StorageController.h) its calls are direct, RingLog<> goes through Storage.
+ */
+template<typename Backend = Storage>
+class RingLog {
+private:
+    Backend& _storage;
+    std::string_view _fileName;     // A name of DEFINITIONS.hpp, outlives the log
+    RingLogHeader _header = {};
+    bool _ready = false;
+
+    bool create();
+    bool recover();
+    bool readSlot(uint32_t sequence, RingLogEntry& entry);
+    bool writeHeader();
+    size_t slotOffset(uint32_t sequence) const;
+
+public:
+    RingLog(Backend& storage, std::string_view fileName) : _storage(storage), _fileName(fileName) {}
+    RingLog(const RingLog &l) = delete;
+
+    bool open();
+    bool append(std::string_view text, uint32_t epoch);
+    bool forEachNewest(size_t count, LogEntryVisitor visitor, void* context);
+
+    bool isOpen() const { return _ready; }
+    uint32_t next() const { return _header.next; }
+    uint32_t entries() const;
+};
+
+#endif
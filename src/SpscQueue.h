@@ -0,0 +1,58 @@
+/**
+ * File :      SpscQueue.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Lock-free ring buffer for exactly one producer and one consumer
+ *             (e.g. a timer callback and loop(), or two tasks). No allocation, no blocking.
+*/
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    T _items[Capacity];
+    std::atomic<uint32_t> _head{0};     // Next slot to read, owned by the consumer
+    std::atomic<uint32_t> _tail{0};     // Next slot to write, owned by the producer
+
+public:
+    /**
+     * Producer side. Returns false, and drops the item, if the queue is full.
+     */
+    bool push(const T& item){
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if(tail - _head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        _items[tail & (Capacity - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side. Returns false if the queue is empty.
+     */
+    bool pop(T& item){
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if(head == _tail.load(std::memory_order_acquire))
+            return false;
+        item = _items[head & (Capacity - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const{
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    size_t size() const{
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "Storage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Trace.h"
+
+/**
+ * Hands out every line of a text file, read by blocks into a fixed buffer through readBytes().
+ * "\r\n" and "\n" ends are both accepted, a last line without end is handed out too.
+ *
+ * @param fileName File name.
+ * @param visitor Called for each line, see LineVisitor.
+ * @param context Passed as is to the visitor.
+ * @return True, if every line has been visited, false otherwise (read error, line longer
+ *         than STREAM_BUFFER_SIZE, or stopped by the visitor).
+ */
+bool Storage::forEachLine(std::string_view fileName, LineVisitor visitor, void* context){
+    TRACE_SCOPE(TraceForEachLine);
+
+    size_t size;
+    if(!fileSize(fileName, size))
+        return false;
+
+    char buffer[STREAM_BUFFER_SIZE];
+    size_t used = 0;        // Bytes of the buffer not handed out yet
+    size_t offset = 0;      // File position of the end of the buffer
+
+    while(offset < size || used > 0){
+
+        size_t n = std::min(sizeof(buffer) - used, size - offset);
+        if(n > 0){
+            if(!readBytes(fileName, offset, (uint8_t*)buffer + used, n))
+                return false;
+            offset += n;
+            used += n;
+        }
+
+        size_t start = 0;
+        for(size_t i = 0; i < used; i++){
+            if(buffer[i] != '\n')
+                continue;
+
+            size_t end = (i > start && buffer[i - 1] == '\r') ? i - 1 : i;
+            if(!visitor(std::string_view(buffer + start, end - start), context))
+                return false;
+            start = i + 1;
+        }
+
+        if(offset == size && start < used){     // Last line, without end
+            if(!visitor(std::string_view(buffer + start, used - start), context))
+                return false;
+            start = used;
+        }
+
+        if(start == 0 && used == sizeof(buffer))
+            return false;                       // No end of line in a full buffer
+
+        memmove(buffer, buffer + start, used - start);
+        used -= start;
+    }
+
+    return true;
+}
+
+/**
+ * Hands out every line of a file already in memory (RAM or mapped), without copying it.
+ * Same line ends as forEachLine(), lines have no length limit.
+ *
+ * @param text Whole content of the file.
+ * @param visitor Called for each line, see LineVisitor.
+ * @param context Passed as is to the visitor.
+ * @return True, if every line has been visited, false if stopped by the visitor.
+ */
+bool Storage::forEachLineIn(std::string_view text, LineVisitor visitor, void* context){
+
+    while(!text.empty()){
+        size_t i = text.find('\n');
+        std::string_view line = text.substr(0, i);
+
+        if(i != std::string_view::npos && !line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        if(!visitor(line, context))
+            return false;
+
+        text.remove_prefix(i == std::string_view::npos ? text.size() : i + 1);
+    }
+
+    return true;
+}
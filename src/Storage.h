@@ -7,10 +7,20 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
-#include <string>	// Library for string
+#include <string_view>
 #include <vector>	// Library for vector
+#include <cstdint>
 #include "DEFINITIONS.hpp"
 
+#define STREAM_BUFFER_SIZE 128  // Longest line forEachLine() can hand out, end of line included
+#define FILE_NAME_SIZE 32       // Longest file name the backends open, end of string included
+
+/**
+ * Called by forEachLine() for every line, without its end of line. The slice is only valid
+ * during the call. Returning false stops the reading.
+ */
+typedef bool (*LineVisitor)(std::string_view line, void* context);
+
 class Storage {
     
 public:
@@ -18,11 +28,27 @@ public:
 
     virtual bool init() = 0;
     
-    virtual bool fileExist(const std::string registreName) = 0;
-    virtual bool createFile(const std::string fileName) = 0;
-    virtual bool readFrom(const std::string fileName, std::vector<std::string>& vect) = 0;
-    virtual bool addLine(const std::string fileName, const std::string line) = 0;
-    virtual bool clearFile(const std::string fileName) = 0;
+    // Names and lines are only read during the call, backends copy what they keep
+    virtual bool fileExist(std::string_view registreName) = 0;
+    virtual bool createFile(std::string_view fileName) = 0;
+    virtual bool addLine(std::string_view fileName, std::string_view line) = 0;
+    virtual bool clearFile(std::string_view fileName) = 0;
+
+    // Binary access, used by the registry (see RegistryFormat.h)
+    virtual bool fileSize(std::string_view fileName, size_t& size) = 0;
+    virtual bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) = 0;
+    virtual bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) = 0;
+    virtual bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) = 0;
+
+    // Writes what a layer keeps in RAM (see JournaledStorage.h), backends write through
+    virtual bool sync() { return true; }
+
+    // Streaming read of a text file, memory use doesn't depend on the file size
+    virtual bool forEachLine(std::string_view fileName, LineVisitor visitor, void* context);
+
+protected:
+    // Same, for backends that hold the whole file in memory
+    static bool forEachLineIn(std::string_view text, LineVisitor visitor, void* context);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+/**
+ * File :      StorageController.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Storages of the firmware, chosen at compile time : the backend of the registry and
+ *             the backend of the error log, held by value so nothing is allocated. No file is
+ *             batched on the device, so there is no journal between them and their callers. The
+ *             registry helpers (RegistryFormat.h, Checkpoint.h, Archive.h, Audit.h) and the error
+ *             log (RingLog.h) are templates on the storage type, instantiated for these backends,
+ *             which are final so their calls are direct, and for Storage, which the host tools
+ *             of ./native go through.
+*/
+#ifndef STORAGECONTROLLER_H
+#define STORAGECONTROLLER_H
+
+#include "DEFINITIONS.hpp"
+#include "FlashMem.h"
+#include "mSdCard.h"
+#include "NullStorage.h"
+
+/**
+ * Registry on UsageBackend, error log and archive on LogBackend.
+ */
+template<typename UsageBackend, typename LogBackend>
+class StorageController{
+public:
+    typedef UsageBackend UsageStorage;
+    typedef LogBackend LogStorage;
+    typedef LogStorage ArchiveStorage;      // It only grows, it goes on the SD card
+
+    static constexpr bool HasLog = true;   // False when the error log goes nowhere
+
+private:
+    UsageStorage _usage;
+    LogStorage _log;
+
+public:
+    StorageController() = default;
+    StorageController(const StorageController &s) = delete;
+
+    UsageStorage& usage() { return _usage; }
+    LogStorage& log() { return _log; }
+    ArchiveStorage& archive() { return _log; }
+
+    bool initUsage() { return _usage.init(); }
+    bool initLog() { return _log.init(); }
+};
+
+/**
+ * No error log : its calls are the inline ones of NullStorage. The archive goes with the registry.
+ */
+template<typename UsageBackend>
+class StorageController<UsageBackend, NullStorage>{
+public:
+    typedef UsageBackend UsageStorage;
+    typedef NullStorage LogStorage;
+    typedef UsageStorage ArchiveStorage;
+
+    static constexpr bool HasLog = false;
+
+private:
+    UsageStorage _usage;
+    NullStorage _log;
+
+public:
+    StorageController() = default;
+    StorageController(const StorageController &s) = delete;
+
+    UsageStorage& usage() { return _usage; }
+    LogStorage& log() { return _log; }
+    ArchiveStorage& archive() { return _usage; }
+
+    bool initUsage() { return _usage.init(); }
+    bool initLog() { return true; }
+};
+
+/**
+ * One backend for everything, started once.
+ */
+template<typename Backend>
+class StorageController<Backend, Backend>{
+public:
+    typedef Backend UsageStorage;
+    typedef Backend LogStorage;
+    typedef Backend ArchiveStorage;
+
+    static constexpr bool HasLog = true;
+
+private:
+    Backend _backend;
+
+public:
+    StorageController() = default;
+    StorageController(const StorageController &s) = delete;
+
+    UsageStorage& usage() { return _backend; }
+    LogStorage& log() { return _backend; }
+    ArchiveStorage& archive() { return _backend; }
+
+    bool initUsage() { return _backend.init(); }
+    bool initLog() { return true; }
+};
+
+// Storages of the firmware (see USE_INTERNAL_MEMORY and USE_SD_CARD in DEFINITIONS.hpp)
+#if USE_INTERNAL_MEMORY && USE_SD_CARD
+    typedef StorageController<FlashMem, mSdCard> RtbStorage;
+#elif USE_INTERNAL_MEMORY && !USE_SD_CARD
+    typedef StorageController<FlashMem, NullStorage> RtbStorage;
+#elif !USE_INTERNAL_MEMORY && USE_SD_CARD
+    typedef StorageController<mSdCard, mSdCard> RtbStorage;
+#else
+    #error At least one storage must be set to true (see: DEFINITIONS.hpp)
+#endif
+
+#endif
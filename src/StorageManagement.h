@@ -2,7 +2,9 @@
  * Include of all storage type
 */
 
-#include "storage.h"
+#include "Storage.h"
 #include "mSdCard.h"
 #include "FlashMem.h"
-#include "NullStorage.h"
\ No newline at end of file
+#include "NullStorage.h"
+#include "JournaledStorage.h"
+#include "StorageController.h"
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <cstring>
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+
+#include "Checksum.h"
+
+/**
+ * Events and histograms of one core. Only tasks of that core write them, but they may preempt
+ * each other : slots are reserved by an atomic increment and published by their sequence number.
+ */
+struct TraceRing {
+    struct Slot {
+        std::atomic<uint32_t> sequence;     // Number of the event plus one, 0 while it is written
+        TraceEvent event;
+    } slots[TRACE_RING_SIZE];
+    std::atomic<uint32_t> head;             // Events recorded
+    uint32_t exported;                      // Events sent, only traceExport() changes it
+    std::atomic<uint32_t> buckets[TracePointCount][TRACE_BUCKETS];
+    std::atomic<uint32_t> maxCycles[TracePointCount];
+};
+
+static TraceRing rings[TRACE_CORES];
+
+static const char* const TracePointNames[TracePointCount] = {
+    "keypadInput",
+    "returnUserIndex",
+    "updateState",
+    "openLock",
+    "rtcNow",
+    "storageInit",
+    "fileExist",
+    "createFile",
+    "addLine",
+    "clearFile",
+    "fileSize",
+    "readBytes",
+    "appendBytes",
+    "writeBytes",
+    "sync",
+    "forEachLine",
+    "journalPoll",
+};
+
+/**
+ * Stores a tracepoint that ends now, from any task. Doesn't allocate, doesn't wait : two atomic
+ * increments, 16 bytes written and, rarely, a new maximum.
+ *
+ * @param point What was measured.
+ * @param start Cycle counter when it started (see traceCycles).
+ * @param arg Detail of the point, see TracePoint.
+ * @return Void.
+ */
+void IRAM_ATTR traceRecord(TracePoint point, uint32_t start, uint16_t arg){
+    uint32_t cycles = traceCycles() - start;
+    uint8_t core = (uint8_t)xPortGetCoreID() % TRACE_CORES;
+    TraceRing& ring = rings[core];
+
+    uint32_t s = ring.head.fetch_add(1, std::memory_order_relaxed);
+    TraceRing::Slot& slot = ring.slots[s % TRACE_RING_SIZE];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    slot.event = {start, cycles, point, core, arg};
+    slot.sequence.store(s + 1, std::memory_order_release);
+
+    ring.buckets[point][cycles ? 31 - __builtin_clz(cycles) : 0].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t max = ring.maxCycles[point].load(std::memory_order_relaxed);
+    while(cycles > max && !ring.maxCycles[point].compare_exchange_weak(max, cycles, std::memory_order_relaxed)){}
+}
+
+const char* tracePointName(uint8_t point){
+    return point < TracePointCount ? TracePointNames[point] : "unknown";
+}
+
+/**
+ * Builds a frame and sends it whole, see TraceFrameType.
+ */
+class TraceFrame {
+private:
+    uint8_t _bytes[3 + TRACE_FRAME_SIZE + 4];
+    size_t _length = 0;
+
+public:
+    void begin(TraceFrameType type){
+        _bytes[0] = TRACE_SYNC;
+        _bytes[1] = type;
+        _length = 3;
+    }
+
+    size_t room() const{ return 3 + TRACE_FRAME_SIZE - _length; }
+
+    void byte(uint8_t b){
+        _bytes[_length++] = b;
+    }
+
+    void varint(uint32_t v){
+        while(v >= 0x80){
+            byte((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        byte((uint8_t)v);
+    }
+
+    void signedVarint(int32_t v){
+        varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+    }
+
+    bool send(Print& out){
+        _bytes[2] = (uint8_t)(_length - 3);
+        uint32_t crc = crc32(_bytes + 1, _length - 1);
+        for(int i = 0; i < 4; i++)
+            _bytes[_length++] = (uint8_t)(crc >> (8 * i));
+        return out.write(_bytes, _length) == _length;
+    }
+};
+
+/**
+ * Sends the events of a core recorded since the previous export. Events overwritten before, or
+ * being overwritten while they are read, are counted as lost.
+ */
+static bool exportEvents(Print& out, uint8_t core, TraceFrame& frame){
+    static const size_t LongestEvent = 1 + 5 + 5 + 3;
+
+    TraceRing& ring = rings[core];
+    uint32_t end = ring.head.load(std::memory_order_acquire);
+    uint32_t lost = 0;
+    uint32_t previous = 0;
+    bool ok = true;
+
+    if(end - ring.exported > TRACE_RING_SIZE){
+        lost = end - ring.exported - TRACE_RING_SIZE;
+        ring.exported = end - TRACE_RING_SIZE;
+    }
+
+    frame.begin(TraceFrameEvents);
+    frame.byte(core);
+    frame.varint(0);
+
+    for(uint32_t s = ring.exported; s != end; s++){
+        TraceRing::Slot& slot = ring.slots[s % TRACE_RING_SIZE];
+
+        // Still being written, or reserved but still holding the previous lap's number :
+        // the next export takes it, and those after it
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if(sequence == 0 || (int32_t)(sequence - (s + 1)) < 0){
+            end = s;
+            break;
+        }
+        TraceEvent e = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(sequence != s + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence){
+            lost++;             // Overwritten by a newer event
+            continue;
+        }
+
+        if(frame.room() < LongestEvent){
+            ok = frame.send(out) && ok;
+            frame.begin(TraceFrameEvents);
+            frame.byte(core);
+            frame.varint(0);
+            previous = 0;
+        }
+
+        frame.byte(e.point);
+        frame.signedVarint((int32_t)(e.start - previous));
+        frame.varint(e.cycles);
+        frame.varint(e.arg);
+        previous = e.start;
+    }
+    ok = frame.send(out) && ok;
+
+    ring.exported = end;
+
+    // Lost events are only known once the others are read : counted by a frame without events
+    if(lost > 0){
+        frame.begin(TraceFrameEvents);
+        frame.byte(core);
+        frame.varint(lost);
+        ok = frame.send(out) && ok;
+    }
+    return ok;
+}
+
+/**
+ * Histograms of a core, points never recorded aren't sent.
+ */
+static bool exportHistograms(Print& out, uint8_t core, TraceFrame& frame){
+    TraceRing& ring = rings[core];
+    bool ok = true;
+
+    for(uint8_t p = 0; p < TracePointCount; p++){
+        uint32_t counts[TRACE_BUCKETS];
+        uint32_t total = 0;
+
+        for(size_t b = 0; b < TRACE_BUCKETS; b++)
+            total += counts[b] = ring.buckets[p][b].load(std::memory_order_relaxed);
+        if(total == 0)
+            continue;
+
+        frame.begin(TraceFrameHistogram);
+        frame.byte(core);
+        frame.byte(p);
+        frame.varint(total);
+        frame.varint(ring.maxCycles[p].load(std::memory_order_relaxed));
+        for(size_t b = 0; b < TRACE_BUCKETS; b++){
+            if(counts[b] == 0)
+                continue;
+            frame.byte((uint8_t)b);
+            frame.varint(counts[b]);
+        }
+        ok = frame.send(out) && ok;
+    }
+    return ok;
+}
+
+/**
+ * Sends the names of the points, the events recorded since the previous export and the
+ * histograms since boot, as binary frames (see TraceFrameType). Only one task may export.
+ *
+ * @param out Where the frames go, e.g. the serial port.
+ * @return True, if every frame has been written, false otherwise (the events sent are not sent again).
+ */
+bool traceExport(Print& out){
+    TraceFrame frame;
+    bool ok = true;
+
+    frame.begin(TraceFrameInfo);
+    frame.byte(TRACE_VERSION);
+    frame.varint(ESP.getCpuFreqMHz());
+    frame.byte(TracePointCount);
+    frame.byte(TRACE_CORES);
+    ok = frame.send(out) && ok;
+
+    for(uint8_t p = 0; p < TracePointCount; p++){
+        frame.begin(TraceFramePoint);
+        frame.byte(p);
+        for(const char* c = TracePointNames[p]; *c; c++)
+            frame.byte((uint8_t)*c);
+        ok = frame.send(out) && ok;
+    }
+
+    for(uint8_t core = 0; core < TRACE_CORES; core++)
+        ok = exportEvents(out, core, frame) && ok;
+
+    for(uint8_t core = 0; core < TRACE_CORES; core++)
+        ok = exportHistograms(out, core, frame) && ok;
+
+    frame.begin(TraceFrameEnd);
+    return frame.send(out) && ok;
+}
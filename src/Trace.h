@@ -0,0 +1,116 @@
+/**
+ * File :      Trace.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Always-on tracepoints on the hot path (keypad input, user lookup, state update,
+ *             storage, RTC reads, lock). Each one stores its start and length, in CPU cycles,
+ *             in a ring of its core and in a histogram of lengths, without a lock or a clock read
+ *             other than the cycle counter. The "trace" serial command sends what was recorded
+ *             since the previous one as binary frames, that the host tool (src/native/TraceExport.cpp)
+ *             turns into a Chrome trace (chrome://tracing, ui.perfetto.dev).
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+
+#include "DEFINITIONS.hpp"
+
+#define TRACE_CORES 2               // Rings, one per core of the ESP32
+#define TRACE_RING_SIZE 256         // Events of a ring, older ones are overwritten if no one exports them
+#define TRACE_BUCKETS 32            // Histogram buckets, bucket b holds lengths of 2^b to 2^(b+1)-1 cycles
+#define TRACE_FRAME_SIZE 255        // Longest frame payload
+
+/**
+ * What a tracepoint measures. Numbers are sent to the host with their names, they may change.
+ */
+enum TracePoint : uint8_t {
+    TraceKeypadInput,               // A code read from the keypad (polls that find none aren't recorded)
+    TraceUserIndex,
+    TraceUpdateState,
+    TraceOpenLock,
+    TraceRtcNow,                    // I2C read of the DS3231
+    TraceStorageInit,
+    TraceFileExist,
+    TraceCreateFile,
+    TraceAddLine,
+    TraceClearFile,
+    TraceFileSize,
+    TraceReadBytes,
+    TraceAppendBytes,
+    TraceWriteBytes,
+    TraceSync,
+    TraceForEachLine,
+    TraceJournalPoll,
+    TracePointCount
+};
+
+/**
+ * One recorded tracepoint.
+ */
+struct TraceEvent {
+    uint32_t start;                 // Cycle counter when it started
+    uint32_t cycles;                // Length
+    uint8_t point;                  // See TracePoint
+    uint8_t core;
+    uint16_t arg;                   // Meaning depends on the point (e.g. bytes), 0 if unused
+};
+
+/**
+ * Frame types. A frame is TraceSync, its type, the payload length (1 byte), the payload and
+ * the CRC-32 of type, length and payload (4 bytes, little endian). Numbers in payloads are
+ * LEB128 varints, signed ones zigzag encoded.
+ */
+enum TraceFrameType : uint8_t {
+    TraceFrameInfo = 1,             // Version, CPU MHz, number of points, number of cores
+    TraceFramePoint,                // Point number, then its name
+    TraceFrameEvents,               // Core, events lost before this frame, then per event : point, start - previous start (signed), cycles, arg
+    TraceFrameHistogram,            // Core, point, count, max cycles, then per non empty bucket : bucket, count
+    TraceFrameEnd
+};
+
+#define TRACE_SYNC 0xA5
+#define TRACE_VERSION 1
+
+void traceRecord(TracePoint point, uint32_t start, uint16_t arg = 0);
+bool traceExport(Print& out);
+const char* tracePointName(uint8_t point);
+
+/**
+ * Current value of the cycle counter of the core.
+ */
+inline uint32_t traceCycles(){
+    return ESP.getCycleCount();
+}
+
+/**
+ * Records the lifetime of a scope, see TRACE_SCOPE.
+ */
+class TraceScope {
+private:
+    uint32_t _start;
+    TracePoint _point;
+    uint16_t _arg;
+
+public:
+    explicit TraceScope(TracePoint point, size_t arg = 0) : _start(traceCycles()), _point(point), _arg(arg > UINT16_MAX ? UINT16_MAX : (uint16_t)arg) {}
+    ~TraceScope(){ traceRecord(_point, _start, _arg); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#if USE_TRACING
+    #define TRACE_SCOPE(point) TraceScope traceScope(point)
+    #define TRACE_SCOPE_ARG(point, arg) TraceScope traceScope(point, arg)
+    #define TRACE_RECORD(point, start, arg) traceRecord(point, start, arg)
+#else
+    #define TRACE_SCOPE(point)
+    #define TRACE_SCOPE_ARG(point, arg)
+    #define TRACE_RECORD(point, start, arg) (void)(start)
+#endif
+
+#endif
@@ -2,77 +2,118 @@
 Program :   User.hpp
 Author :    Loïc Bouillon
 Date :      01/06/2022
-Purpose :   User class that holds every data needed for verification and access rights
+Purpose :   User class that holds every data needed for verification and access rights.
+            Letter, password and tokens are read from UsersPrep (flash), only the
+            counters live in RAM.
 **************************************************************************************/
 #pragma once
-#include <string>
-
-using namespace std;
+#include <cstdint>
+#include "DEFINITIONS.hpp"
 
 class User {
 private:
-    char _letterIdentifier;     // Identify the user
-    string _password;           // User's password
-    int _tokens;                // How often the user is allowed to access content
-    int _usedTokens;            // How often the user has accessed content
+    uint16_t _config;           // Position of the user in UsersPrep
+    int _usedTokens;            // Tokens of the user in the registry, i.e. this month
+    uint32_t _lastActivation;   // Unix time of the user's last access (0 if none)
+    Quota _quota;               // Decides if a token can be spent, see QuotaPolicy.h
 
 public:
-    User();
-    User(const User &u);// = default
-    ~User();
+    User() = default;
 
-    void init(const char let, const string pwd, int tokens, int usedTokens = 0);
+    void init(size_t config, int usedTokens = 0);
 
     void resetUsedTokens();     // Reset to zero _usedTokens
-    void addUsedTokens();       // Increment value of _usedTokens
+    void useToken(uint32_t epoch);  // Count an access in _usedTokens, _lastActivation and the quota
+    void restore(int usedTokens, uint32_t lastActivation, const QuotaState& quota);  // Set counters saved in a checkpoint
     
-    char getLetter()const;      // Return value of _letterIdentifier
-    string getPwd()const;       // Return value of _password
-    int getTokens() const;      // Return value of _tokens
+    char getLetter()const;      // Return the letter identifying the user
+    const char* getPwd()const;  // Return the user's password
+    int getTokens() const;      // Return how many tokens the user's policy allows
     int getUsedTokens() const;  // Return value of _usedTokens
-    bool isAllowed() const;     // Tells if user is allow to access content
+    uint32_t getLastActivation() const; // Return value of _lastActivation
+    uint32_t activatedUntil() const;    // Return the end of the activation started by the user's last access
+    const QuotaState& getQuota() const; // Return the quota state to be saved
+    bool isAllowed(uint32_t now);       // Tells if user is allow to spend a token now
+    bool inWindow(uint32_t now);        // Tells if user may access content at this time of the day
 };
 
-User::User() {}
-User::User(const User &u){
-    this->_letterIdentifier = u.getLetter();
-    this->_password = u.getPwd();
-    this->_tokens = u.getTokens();
-    this->_usedTokens = u.getUsedTokens();
+/**
+ * A rolling window remembers QUOTA_RING_SIZE accesses at most.
+ */
+constexpr bool quotasFitRing(){
+    for(size_t u = 0; u < UserCount; u++)
+        if(UsersPrep[u].quota.kind == QuotaRolling && UsersPrep[u].tokens > QUOTA_RING_SIZE)
+            return false;
+    return true;
+}
+
+static_assert(quotasFitRing(), "A rolling quota of UsersPrep has more tokens than QUOTA_RING_SIZE");
 
+/**
+ * Longest time an access counts for a quota of UsersPrep, 0 if they are all monthly.
+ */
+constexpr uint32_t longestQuotaLookBack(){
+    uint32_t longest = 0;
+    for(size_t u = 0; u < UserCount; u++)
+        if(quotaLookBack(UsersPrep[u].quota, UsersPrep[u].tokens) > longest)
+            longest = quotaLookBack(UsersPrep[u].quota, UsersPrep[u].tokens);
+    return longest;
 }
-User::~User() {}
 
-void User::init(const char let, const string pwd, int tokens, int usedTokens) {
-    _letterIdentifier = let;
-    _password = pwd;
-    _tokens = tokens;
+void User::init(size_t config, int usedTokens) {
+    _config = (uint16_t)config;
     _usedTokens = usedTokens;
+    _lastActivation = 0;
+    _quota.init(UsersPrep[config].quota, UsersPrep[config].tokens);
 }
 
 char User::getLetter()const{
-    return _letterIdentifier;
+    return UsersPrep[_config].username;
 }
 
-string User::getPwd()const{
-    return _password;
+const char* User::getPwd()const{
+    return UsersPrep[_config].password;
 }
 
 void User::resetUsedTokens(){
     _usedTokens = 0;
 }
 
-void User::addUsedTokens(){
+void User::useToken(uint32_t epoch){
     _usedTokens += 1;
+    _lastActivation = epoch;
+    _quota.consume(epoch);
+}
+
+void User::restore(int usedTokens, uint32_t lastActivation, const QuotaState& quota){
+    _usedTokens = usedTokens;
+    _lastActivation = lastActivation;
+    _quota.restore(quota);
 }
 
 int User::getTokens() const{
-    return _tokens;
+    return UsersPrep[_config].tokens;
 }
 int User::getUsedTokens() const{
     return _usedTokens;
 }
+uint32_t User::getLastActivation() const{
+    return _lastActivation;
+}
+
+uint32_t User::activatedUntil() const{
+    uint32_t seconds = UsersPrep[_config].quota.activatedSeconds;
+    return _lastActivation + (seconds ? seconds : ActivatedTime.totalseconds());
+}
+
+const QuotaState& User::getQuota() const{
+    return _quota.state();
+}
+
+bool User::isAllowed(uint32_t now){
+    return _quota.allows(now);
+}
 
-bool User::isAllowed() const{
-    return _usedTokens < _tokens;
+bool User::inWindow(uint32_t now){
+    return _quota.inWindow(now);
 }
\ No newline at end of file
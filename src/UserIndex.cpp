@@ -0,0 +1,29 @@
+#include "UserIndex.h"
+
+#include <cstring>
+
+/**
+ * Looks for the user whose password is input.
+ *
+ * @param input Keys typed by the user, doesn't need to be null terminated.
+ * @param length Number of keys.
+ * @return The position of the user in UsersPrep, -1 if no password matches.
+ */
+int findUser(const char* input, size_t length){
+    uint32_t digest = passwordDigest(input, length, UserIndex.seed);
+    size_t slot = digest & (UserIndexSize - 1);
+
+    for(uint8_t probe = 0; probe <= UserIndex.maxProbe; probe++){
+        const UserIndexSlot& s = UserIndex.slots[slot];
+
+        if(s.user == USER_INDEX_EMPTY)
+            return -1;
+
+        const char* pwd = UsersPrep[s.user].password;
+        if(s.digest == digest && strncmp(pwd, input, length) == 0 && pwd[length] == 0)
+            return s.user;
+
+        slot = (slot + 1) & (UserIndexSize - 1);
+    }
+    return -1;
+}
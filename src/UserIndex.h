@@ -0,0 +1,138 @@
+/**
+ * File :      UserIndex.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Read-only password index built at compile time from UsersPrep.
+ *             Open addressing over a hash of the password, with a seed chosen so the
+ *             longest probe sequence stays short : a lookup costs one hash and at most
+ *             UserIndex.maxProbe + 1 slot reads, whatever the number of users.
+ *             The table is constexpr, so it is placed in flash and uses no heap.
+*/
+#ifndef USERINDEX_H
+#define USERINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "DEFINITIONS.hpp"
+
+#define USER_INDEX_EMPTY 0xFFFF
+#define USER_INDEX_MAX_PROBE 8
+
+struct UserIndexSlot {
+    uint32_t digest;            // Hash of the password
+    uint16_t user;              // Position in UsersPrep, USER_INDEX_EMPTY if the slot is free
+};
+
+/**
+ * Smallest power of two giving a load factor of 25% at most.
+ */
+constexpr size_t userIndexSize(size_t users){
+    size_t size = 4;
+    while(size < users * 4)
+        size *= 2;
+    return size;
+}
+
+const size_t UserIndexSize = userIndexSize(UserCount);
+
+struct UserIndexTable {
+    UserIndexSlot slots[UserIndexSize];
+    uint32_t seed;
+    uint8_t maxProbe;           // Longest distance between a password's home slot and its slot
+};
+
+/**
+ * FNV-1a of the password followed by a final mix, so the low bits used as slot number are well spread.
+ */
+constexpr uint32_t passwordDigest(const char* password, size_t length, uint32_t seed){
+    uint32_t h = 2166136261u ^ seed;
+    for(size_t i = 0; i < length; i++){
+        h ^= (uint8_t)password[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+constexpr size_t constLength(const char* s){
+    size_t n = 0;
+    while(s[n])
+        n++;
+    return n;
+}
+
+constexpr bool constEqual(const char* a, const char* b){
+    size_t i = 0;
+    while(a[i] && a[i] == b[i])
+        i++;
+    return a[i] == b[i];
+}
+
+constexpr UserIndexTable buildUserIndex(uint32_t seed){
+    UserIndexTable t{};
+    t.seed = seed;
+
+    for(size_t i = 0; i < UserIndexSize; i++)
+        t.slots[i] = UserIndexSlot{0, USER_INDEX_EMPTY};
+
+    for(size_t u = 0; u < UserCount; u++){
+        const char* pwd = UsersPrep[u].password;
+        uint32_t digest = passwordDigest(pwd, constLength(pwd), seed);
+        size_t slot = digest & (UserIndexSize - 1);
+        uint8_t probe = 0;
+        while(t.slots[slot].user != USER_INDEX_EMPTY){
+            slot = (slot + 1) & (UserIndexSize - 1);
+            probe++;
+        }
+        t.slots[slot] = UserIndexSlot{digest, (uint16_t)u};
+        if(probe > t.maxProbe)
+            t.maxProbe = probe;
+    }
+    return t;
+}
+
+constexpr bool passwordsAreUnique(){
+    for(size_t u = 0; u < UserCount; u++)
+        for(size_t o = 0; o < u; o++)
+            if(constEqual(UsersPrep[u].password, UsersPrep[o].password))
+                return false;
+    return true;
+}
+
+constexpr bool passwordsUseKeypad(){
+    for(size_t u = 0; u < UserCount; u++){
+        for(const char* c = UsersPrep[u].password; *c; c++)
+            if(*c < '1' || *c > '3')
+                return false;
+        if(constLength(UsersPrep[u].password) > MAX_CODE_LENGTH)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Tries a few seeds and keeps the one with the shortest longest probe.
+ */
+constexpr UserIndexTable bestUserIndex(){
+    UserIndexTable best = buildUserIndex(0);
+    for(uint32_t seed = 1; seed < 16 && best.maxProbe > 2; seed++){
+        UserIndexTable t = buildUserIndex(seed * 0x9E3779B9u);
+        if(t.maxProbe < best.maxProbe)
+            best = t;
+    }
+    return best;
+}
+
+inline constexpr UserIndexTable UserIndex = bestUserIndex();
+
+static_assert(UserCount < USER_INDEX_EMPTY, "Too many users in UsersPrep");
+static_assert(passwordsAreUnique(), "Two users of UsersPrep share the same password");
+static_assert(passwordsUseKeypad(), "Passwords of UsersPrep can only use the numbers 1 to 3, MAX_CODE_LENGTH at most");
+static_assert(UserIndex.maxProbe <= USER_INDEX_MAX_PROBE, "Password index is too crowded, change a password");
+
+int findUser(const char* input, size_t length);
+
+#endif
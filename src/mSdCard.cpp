@@ -5,6 +5,8 @@
 */
 bool mSdCard::init(){
     
+    _handles.closeAll();
+
   	if (!sd.begin(SD_CHIP_SELECT_PIN, SPI_SPEED_RATE)){
         sd.initErrorPrint();
         return false;
@@ -14,20 +16,19 @@ bool mSdCard::init(){
 }
 
 /**
- * Verify that the given file exist.
+ * Verify that the given file exist, without opening it.
  *
  * @param fileName File name.
  * @return True, if the file exists, false otherwise.
  */
-bool mSdCard::fileExist(const std::string fileName){
+bool mSdCard::fileExist(std::string_view fileName){
 
-    // Open file for reading
-  	if (!registre.open(fileName.c_str(), O_RDONLY))
-        return false;
+    if(_handles.find(fileName))
+        return true;
 
-	registre.close();
+    char path[FILE_PATH_SIZE];
 
-    return true;
+    return makePath(path, "", fileName) && sd.exists(path);
 }
 
 /**
@@ -36,79 +37,176 @@ bool mSdCard::fileExist(const std::string fileName){
  * @param fileName File name.
  * @return True, if the file has been create, false otherwise.
  */
-bool mSdCard::createFile(const std::string fileName){
+bool mSdCard::createFile(std::string_view fileName){
 
-    if(!registre.open(fileName.c_str(), O_RDWR | O_CREAT))
+    Handle* h = handle(fileName, true);
+
+    if(!h)
         return false;
 
-    registre.close();
+    _handles.release(*h);
 
     return true;
 }
 
 /**
- * Reads and add all lines in a vector of string, until it reaches a int value n of zero.
- * 
- * If you manually put data into a file, make sure
- * that you press Enter at the end of each string.
- * 
- * @param fileName File name where data are written.
- * @param vect Vector that will be filled with every line found.
+ * Append a line to a file.
+ *
+ * @param fileName File name.
+ * @param line Line of text to be added. It puts an /n character after the line to be written.
  * @return True, if the operation was successful, false if the file name doesn't exist.
  */
-bool mSdCard::readFrom(const std::string fileName, std::vector<std::string>& vect){
+bool mSdCard::addLine(std::string_view fileName, std::string_view line){
+
+    Handle* h = handle(fileName, false);
 
-    if(!registre.open(fileName.c_str(), O_RDONLY))
+    if(!h)
         return false;
-    
-    int n;
-    while ((n = registre.fgets(line, sizeof(line))) > 0) {	// Add SD card line to lines
-        if (line[n - 1] == '\n') {// && != ''
-            line[n - 1] = 0;// Set \n character to nothing
-            vect.push_back(line);
-        }else{
-            vect.push_back(line);       // TODO: Check if it works // If there's no /n char at the end, but OEF is encountered
-        }
-    }
 
-    registre.close();
+    SdFile& registre = h->handle;
+    bool ok = registre.seekEnd() && registre.write((const uint8_t*)line.data(), line.size()) == line.size()
+        && registre.write((const uint8_t*)"\r\n", 2) == 2;
 
-    return true;
+    ok = registre.sync() && ok;     // Data and directory entry on the card, as a close would do
+    _handles.release(*h);
+
+    return ok;
 }
 
 /**
- * Append a line to a file.
+ * Erase every data of a file. Its cached handle is dropped first.
+ *
+ * @param fileName File's name that content will be erased.
+ * @return True, if the operation was successful, false if the file name doesn't exist.
+ */
+bool mSdCard::clearFile(std::string_view fileName){
+
+    _handles.invalidate(fileName);
+
+    Handle* h = handle(fileName, false);
+
+    if(!h)
+        return false;
+
+    bool ok = h->handle.truncate(0) && h->handle.sync();
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Gives the size of a file.
  *
  * @param fileName File name.
- * @param line Line of text to be added. It puts an /n character after the line to be written.
+ * @param size Filled with the size in bytes.
  * @return True, if the operation was successful, false if the file name doesn't exist.
  */
-bool mSdCard::addLine(const std::string fileName, const std::string line){
+bool mSdCard::fileSize(std::string_view fileName, size_t& size){
 
-    if(!registre.open(fileName.c_str(), O_APPEND | O_WRITE))
+    Handle* h = handle(fileName, false);
+
+    if(!h)
         return false;
 
-    registre.println(line.c_str());
+    size = h->handle.fileSize();
 
-    registre.close();
+    _handles.release(*h);
 
     return true;
 }
 
 /**
- * Erase every data of a file.
+ * Reads exactly length bytes, starting at offset.
  *
- * @param fileName File's name that content will be erased.
+ * @param fileName File name.
+ * @param offset Position of the first byte to read.
+ * @param buffer Receives the data, must hold length bytes.
+ * @param length Number of bytes to read.
+ * @return True, if every byte has been read, false otherwise.
+ */
+bool mSdCard::readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length){
+
+    Handle* h = handle(fileName, false);
+
+    if(!h)
+        return false;
+
+    SdFile& registre = h->handle;
+    bool ok = registre.seekSet(offset) && registre.read(buffer, length) == (int)length;
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Append raw bytes to a file.
+ *
+ * @param fileName File name.
+ * @param data Bytes to be added, nothing is put after them.
+ * @param length Number of bytes.
  * @return True, if the operation was successful, false if the file name doesn't exist.
  */
-bool mSdCard::clearFile(const std::string fileName){
+bool mSdCard::appendBytes(std::string_view fileName, const uint8_t* data, size_t length){
 
-    if(!registre.open(fileName.c_str(), O_RDWR))
+    Handle* h = handle(fileName, false);
+
+    if(!h)
         return false;
 
-    registre.truncate(0);
+    SdFile& registre = h->handle;
+    bool ok = registre.seekEnd() && registre.write(data, length) == length;
 
-    registre.close();
+    ok = registre.sync() && ok;
+    _handles.release(*h);
 
-    return true;
-}
\ No newline at end of file
+    return ok;
+}
+
+/**
+ * Overwrite bytes in place, the file is created if needed. Offset can't be past the end of the file.
+ *
+ * @param fileName File name.
+ * @param offset Position of the first byte to write.
+ * @param data Bytes to be written.
+ * @param length Number of bytes.
+ * @return True, if the operation was successful, false otherwise.
+ */
+bool mSdCard::writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length){
+
+    Handle* h = handle(fileName, true);
+
+    if(!h)
+        return false;
+
+    SdFile& registre = h->handle;
+    bool ok = registre.seekSet(offset) && registre.write(data, length) == length;
+
+    ok = registre.sync() && ok;
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Open handle of a file, taken from the cache or opened for reading and writing.
+ *
+ * @param fileName File name.
+ * @param create Creates the file if it doesn't exist.
+ * @return The cache entry, nullptr if the file couldn't be opened.
+ */
+mSdCard::Handle* mSdCard::handle(std::string_view fileName, bool create){
+
+    if(Handle* h = _handles.find(fileName))
+        return h;
+
+    Handle* h = _handles.slot(fileName);
+
+    if(!h || (!h->path[0] && !makePath(h->path, "", fileName)))
+        return nullptr;
+
+    h->open = h->handle.open(h->path, create ? O_RDWR | O_CREAT : O_RDWR);
+
+    return h->open ? h : nullptr;
+}
@@ -3,6 +3,7 @@
 #define MSdCard_H
 
 #include "Storage.h"
+#include "HandleCache.h"
 
 #include <SD.h>
 #include <SdFat.h>      // Library for SD Card data storing
@@ -10,26 +11,35 @@
 /**
  * Child class of Storage
 */
-class mSdCard : public Storage{
+class mSdCard final : public Storage{
 private:
+    typedef HandleCache<SdFile>::Entry Handle;
+
     // SD variables
     SdFat sd;
-    SdFile registre;
-    char line[25];
+    HandleCache<SdFile> _handles;           // Files stay open between operations
+
+    Handle* handle(std::string_view fileName, bool create);
 
 public:
-    mSdCard() = default;                    // Constructor & destructor
+    explicit mSdCard(size_t cachedHandles = HANDLE_CACHE_SIZE) : _handles(cachedHandles) {}    // Constructor & destructor
     mSdCard(const mSdCard &u) = delete;     // Deletion of copy constructor, security for assuring there's only one instance
 
     ~mSdCard() = default;
 
+    const HandleCacheStats& cacheStats() const { return _handles.stats(); }
+
     bool init() override;
     
-    bool fileExist(const std::string registreName) override;
-    bool createFile(const std::string fileName) override;
-    bool readFrom(const std::string fileName, std::vector<std::string>& vect) override;
-    bool addLine(const std::string fileName, const std::string line) override;
-    bool clearFile(const std::string fileName) override;
+    bool fileExist(std::string_view registreName) override;
+    bool createFile(std::string_view fileName) override;
+    bool addLine(std::string_view fileName, std::string_view line) override;
+    bool clearFile(std::string_view fileName) override;
+
+    bool fileSize(std::string_view fileName, size_t& size) override;
+    bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) override;
+    bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) override;
+    bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) override;
 };
 
 
@@ -8,22 +8,36 @@ Purpose :   Control an ESP32 and two other "complex" components.
 #include <Arduino.h>
 #include <Wire.h>				// Library for I2C communication
 #include <SPI.h>				// Library for SPI communication
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>		// Tasks of the pipeline
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 #include "StorageManagement.h"	// Includes all necessary file manager
+#include "RegistryFormat.h"		// Binary layout of the registry file
+#include "Checkpoint.h"			// Saved counters, avoids replaying the registry at boot
+#include "Archive.h"			// Compressed registries of the months that ended
+#include "Audit.h"				// Queries over the registry and the archive
+#include "RingLog.h"			// Error log of fixed size
+#include "EventLog.h"			// Error codes, kept in RTC memory until written
 #include "User.hpp"				// Class that holds user data
+#include "UserIndex.h"			// Compile-time password index
+#include "Keypad.h"				// Debounced, non-blocking keypad
+#include "Actuator.h"			// Timer driven lock pin
+#include "ClockService.h"		// RTC time without an I2C read per call
+#include "SpscQueue.h"			// Lock-free queues between the tasks
+#include "Pipeline.h"			// Input -> policy -> storage tasks
+#include "BootSequence.h"		// Peripherals started side by side, boot profile
+#include "Trace.h"				// Hot path tracepoints, exported on the serial port
+#include "MemoryStats.h"		// Heap per tag, free blocks and task stacks
 
-#if USE_INTERNAL_MEMORY && USE_SD_CARD
-	Storage * usageStorage = new FlashMem();
-	Storage * logStorage = new mSdCard();
-#elif USE_INTERNAL_MEMORY && !USE_SD_CARD
-	Storage * usageStorage = new FlashMem();
-	Storage * logStorage = new NullStorage();
-#elif !USE_INTERNAL_MEMORY && USE_SD_CARD
-	Storage * usageStorage = new SdCard();
-	Storage * logStorage = usageStorage;
-#else
-	#error At least one storage must be set to true (see: DEFINITIONS.hpp)
-#endif
+// Backends are called directly, nothing is batched on the device : every record is written through
+// The archive goes on the SD card when there is one, it only grows. Chosen at compile time (see StorageController.h)
+RtbStorage rtbStorage;
+
+// Newest error log entries, written in place (see RingLog.h)
+RingLog<RtbStorage::LogStorage> errorLog(rtbStorage.log(), ErrorLog);
 
 
 #if DEBUG_ENABLED
@@ -34,43 +48,126 @@ Purpose :   Control an ESP32 and two other "complex" components.
 	#define debugln(x)
 #endif
 
-/**
- * Contains all the data e.g. a2020-06-25T15:29:37
- * and also, without the first letter (representing the user whom has accessed),
- * it respects the format: iso8601dateTime
-*/
-std::vector<std::string> lines;
+// Registry in use : index in RegistrySlots and its header (see RegistryFormat.h), only the storage stage changes them once setup is done
+size_t registrySlot = 0;
+RegistryHeader registryHeader = {};
+
+// Sparse time index of the registry in use, built by the first query (see Audit.h), only the storage stage uses it
+TimeIndex registryIndex;
+
+// Number of records in the registry file (user letter + unix time, see RegistryFormat.h)
+size_t registryCount = 0;
+
+// Unix time of the newest registry record
+uint32_t lastActivation = 0;
+
+// Month the registry records belong to (see quotaPeriodOf), and the unix time it ends
+uint32_t quotaPeriod = 0;
+uint32_t quotaPeriodEnd = 0;
+
+// Unix time the State::Activated started by the newest record ends, depends on the user's policy
+uint32_t activatedUntil = 0;
 
-// Error message to be logged into the log file
-std::string logErrorMessage = "";
 
 // Instance of DS3231
 RTC_DS3231 RTC;
 
-// Container for all users
-std::vector<User> users;
+// Time of the DS3231, read once in a while and extrapolated in between
+ClockService rtcClock(RTC);
+
+// Counters of all users, same order as UsersPrep
+User users[UserCount];
 
 // Current state of the RTB
 int CurrentState;
 
+// Buttons and enter key, sampled by a timer
+Keypad keypad;
+
+// Solenoid of the lock, pulses are timed without blocking loop()
+Actuator lockActuator(LockPin);
+
+// True once the State::Problem has been logged and the periodic opening started
+bool problemHandled = false;
+
+// Counters as written in the checkpoint file, only the storage stage updates them once setup is done
+Checkpoint usageCheckpoint;
+
+// Queues between the stages (see Pipeline.h)
+SpscQueue<CodeEvent, CODE_QUEUE_SIZE> codeQueue;
+SpscQueue<StorageJob, STORAGE_QUEUE_SIZE> storageQueue;
+PipelineStats pipelineStats;
+
+// Tasks of the pipeline, nullptr when the stages run one after the other in loop()
+TaskHandle_t inputTask = nullptr;
+TaskHandle_t policyTask = nullptr;
+TaskHandle_t storageTask = nullptr;
+
+// Set by the storage stage when a write fails, turned into State::Problem by the policy stage
+std::atomic<bool> storageFailure{false};
+
+// Phases of this boot, timed (see BootSequence.h)
+BootProfile bootProfile;
+
+// Records of the previous registry replayed without a checkpoint (see replayPreviousLookBack)
+struct RecentRecords {
+	uint32_t from;				// Unix time of the oldest record replayed
+	bool invalidRecord;
+};
+
 
 void setRTCtime();
-void updateUserTokens();
-void updateState();
-std::string getUserInput();
-int returnUserIndex(std::string input);
-void incrementUsedTokens(int index);
+bool startRtc();
+bool startUsageStorage();
+bool startLogStorage();
+bool openErrorLog();
+size_t restoreCheckpoint(bool& current);
+size_t replayPreviousLookBack();
+bool previousRegistryKept(uint32_t generation, size_t records);
+void enterRegistryPeriod();
+bool replayRecords(const RegistryRecord* records, size_t count, void* context);
+bool replayRecentRecords(const RegistryRecord* records, size_t count, void* context);
+void updateUserTokens(size_t first);
+void snapshotUsage();
+bool saveUsageCheckpoint();
+void archivePreviousRegistry();
+void pollSerialCommand();
+void enterQuotaPeriod(uint32_t epoch);
+void updateState(uint32_t now);
+int returnUserIndex(const char* input, size_t length);
+void incrementUsedTokens(int index, uint32_t now);
 void openLock(int delayMillisec);
+bool inputStage();
+bool policyStage();
+bool storageStage();
+void queueStorageJob(const StorageJob& job);
+bool startPipeline();
+
+// Peripherals that don't depend on each other, started side by side
+const BootStep PeripheralSteps[] = {
+	{"usageStorage", startUsageStorage, EventUsageStorageInit},
+	{"logStorage", startLogStorage, EventLogStorageInit},
+	{"rtc", startRtc, EventRtcMissing},
+};
 
 void setup() {
 	/*******************************************
 		SETUP of esp32 and communication
 	*******************************************/
+	bootProfile.begin();
+	MemoryScope memoryScope(MemoryBoot);
+
  	Serial.begin(9600);						// Communication rate
+
+	size_t carriedEvents = beginEvents();	// Events of the previous run, if it ended with a warm reset
 	
 	Wire.begin();							// Start the I2C
 	
-	delay(3000);							// Wait for console opening
+	#if DEBUG_ENABLED
+		delay(3000);						// Wait for console opening, only worth it to read the debug output
+	#endif
+
+	int phase = bootProfile.start("pins");
 
 	// Setup of pinMode
 	pinMode(Button1, INPUT_PULLDOWN);
@@ -79,108 +176,225 @@ void setup() {
 	pinMode(EnterPin, INPUT_PULLDOWN);
 	pinMode(LockPin, OUTPUT);
 
-	/*******************************************
-			SETUP of physical components
-	*******************************************/
-	
-	// Init RTC
-	if (!RTC.begin()){
+	if(!lockActuator.begin()){
 		CurrentState = State::Problem;
-		logErrorMessage += "\nCouldn't find RTC.";
-	}
-	else{
-		#if SET_RTC_TIME
-			setRTCtime();			// Set Time for RTC, do it once
-		#endif
+		logEvent(EventLockTimer);
 	}
-	
-	debug("\nRTC date : ");
-	debugln(RTC.now().timestamp(DateTime::TIMESTAMP_FULL).c_str());
 
-	// Init of storage
-	if(!usageStorage->init()){
+	if(!keypad.begin()){
 		CurrentState = State::Problem;
-		logErrorMessage += "\nCouldn't initialize usage storage";
+		logEvent(EventKeypadTimer);
 	}
 
-	if(!logStorage->init()){
+	bootProfile.end(phase);
+
+	/*******************************************
+			SETUP of physical components
+	*******************************************/
+
+	// RTC, internal memory and SD card, each on its own bus. The error log is opened later, by the storage stage
+	if(!runBootSteps(PeripheralSteps, sizeof(PeripheralSteps) / sizeof(PeripheralSteps[0]), bootProfile, USE_PARALLEL_BOOT))
 		CurrentState = State::Problem;
-		logErrorMessage += "\nCouldn't initialize log storage";
-	}
 
-	// Check if the registry file exist, otherwise creates it
-	if(!usageStorage->fileExist(Registry))
-		if(!usageStorage->createFile(Registry)){
+	if(carriedEvents > 0)
+		logEvent(EventBoot, (uint16_t)std::min(carriedEvents, (size_t)UINT16_MAX));
+
+	debug("\nRTC date : ");
+	debugln(DateTime(rtcClock.now()).timestamp(DateTime::TIMESTAMP_FULL).c_str());
+
+	phase = bootProfile.start("registry");
+
+	// Registry in use : the newest valid one of the two slots, only their headers are read
+	if(!openRegistry(rtbStorage.usage(), registrySlot, registryHeader)){
+		size_t legacySize = 0;
+
+		// Import the registry of older versions, if any (an interrupted import leaves no valid slot and is done again)
+		if(rtbStorage.usage().fileExist(LegacyRegistry) && rtbStorage.usage().fileSize(LegacyRegistry, legacySize) && legacySize > 0){
+			if(!migrateTextRegistry(rtbStorage.usage(), LegacyRegistry, RegistrySlots[0])){
+				CurrentState = State::Problem;
+				logEvent(EventMigration);
+			}
+		}
+		// First boot, or a power cut before the first header was complete
+		else if(!createRegistry(rtbStorage.usage(), RegistrySlots[0])){
 			CurrentState = State::Problem;
-			logErrorMessage += "\nCouldn't create registry file.";
+			logEvent(EventRegistryCreate);
 		}
-	
-	// Same here for the log file
-	if(!logStorage->fileExist(ErrorLog)){
-		if(!logStorage->createFile(ErrorLog)){
+
+		if(!openRegistry(rtbStorage.usage(), registrySlot, registryHeader) && CurrentState != State::Problem){
 			CurrentState = State::Problem;
-			logErrorMessage += "\nCouldn't create log file.";
+			logEvent(EventRegistryRead);
 		}
 	}
+	
+	bootProfile.end(phase, CurrentState != State::Problem);
 
 	/*******************************************
 					SETUP of users
 	*******************************************/
 	// User assignment
-	for (struct UsersConfig x : UsersPrep) {
-		User tempUser;
-		tempUser.init(x.username,x.password,x.tokens);
-		users.push_back(tempUser);
-	}
+	for (size_t i = 0; i < UserCount; i++)
+		users[i].init(i);
 
 	/*******************************************
-		UPDATE data from registry file
+		UPDATE data from checkpoint and registry file
 	*******************************************/
-	if(!usageStorage->readFrom(Registry,lines)){
+	phase = bootProfile.start("checkpoint");
+
+	if(!registryRecordCount(rtbStorage.usage(), RegistrySlots[registrySlot], registryCount)){
 		CurrentState = State::Problem;
-		logErrorMessage += "\nCouldn't read data from registry file.";
+		logEvent(EventRegistryRead);
+	}
+
+	bool current;
+	size_t counted = restoreCheckpoint(current);	// Records already included in the checkpoint
+
+	debug("\nRegistry records : ");
+	debug((unsigned long)registryCount);
+	debug(", to replay : ");
+	debugln((unsigned long)(registryCount - counted));
+
+	bootProfile.end(phase);
+
+	if(counted != registryCount){
+		phase = bootProfile.start("replay");
+		updateUserTokens(counted);	// Update of used token
+		bootProfile.end(phase, CurrentState != State::Problem);
+	}
+
+	snapshotUsage();				// What the storage stage starts from
+
+	if(counted != registryCount || !current){
+		phase = bootProfile.start("checkpointSave");
+		if(!saveUsageCheckpoint()){
+			CurrentState = State::Problem;
+			logEvent(EventCheckpointSave);
+		}
+		bootProfile.end(phase, CurrentState != State::Problem);
 	}
-	// Debug message, to see what is stored in "lines" variable
-	for (string line : lines)
-		debugln(line.c_str());
 
-	updateUserTokens();			// Update of used token
+	// The previous month may not be archived yet (power cut, SD card missing), the storage stage looks
+	StorageJob archiveJob = {};
+	archiveJob.type = JobArchive;
+	queueStorageJob(archiveJob);
+
+	/*******************************************
+				START of the tasks
+	*******************************************/
+	#if USE_TASK_PIPELINE
+		phase = bootProfile.start("tasks");
+		if(!startPipeline()){
+			CurrentState = State::Problem;
+			logEvent(EventTaskStart);
+		}
+		bootProfile.end(phase, CurrentState != State::Problem);
+	#endif
+
+	bootProfile.ready();
+
+	// Stages run in loop() : its task is the one to watch
+	if(policyTask == nullptr)
+		watchTaskStack("loop", xTaskGetCurrentTaskHandle(), LOOP_TASK_STACK_SIZE);
+
+	#if DEBUG_ENABLED
+		debugln("\nBoot profile (us since setup started) :");
+		bootProfile.print(Serial);
+	#endif
 }
 
 void loop() {
+	// The tasks do everything, this one isn't needed anymore (startPipeline() starts all of them or none)
+	if(inputTask != nullptr && policyTask != nullptr && storageTask != nullptr){
+		vTaskDelete(NULL);
+		return;
+	}
+
+	// Without tasks, each stage gets its turn
+	bool busy = inputStage();
+	busy |= policyStage();
+	busy |= storageStage();
+
+	if(!busy)
+		delay(1);		// Nothing to do yet, let the other tasks run
+}
+
+/**
+ * Input stage : hands every code typed on the keypad over to the policy stage.
+ *
+ * @return True, if a code has been typed, false otherwise.
+ */
+bool inputStage(){
+	MemoryScope memoryScope(MemoryInput);
+	uint32_t traceStart = traceCycles();
+	CodeEvent event;
+	size_t length;
+	if(!keypad.pollInput(event.code, length))
+		return false;
+
+	TRACE_RECORD(TraceKeypadInput, traceStart, length);
+
+	event.length = (uint8_t)length;
+	event.at = micros();
+
+	if(!codeQueue.push(event)){
+		pipelineStats.droppedCodes++;
+		return true;
+	}
+
+	pipelineStats.codes++;
+	if(policyTask != nullptr)
+		xTaskNotifyGive(policyTask);
+	return true;
+}
+
+/**
+ * Policy stage : decides whether a typed code opens the lock. Only works on the counters
+ * in memory, the writes are queued for the storage stage.
+ *
+ * @return True, if a code has been evaluated, false otherwise.
+ */
+bool policyStage(){
+	MemoryScope memoryScope(MemoryPolicy);
+
+	if(storageFailure.exchange(false) && !problemHandled)
+		CurrentState = State::Problem;
+
 	// Check if there's any hardware or setup problem, if so, it opens the lock
 	if(CurrentState == State::Problem){
 
-		// Log the error
-		logStorage->addLine(ErrorLog, logErrorMessage.c_str());
+		if(!problemHandled){
+			problemHandled = true;
 
-		debug("\nCurrent State : problem, error message :\n\n");
-		debugln(logErrorMessage.c_str());
+			// The errors are already in the event ring, the storage stage writes them
+			debugln("\nCurrent State : problem, see the error log.");
 
-		// Open lock every 30 seconds, for 2 seconds.
-		while(true){
-			openLock(2000);
-			delay(30000);
+			// Open lock every 30 seconds, for 2 seconds, from now on.
+			lockActuator.pulseTrain(2000, 30000);
 		}
+
+		CodeEvent ignored;
+		while(codeQueue.pop(ignored)){}
+		return false;
 	}
-	
-	int uIndex = -1; // Index representing the current user
-	
-	// Get user input
-	std::string input = getUserInput();
+
+	CodeEvent event;
+	if(!codeQueue.pop(event))
+		return false;
 
 	// Find user based on input
-  	uIndex = returnUserIndex(input);
+	int uIndex = returnUserIndex(event.code, event.length);
 	
 	if(uIndex != -1){   // True if user exist
+		uint32_t now = rtcClock.now();
+		setEventTime(now);
 		
-		updateState();	// Update of current State
+		updateState(now);	// Update of current State
 			
-		// True if : user is allowed or the RTB is active and there is no technical problem
-		if((users[uIndex].isAllowed() || CurrentState == State::Activated) && CurrentState != State::Problem){
+		// True if : it is the user's time of day, the user is allowed or the RTB is active, and there is no technical problem
+		if(users[uIndex].inWindow(now) && (users[uIndex].isAllowed(now) || CurrentState == State::Activated) && CurrentState != State::Problem){
 
 			if(CurrentState == State::Ready){
-				incrementUsedTokens(uIndex);
+				incrementUsedTokens(uIndex, now);
 				openLock(3000);
 			}
 			else{// CurrentState activated
@@ -188,6 +402,177 @@ void loop() {
 			}
 		}
 	}
+
+	uint32_t latency = micros() - event.at;
+	if(latency > pipelineStats.maxDecisionMicros)
+		pipelineStats.maxDecisionMicros = latency;
+	pipelineStats.decisions++;
+	return true;
+}
+
+/**
+ * Storage stage : does one write queued by the policy stage. A failure is handed back
+ * through storageFailure, the policy stage turns it into State::Problem.
+ *
+ * @return True, if a job has been done, false if there was none.
+ */
+bool storageStage(){
+	MemoryScope memoryScope(MemoryStorage);
+	StorageJob job;
+	if(!storageQueue.pop(job)){
+		// Idle, time to write the events
+		if constexpr(RtbStorage::HasLog){
+			if(openErrorLog() && pendingEvents() > 0)
+				drainEvents(errorLog);	// Kept in RTC memory if it fails, for a later try
+		}
+		pollSerialCommand();
+		return false;
+	}
+
+	EventCode failure = EventNone;
+
+	switch(job.type){
+		case JobRecord:
+			// Not counted in the checkpoint, which stays in step with the registry
+			if(!appendRecord(rtbStorage.usage(), RegistrySlots[registrySlot], job.record)){
+				failure = EventRecordAppend;
+				break;
+			}
+
+			registryIndex.add(job.record.epoch);
+
+			usageCheckpoint.registryRecords++;
+			usageCheckpoint.lastActivation = job.record.epoch;
+			usageCheckpoint.quotaPeriod = job.quotaPeriod;
+			usageCheckpoint.users[job.user].usedTokens++;
+			usageCheckpoint.users[job.user].lastActivation = job.record.epoch;
+			consumeQuota(UsersPrep[job.user].quota, usageCheckpoint.users[job.user].quota, job.record.epoch);
+
+			if(!saveUsageCheckpoint())
+				failure = EventCheckpointSave;
+			break;
+
+		case JobRenewal:
+			// The records of the month that ended stay in the other slot until the next renewal
+			if(!renewRegistry(rtbStorage.usage(), registrySlot, registryHeader, job.quotaPeriod)){
+				failure = EventRegistryClear;
+				break;
+			}
+
+			registryIndex.reset();
+
+			usageCheckpoint.registryGeneration = registryHeader.generation;
+			usageCheckpoint.registryRecords = 0;
+			usageCheckpoint.quotaPeriod = job.quotaPeriod;
+			for (CheckpointUser& u : usageCheckpoint.users)
+				u.usedTokens = 0;
+
+			if(!saveUsageCheckpoint())
+				failure = EventCheckpointSave;
+
+			archivePreviousRegistry();
+			break;
+
+		case JobArchive:
+			archivePreviousRegistry();
+			break;
+	}
+
+	if(failure != EventNone){
+		logEvent(failure);
+		storageFailure.store(true);
+	}
+
+	pipelineStats.storedJobs++;
+	return true;
+}
+
+/**
+ * Hands a write over to the storage stage. Only waits when STORAGE_QUEUE_SIZE writes are already pending.
+ *
+ * @param job Write to be done.
+ * @return Void.
+ */
+void queueStorageJob(const StorageJob& job){
+	while(!storageQueue.push(job)){
+		pipelineStats.storageStalls++;
+
+		if(storageTask != nullptr)
+			vTaskDelay(1);
+		else
+			storageStage();		// Stages run in loop(), make room ourselves
+	}
+
+	pipelineStats.storageJobs++;
+
+	uint32_t pending = storageQueue.size();
+	if(pending > pipelineStats.storageQueuePeak)
+		pipelineStats.storageQueuePeak = pending;
+
+	if(storageTask != nullptr)
+		xTaskNotifyGive(storageTask);
+}
+
+/**
+ * Input stage, polls the keypad every tick.
+ */
+void inputTaskLoop(void* parameters){
+	(void)parameters;
+
+	for(;;)
+		if(!inputStage())
+			vTaskDelay(1);
+}
+
+/**
+ * Policy stage, woken up by the input stage. Also wakes up regularly to notice a storage failure.
+ */
+void policyTaskLoop(void* parameters){
+	(void)parameters;
+
+	for(;;){
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+		while(policyStage()){}
+	}
+}
+
+/**
+ * Storage stage, woken up by the policy stage, or after STORAGE_IDLE_MS to drain the events and read the serial port.
+ */
+void storageTaskLoop(void* parameters){
+	(void)parameters;
+
+	for(;;){
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STORAGE_IDLE_MS));
+		while(storageStage()){}
+	}
+}
+
+/**
+ * Creates the tasks, each consumer before its producer. If one can't be created, those
+ * already created are deleted : with part of the stages in tasks and the others in loop(),
+ * a queue would get two consumers. They haven't had anything to do yet.
+ *
+ * @return True, if every task has been created, false otherwise (the stages then run in loop()).
+ */
+bool startPipeline(){
+	bool started = xTaskCreatePinnedToCore(storageTaskLoop, "storage", TASK_STACK_SIZE, nullptr, STORAGE_TASK_PRIORITY, &storageTask, STORAGE_TASK_CORE) == pdPASS
+		&& xTaskCreatePinnedToCore(policyTaskLoop, "policy", TASK_STACK_SIZE, nullptr, POLICY_TASK_PRIORITY, &policyTask, POLICY_TASK_CORE) == pdPASS
+		&& xTaskCreatePinnedToCore(inputTaskLoop, "input", TASK_STACK_SIZE, nullptr, INPUT_TASK_PRIORITY, &inputTask, INPUT_TASK_CORE) == pdPASS;
+
+	if(!started){
+		for(TaskHandle_t* task : {&inputTask, &policyTask, &storageTask}){
+			if(*task != nullptr)
+				vTaskDelete(*task);
+			*task = nullptr;
+		}
+		return false;
+	}
+
+	watchTaskStack("storage", storageTask, TASK_STACK_SIZE);
+	watchTaskStack("policy", policyTask, TASK_STACK_SIZE);
+	watchTaskStack("input", inputTask, TASK_STACK_SIZE);
+	return true;
 }
 
 /**
@@ -197,175 +582,470 @@ void loop() {
  */
 void setRTCtime(){
 	RTC.adjust(DateTime(__DATE__, __TIME__));
+	rtcClock.requestResync();
 
 	debug("\nTime and date set to : ");
 	debugln(DateTime(__DATE__, __TIME__).timestamp(DateTime::TIMESTAMP_FULL).c_str());
 }
 
+/**
+ * Boot step : finds the RTC on the I2C bus and starts the clock service from it.
+ *
+ * @return True, if the RTC answered, false otherwise.
+ */
+bool startRtc(){
+	if(!RTC.begin())
+		return false;
+
+	#if SET_RTC_TIME
+		setRTCtime();			// Set Time for RTC, do it once
+	#endif
+	rtcClock.begin();
+	setEventTime(rtcClock.now());
+	return true;
+}
 
 /**
- * Update all users used tokens from "lines" vector.
- * 
+ * Boot step : mounts the storage of the registry, nothing is batched : the registry and the checkpoint are written through.
+ */
+bool startUsageStorage(){
+	return rtbStorage.initUsage();
+}
+
+/**
+ * Boot step : mounts the storage of the error log, unless there is none or it is the registry's.
+ */
+bool startLogStorage(){
+	return rtbStorage.initLog();
+}
+
+/**
+ * Opens the error log, written in place. setup() doesn't wait for it (its first creation on a
+ * new SD card writes the whole ring) : the storage stage opens it when it is first idle. Only
+ * tried once, a failure is a State::Problem as any storage failure.
+ *
+ * @return True, if the error log is open, false otherwise.
+ */
+bool openErrorLog(){
+	static bool tried = false;
+
+	if(errorLog.isOpen() || tried)
+		return errorLog.isOpen();
+
+	tried = true;
+	if(!errorLog.open()){
+		logEvent(EventLogCreate);
+		storageFailure.store(true);
+		return false;
+	}
+	return true;
+}
+
+
+/**
+ * Restore users used tokens from the checkpoint file.
+ * A checkpoint of the previous registry (power cut during a renewal, before the checkpoint was
+ * saved) is completed with the records of the previous slot, then the new month starts from it.
+ * An invalid checkpoint, or one that doesn't match the registry, is ignored and the whole registry
+ * will be replayed, after the records of the previous slot that the quotas still look back to.
+ *
+ * @param current Set to false when the checkpoint file must be saved again, even with nothing to replay.
+ * @return Number of registry records already counted in the checkpoint.
+ */
+size_t restoreCheckpoint(bool& current){
+	Checkpoint checkpoint;
+	current = false;
+
+	if(!loadCheckpoint(rtbStorage.usage(), UsageCheckpoint, checkpoint))
+		return replayPreviousLookBack();
+
+	usageCheckpoint.sequence = checkpoint.sequence;		// The next save must go over the older copy
+
+	for (size_t i = 0; i < UserCount; i++)
+		if(checkpoint.users[i].user != users[i].getLetter())
+			return replayPreviousLookBack();
+
+	bool previous = checkpoint.registryGeneration + 1 == registryHeader.generation;
+
+	if(previous ? !previousRegistryKept(checkpoint.registryGeneration, checkpoint.registryRecords)
+		: checkpoint.registryGeneration != registryHeader.generation || checkpoint.registryRecords > registryCount)
+		return replayPreviousLookBack();
+
+	current = !previous;
+
+	for (size_t i = 0; i < UserCount; i++)
+		users[i].restore(checkpoint.users[i].usedTokens, checkpoint.users[i].lastActivation, checkpoint.users[i].quota);
+
+	lastActivation = checkpoint.lastActivation;
+	quotaPeriod = checkpoint.quotaPeriod;
+	quotaPeriodEnd = quotaPeriod ? quotaPeriodStart(quotaPeriod + 1) : 0;
+
+	// The newest record may belong to a user that isn't configured anymore
+	activatedUntil = lastActivation ? lastActivation + ActivatedTime.totalseconds() : 0;
+	for (User& x : users)
+		if(lastActivation && x.getLastActivation() == lastActivation)
+			activatedUntil = x.activatedUntil();
+
+	if(!previous)
+		return checkpoint.registryRecords;
+
+	// Records the checkpoint missed in the previous registry, then the month of the new one, as updateState() does
+	bool invalidRecord = false;
+	size_t previousSlot = 1 - registrySlot;
+
+	if(!forEachRecord(rtbStorage.usage(), RegistrySlots[previousSlot], checkpoint.registryRecords, replayRecords, &invalidRecord)){
+		CurrentState = State::Problem;
+		logEvent(invalidRecord ? EventInvalidRecord : EventRegistryRead);
+	}
+
+	enterRegistryPeriod();
+	return 0;
+}
+
+/**
+ * Without a checkpoint, a rolling window or a token bucket still counts the accesses of the end
+ * of the previous month : the records of the previous slot newer than the longest look-back of
+ * UsersPrep before the month of the registry in use are replayed, then the month starts from them.
+ * Nothing is read when every quota is monthly, or when a renewal has been started over that slot.
+ *
+ * @return 0, the whole registry in use is still to be replayed.
+ */
+size_t replayPreviousLookBack(){
+	constexpr uint32_t lookBack = longestQuotaLookBack();
+
+	if(lookBack == 0 || registryHeader.quotaPeriod == 0 || registryHeader.generation < 2
+		|| !previousRegistryKept(registryHeader.generation - 1, 0))
+		return 0;
+
+	uint32_t monthStart = quotaPeriodStart(registryHeader.quotaPeriod);
+	RecentRecords recent{monthStart > lookBack ? monthStart - lookBack : 0, false};
+
+	if(!forEachRecord(rtbStorage.usage(), RegistrySlots[1 - registrySlot], 0, replayRecentRecords, &recent)){
+		CurrentState = State::Problem;
+		logEvent(recent.invalidRecord ? EventInvalidRecord : EventRegistryRead);
+	}
+
+	enterRegistryPeriod();
+	return 0;
+}
+
+/**
+ * The previous registry can only be replayed if it is still whole in the other slot, i.e. no
+ * renewal has been started over it since.
+ *
+ * @param generation Generation of the previous registry, one less than the registry in use.
+ * @param records Records that must be there, e.g. those counted by a checkpoint.
+ * @return True, if the other slot holds that registry and at least records records, false otherwise.
+ */
+bool previousRegistryKept(uint32_t generation, size_t records){
+	size_t count;
+	RegistryHeader header;
+	std::string_view previous = RegistrySlots[1 - registrySlot];
+
+	return readRegistryHeader(rtbStorage.usage(), previous, header)
+		&& header.generation == generation
+		&& registryRecordCount(rtbStorage.usage(), previous, count) && count >= records;
+}
+
+/**
+ * After the records of the previous registry : the month of the registry in use starts with no token used.
+ *
  * @return Void.
  */
-void updateUserTokens(){
+void enterRegistryPeriod(){
 	for (User& x : users)
-		for (string line : lines)
-			if(line.at(0) == x.getLetter())
-				x.addUsedTokens();
+		x.resetUsedTokens();
+
+	if(registryHeader.quotaPeriod){
+		quotaPeriod = registryHeader.quotaPeriod;
+		quotaPeriodEnd = quotaPeriodStart(quotaPeriod + 1);
+	}
+}
+
+/**
+ * Counts a block of registry records in the users used tokens (see forEachRecord).
+ *
+ * @param context Points to a bool, set when a record isn't valid.
+ * @return False, if a record isn't valid, true otherwise.
+ */
+bool replayRecords(const RegistryRecord* records, size_t count, void* context){
+	for (size_t k = 0; k < count; k++){
+		const RegistryRecord& r = records[k];
+
+		if(!r.isValid()){
+			*static_cast<bool*>(context) = true;
+			return false;
+		}
+
+		lastActivation = r.epoch;
+		activatedUntil = r.epoch + ActivatedTime.totalseconds();
+		if(r.epoch >= quotaPeriodEnd)
+			enterQuotaPeriod(r.epoch);
+
+		for (User& x : users)
+			if(r.user == x.getLetter()){
+				x.useToken(r.epoch);
+				activatedUntil = x.activatedUntil();
+			}
+	}
+	return true;
+}
+
+/**
+ * Counts the records of a block newer than a time, see replayPreviousLookBack(). Invalid ones
+ * are kept, so that replayRecords() refuses them.
+ *
+ * @param context Points to a RecentRecords.
+ * @return False, if a record isn't valid, true otherwise.
+ */
+bool replayRecentRecords(const RegistryRecord* records, size_t count, void* context){
+	RecentRecords& recent = *static_cast<RecentRecords*>(context);
+	RegistryRecord kept[REGISTRY_READ_CHUNK];
+	size_t n = 0;
+
+	for (size_t k = 0; k < count; k++)
+		if(!records[k].isValid() || records[k].epoch >= recent.from)
+			kept[n++] = records[k];
+
+	return replayRecords(kept, n, &recent.invalidRecord);
+}
+
+/**
+ * Update all users used tokens from the registry records written after the checkpoint.
+ * Records are streamed by small blocks, memory use doesn't depend on the registry size.
+ * 
+ * @param first Index of the first record to replay.
+ * @return Void.
+ */
+void updateUserTokens(size_t first){
+	bool invalidRecord = false;
+
+	if(!forEachRecord(rtbStorage.usage(), RegistrySlots[registrySlot], first, replayRecords, &invalidRecord)){
+		CurrentState = State::Problem;
+		logEvent(invalidRecord ? EventInvalidRecord : EventRegistryRead);
+	}
 }
 
+/**
+ * Copy the users used tokens into usageCheckpoint, the storage stage keeps it up to date afterwards.
+ *
+ * @return Void.
+ */
+void snapshotUsage(){
+	usageCheckpoint.registryGeneration = registryHeader.generation;
+	usageCheckpoint.quotaPeriod = quotaPeriod;
+	usageCheckpoint.registryRecords = registryCount;
+	usageCheckpoint.lastActivation = lastActivation;
+
+	for (size_t i = 0; i < UserCount; i++){
+		usageCheckpoint.users[i].user = users[i].getLetter();
+		usageCheckpoint.users[i].reserved = 0;
+		usageCheckpoint.users[i].usedTokens = users[i].getUsedTokens();
+		usageCheckpoint.users[i].lastActivation = users[i].getLastActivation();
+		usageCheckpoint.users[i].quota = users[i].getQuota();
+	}
+}
 
 /**
- * Update the state of the RTB, based on global variable "lines".
+ * Save usageCheckpoint, so the next boot won't replay the registry.
+ *
+ * @return True, if the operation was successful, false otherwise.
+ */
+bool saveUsageCheckpoint(){
+	return saveCheckpoint(rtbStorage.usage(), UsageCheckpoint, usageCheckpoint);
+}
+
+
+/**
+ * Compresses the registry of the previous month, still whole in the other slot, into the archive
+ * (see Archive.h), unless it's already there. A failure is only logged : decisions don't need
+ * the archive, and the next boot tries again.
  *
  * @return Void.
  */
-void updateState(){
+void archivePreviousRegistry(){
+	MemoryScope memoryScope(MemoryArchive);
+	RegistryHeader previous;
+	std::string_view previousName = RegistrySlots[1 - registrySlot];
 
-	if(!RTC.now().isValid()){
+	// No month has ended yet, or its slot has been reused since
+	if(!readRegistryHeader(rtbStorage.usage(), previousName, previous) || previous.generation + 1 != registryHeader.generation)
+		return;
+
+	if(!archiveRegistry(rtbStorage.usage(), previousName, rtbStorage.archive(), RegistryArchive))
+		logEvent(EventArchive);
+}
+
+/**
+ * Gathers the characters received on the serial port, and answers the command once a line is
+ * complete : "boot" prints the boot profile, "trace" sends the tracepoints recorded since the
+ * previous "trace" as binary frames (see Trace.h), "mem" prints the memory report (see MemoryStats.h),
+ * anything else is an audit query (see runAuditCommand).
+ * Runs in the storage stage, between two writes.
+ *
+ * @return Void.
+ */
+void pollSerialCommand(){
+	static char line[AUDIT_LINE_SIZE];
+	static size_t length = 0;
+
+	while(Serial.available() > 0){
+		char c = (char)Serial.read();
+
+		if(c != '\n' && c != '\r'){
+			if(length < sizeof(line) - 1)
+				line[length++] = c;
+			continue;
+		}
+
+		if(length == 0)
+			continue;
+
+		line[length] = 0;
+		length = 0;
+
+		if(strcmp(line, "boot") == 0){
+			bootProfile.print(Serial);
+			continue;
+		}
+
+		if(strcmp(line, "trace") == 0){
+			traceExport(Serial);
+			continue;
+		}
+
+		if(strcmp(line, "mem") == 0){
+			printMemoryReport(Serial);
+			continue;
+		}
+
+		MemoryScope memoryScope(MemoryAudit);
+		AuditStore<RtbStorage::UsageStorage, RtbStorage::ArchiveStorage> store{&rtbStorage.usage(), registrySlot, &registryIndex, &rtbStorage.archive(), RegistryArchive};
+		runAuditCommand(store, line, Serial);
+	}
+}
+
+
+/**
+ * The registry now holds the records of the month of epoch, computes when that month ends.
+ *
+ * @param epoch Unix time in the new month.
+ * @return Void.
+ */
+void enterQuotaPeriod(uint32_t epoch){
+	quotaPeriod = quotaPeriodOf(epoch);
+	quotaPeriodEnd = quotaPeriodStart(quotaPeriod + 1);
+}
+
+/**
+ * Update the state of the RTB, based on global variables "registryCount", "activatedUntil" and "quotaPeriodEnd".
+ * Users' quotas are checked apart, see QuotaPolicy.h.
+ *
+ * @param now Unix time of the access.
+ * @return Void.
+ */
+void updateState(uint32_t now){
+	TRACE_SCOPE(TraceUpdateState);
+
+	if(!rtcClock.valid()){
 		CurrentState = State::Problem;
-		logErrorMessage += "\nRTC date is not valid.";
+		logEvent(EventRtcInvalid);
 		return;
 	}
 
 	// If there is no data
-	if(lines.empty()){
+	if(registryCount == 0){
 		CurrentState = State::Ready;
 		return;
 	}
 
-	// Get last line from the "lines" and
-	// convert it to DateTime object
-	DateTime lastDate = DateTime(lines.back().substr(1).c_str());//	Respect the format: iso8601dateTime
+	// The newest registry entry must be a valid date
+	DateTime lastDate = DateTime(lastActivation);
 	if(!lastDate.isValid()){
 		CurrentState = State::Problem;
-		logErrorMessage += "\nDate in global variable \"lines\" isn't valid, see the registry file.";
+		logEvent(EventLastActivationInvalid);
 		return;
 	}
 
 	// Verify if it has been activated recently
-	if((lastDate + ActivatedTime) >= RTC.now()){
+	if(now <= activatedUntil){
 		CurrentState = State::Activated;
 		return;
 	}
 	
-	// If time elapsed since last activation is greater than one month or one year, renew tokens
-	if(lastDate.month() < RTC.now().month() || lastDate.year() < RTC.now().year()){
-		if(!usageStorage->clearFile(Registry)){
-			CurrentState = State::Problem;
-			logErrorMessage += "\nStorage can't be cleared.";
-		}
-			
-		lines.clear();
+	// If the month (or year) has changed since the tokens were used, start a new registry
+	if(now >= quotaPeriodEnd){
+		registryCount = 0;
+		enterQuotaPeriod(now);
 		
 		for (User& x : users)
 			x.resetUsedTokens();
+
+		// The registry is emptied by the storage stage
+		StorageJob job = {};
+		job.type = JobRenewal;
+		job.quotaPeriod = quotaPeriod;
+		queueStorageJob(job);
 	}
 
 	CurrentState = State::Ready;
 }
 
 
-/**
- * Loop that waits for the user input. Could be replace by an input coming from a web server.
- * TODO : clean this code and make it smaller... definitely too much repetition here
- *
- * @return Whole user input as a string.
- */
-std::string getUserInput(){
-	std::string input = "";
-
-	int Button1State, Button2State, Button3State = 0;
-	while(digitalRead(EnterPin) != HIGH){
-		Button1State = digitalRead(Button1);
-		Button2State = digitalRead(Button2);
-		Button3State = digitalRead(Button3);
-
-    
-		// Debouncing-like function
-		if(Button1State==HIGH){
-			while (Button1State == HIGH)
-			{
-				delay(50);
-				Button1State = digitalRead(Button1);
-			}
-			input += '1';
-		}
-		else if(Button2State==HIGH){
-			while (Button2State == HIGH)
-			{
-				delay(50);
-				Button2State = digitalRead(Button2);
-			}
-			input += '2';
-		}
-		else if(Button3State==HIGH){
-			while (Button3State == HIGH)
-			{
-				delay(50);
-				Button3State = digitalRead(Button3);
-			}
-			input += '3';
-		}
-		
-		delay(50);
-	}
-
-	return input;
-}
-
 /**
  * Verify that the input correspond to a password. If it doesn't, the return will be -1.
+ * Lookup takes constant time, see UserIndex.h.
  *
  * @param input Must match a user's password.
+ * @param length Number of characters of input.
  * @return returns an int, as an index of the corresponding user.
  */
-int returnUserIndex(std::string input){
-	int index = 0;
-
-	for (User x : users){
-		if(x.getPwd() == input.c_str())
-			return index;
-		index++;
-	}
-	return -1;
+int returnUserIndex(const char* input, size_t length){
+	TRACE_SCOPE(TraceUserIndex);
+	return findUser(input, length);
 }
 
-/**Registry
- * Increment the number of used tokens and write to the storage.
- * Also, it appends a line to lines global variable.
+/**
+ * Increment the number of used tokens. The record is appended to the registry,
+ * and the checkpoint file updated, by the storage stage.
  *
  * @param index Index representing the user in Users global variable.
+ * @param now Unix time of the access.
  * @return Void.
  */
-void incrementUsedTokens(int index){
-	std::string nLine;     // nLine will be written in the registry file
-
-	nLine.push_back(users[index].getLetter());
-
-	nLine += RTC.now().timestamp(DateTime::TIMESTAMP_FULL).c_str();
+void incrementUsedTokens(int index, uint32_t now){
+	// Record that will be written in the registry file (8 bytes)
+	RegistryRecord record = RegistryRecord::make(users[index].getLetter(), now);
 
-	if(!usageStorage->addLine(Registry,nLine.c_str())){
-		CurrentState = State::Problem;
-		logErrorMessage += "\nCannot append a line in the registry file.";
-	}
+	registryCount++;
+	lastActivation = now;
+	if(now >= quotaPeriodEnd)
+		enterQuotaPeriod(now);
 	
-	lines.push_back(nLine);
-	
-	users[index].addUsedTokens();
+	users[index].useToken(now);
+	activatedUntil = users[index].activatedUntil();
+
+	StorageJob job = {};
+	job.type = JobRecord;
+	job.user = index;
+	job.quotaPeriod = quotaPeriod;
+	job.record = record;
+	queueStorageJob(job);
 
 	debug("\nUser has used one token.");
 }
 
 /**
- * Opens the lock pins for a given time.
+ * Opens the lock pins for a given time. Returns immediately, the lock is released by a timer.
  *
- * @param delayMillisec Duration of the delay in milliseconds.
+ * @param delayMillisec Duration of the opening in milliseconds.
  * @return Void.
  */
 void openLock(int delayMillisec){
-	digitalWrite(LockPin,HIGH);
-	delay(delayMillisec);
-	digitalWrite(LockPin,LOW);
+	TRACE_SCOPE(TraceOpenLock);
+
+	if(!lockActuator.pulse(delayMillisec)){
+		CurrentState = State::Problem;
+		logEvent(EventLockOpen);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,313 @@
+/**************************************************************************************
+Program :   AuditCli.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host front end of the audit queries (see Audit.h). Runs the engine of the firmware,
+            and the same commands as its serial port, on copied files : the internal memory
+            (registry slots) and the SD card (archive) of a board, or those of the native build.
+            With --bench, builds histories of growing length on the simulated board (registry
+            on the flash, archive on the SD card) and prints, as JSON, the latency, bytes read
+            and file opens of each query, next to a whole read of the history that finds the
+            same records.
+
+Usage :     program [--registry dir] [--archive dir] who|count FROM TO [USER|DAYS]
+            program --bench [--records-per-month N] [--iterations N] [--seed N]
+            --registry defaults to the flash of the native build, --archive to its SD card,
+            or to the registry directory when the SD card holds no archive.
+**************************************************************************************/
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "../RegistryFormat.h"
+#include "../QuotaPolicy.h"
+#include "../Archive.h"
+#include "../Audit.h"
+#include "PosixStorage.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	std::string registry;			// Directory holding the registry slots
+	std::string archive;			// Directory holding the archive
+	std::string command;			// Query, as typed on the serial port
+	bool bench = false;
+	long recordsPerMonth = 650;		// About what the sim's users type
+	long iterations = 20;			// Runs of each query, the median is printed
+	uint64_t seed = 1;
+};
+
+/**
+ * A query of the benchmark, as a command and as the range it reads.
+ */
+struct BenchQuery {
+	const char* name;
+	uint32_t from;
+	uint32_t to;
+	uint32_t width;					// Count query : bucket length in seconds, 0 for a record query
+};
+
+Options options;
+
+const long HistoryMonths[] = {1, 12, 60};		// Months of history of the benchmark, the last one in the registry
+const uint32_t StartEpoch = 1640995200;		// 2022-01-01T00:00:00
+const char BenchUsers[] = "abcde";
+const uint32_t Day = 86400;
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bench")
+			options.bench = true;
+		else if (arg == "--registry" && i + 1 < argc)
+			options.registry = argv[++i];
+		else if (arg == "--archive" && i + 1 < argc)
+			options.archive = argv[++i];
+		else if (arg == "--records-per-month" && i + 1 < argc)
+			options.recordsPerMonth = atol(argv[++i]);
+		else if (arg == "--iterations" && i + 1 < argc)
+			options.iterations = atol(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc)
+			options.seed = strtoull(argv[++i], nullptr, 10);
+		else
+			options.command += (options.command.empty() ? "" : " ") + arg;
+	}
+}
+
+int query() {
+	if (options.registry.empty())
+		options.registry = nativehal::fsRoot() + "/littlefs";
+	if (options.archive.empty()) {
+		options.archive = nativehal::fsRoot() + "/sd";
+		PosixStorage sd(options.archive, 0);
+		if (!sd.fileExist(RegistryArchive))
+			options.archive = options.registry;
+	}
+
+	PosixStorage usage(options.registry, 0);
+	PosixStorage archive(options.archive, 0);
+	TimeIndex index;
+	AuditStore<> store{&usage, 0, &index, &archive, RegistryArchive};
+	RegistryHeader header;
+
+	if (!openRegistry(*store.usage, store.slot, header)) {
+		fprintf(stderr, "%s : no registry.\n", options.registry.c_str());
+		return 1;
+	}
+
+	return runAuditCommand(store, options.command.c_str(), Serial) ? 0 : 1;
+}
+
+/**
+ * Registries of months months, all archived but the last one, as the firmware leaves them.
+ *
+ * @return Epoch just after the newest record.
+ */
+uint32_t buildHistory(Storage& usage, Storage& archive, long months, size_t& slot) {
+	std::mt19937_64 random(options.seed);
+	RegistryHeader header = RegistryHeader::make(0, 0);
+	slot = 1;
+	uint32_t epoch = StartEpoch;
+
+	archive.createFile(RegistryArchive);
+
+	for (long m = 0; m < months; m++) {
+		uint32_t period = quotaPeriodOf(epoch);
+		uint32_t end = quotaPeriodStart(period + 1);
+		uint32_t step = (end - epoch) / (options.recordsPerMonth + 1);
+		std::vector<RegistryRecord> records;
+
+		if (!renewRegistry(usage, slot, header, period)) {
+			fprintf(stderr, "Couldn't create the registry of month %ld.\n", m);
+			exit(1);
+		}
+
+		for (long r = 0; r < options.recordsPerMonth; r++) {
+			epoch += 1 + random() % (2 * step);
+			if (epoch >= end)
+				break;
+			records.push_back(RegistryRecord::make(BenchUsers[random() % (sizeof(BenchUsers) - 1)], epoch));
+		}
+
+		if (!usage.appendBytes(RegistrySlots[slot], (const uint8_t*)records.data(), records.size() * sizeof(RegistryRecord))) {
+			fprintf(stderr, "Couldn't fill the registry of month %ld.\n", m);
+			exit(1);
+		}
+
+		if (m + 1 < months && !archiveRegistry(usage, RegistrySlots[slot], archive, RegistryArchive)) {
+			fprintf(stderr, "Couldn't archive month %ld.\n", m);
+			exit(1);
+		}
+		epoch = end;
+	}
+	return epoch;
+}
+
+struct ScanResult {
+	const BenchQuery* query;
+	uint64_t records;				// Record query : records found. Count query : sum of the counts
+	uint64_t checksum;				// Of the records found, order included
+};
+
+bool scanRecords(const RegistryRecord* records, size_t count, void* context) {
+	ScanResult& s = *static_cast<ScanResult*>(context);
+
+	for (size_t k = 0; k < count; k++) {
+		const RegistryRecord& r = records[k];
+		if (!r.isValid() || r.epoch < s.query->from || r.epoch >= s.query->to)
+			continue;
+		s.records++;
+		s.checksum = s.checksum * 31 + r.epoch * 131 + r.user;
+	}
+	return true;
+}
+
+struct ScanContext {
+	Storage& archive;
+	ScanResult& result;
+};
+
+bool scanSegment(const ArchiveSegment& segment, void* context) {
+	ScanContext& c = *static_cast<ScanContext*>(context);
+	return readSegment(c.archive, RegistryArchive, segment, scanRecords, &c.result);
+}
+
+/**
+ * What a query costs without the engine : the whole archive decoded, then the whole registry.
+ */
+bool wholeRead(Storage& usage, Storage& archive, size_t slot, ScanResult& result) {
+	ScanContext c{archive, result};
+	return forEachSegment(archive, RegistryArchive, scanSegment, &c)
+		&& forEachRecord(usage, RegistrySlots[slot], 0, scanRecords, &result);
+}
+
+/**
+ * Same records through the engine : a record query is summed as they come, a count query from its buckets.
+ */
+bool engineRead(AuditStore<>& store, const BenchQuery& q, ScanResult& result, AuditStats& stats) {
+	static AuditCounts counts;
+
+	if (!q.width)
+		return auditRecords(store, q.from, q.to, 0, scanRecords, &result, &stats);
+
+	if (!auditCounts(store, q.from, q.to, q.width, counts, &stats))
+		return false;
+	for (size_t b = 0; b < counts.buckets; b++)
+		for (size_t i = 0; i <= UserCount; i++)
+			result.records += counts.counts[b][i];
+	return true;
+}
+
+struct Measure {
+	double p50Micros;
+	double bytesRead;
+	double fileOpens;
+};
+
+template<typename F>
+Measure measure(F run) {
+	std::vector<double> samples;
+	uint64_t bytes = 0, opens = 0;
+
+	for (long i = 0; i < options.iterations; i++) {
+		uint64_t bytesBefore = nativehal::counters().bytesRead, opensBefore = nativehal::counters().fileOpens;
+		Clock::time_point t = Clock::now();
+		run();
+		samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+		bytes += nativehal::counters().bytesRead - bytesBefore;
+		opens += nativehal::counters().fileOpens - opensBefore;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	return {samples[samples.size() / 2], (double)bytes / options.iterations, (double)opens / options.iterations};
+}
+
+int bench() {
+	bool first = true;
+
+	printf("{\n");
+	printf("  \"recordsPerMonth\": %ld,\n", options.recordsPerMonth);
+	printf("  \"iterations\": %ld,\n", options.iterations);
+	printf("  \"results\": [\n");
+
+	for (long months : HistoryMonths) {
+		nativehal::wipeFs();
+		nativehal::reset();
+
+		FlashMem flash;
+		mSdCard sdCard;
+		size_t slot;
+
+		if (!flash.init() || !sdCard.init()) {
+			fprintf(stderr, "Couldn't start the simulated storage.\n");
+			return 1;
+		}
+
+		uint32_t end = buildHistory(flash, sdCard, months, slot);
+		uint32_t newest = quotaPeriodStart(quotaPeriodOf(end - 1));
+		uint32_t middle = quotaPeriodStart(quotaPeriodOf(StartEpoch + (end - StartEpoch) / 2));
+
+		const BenchQuery queries[] = {
+			{"whoLastDay", end - Day, end, 0},
+			{"whoDayMidHistory", middle + 10 * Day, middle + 11 * Day, 0},
+			{"countWeeksLastMonth", newest, end, 7 * Day},
+			{"countWeeksMidHistory", middle, middle + 28 * Day, 7 * Day},
+			{"countWholeHistory", StartEpoch, end, end - StartEpoch},
+		};
+
+		TimeIndex index;
+		AuditStore<> store{&flash, slot, &index, &sdCard, RegistryArchive};
+		size_t records = 0;
+		registryRecordCount(*store.usage, RegistrySlots[slot], records);
+
+		Measure build = measure([&]() { index.invalidate(); index.build(*store.usage, RegistrySlots[slot]); });
+
+		for (const BenchQuery& q : queries) {
+			ScanResult expected{&q, 0, 0}, found{&q, 0, 0};
+			AuditStats stats = {};
+			bool ok = wholeRead(flash, sdCard, slot, expected) && engineRead(store, q, found, stats);
+
+			Measure engine = measure([&]() { ScanResult r{&q, 0, 0}; AuditStats s; engineRead(store, q, r, s); });
+			Measure whole = measure([&]() { ScanResult r{&q, 0, 0}; wholeRead(flash, sdCard, slot, r); });
+
+			bool same = ok && expected.records == found.records && (q.width || expected.checksum == found.checksum);
+
+			printf("%s    {\"months\": %ld, \"registryRecords\": %zu, \"query\": \"%s\", \"records\": %llu, \"sameAsWholeRead\": %s,\n"
+				"     \"segmentsRead\": %u, \"segmentsSkipped\": %u, \"recordsRead\": %u, \"indexBuildMicros\": %.1f,\n"
+				"     \"engineMicros\": %.1f, \"engineBytesRead\": %.0f, \"engineFileOpens\": %.1f,\n"
+				"     \"wholeReadMicros\": %.1f, \"wholeReadBytesRead\": %.0f, \"wholeReadFileOpens\": %.1f, \"speedup\": %.1f}",
+				first ? "" : ",\n", months, records, q.name, (unsigned long long)found.records, same ? "true" : "false",
+				stats.segmentsRead, stats.segmentsSkipped, stats.recordsRead, build.p50Micros,
+				engine.p50Micros, engine.bytesRead, engine.fileOpens,
+				whole.p50Micros, whole.bytesRead, whole.fileOpens, engine.p50Micros > 0 ? whole.p50Micros / engine.p50Micros : 0.0);
+			first = false;
+		}
+	}
+
+	printf("\n  ]\n}\n");
+	return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+	if (options.iterations < 1)
+		options.iterations = 1;
+
+	if (options.bench)
+		return bench();
+
+	if (options.command.empty()) {
+		fprintf(stderr, "Usage : %s [--registry dir] [--archive dir] who|count FROM TO [USER|DAYS]\n", argv[0]);
+		return 1;
+	}
+	return query();
+}
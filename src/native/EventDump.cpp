@@ -0,0 +1,89 @@
+/**************************************************************************************
+Program :   EventDump.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host decoder of the error log. Reads the ring file (see RingLog.h) of a copied SD
+            card or of the simulated one, unpacks the events of each entry (see EventLog.h)
+            and prints them as text, oldest first : sequence number of the entry, date of
+            the event, its text and its argument.
+
+Usage :     program [--dir path] [--file name] [--count N]
+            --dir defaults to the SD card of the native build, --count to the whole ring.
+**************************************************************************************/
+#include <Arduino.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../RingLog.h"
+#include "../EventLog.h"
+#include "PosixStorage.h"
+
+namespace {
+
+struct Options {
+	std::string dir;				// Directory holding the log, e.g. the mount point of the card
+	std::string file = std::string(ErrorLog);
+	long count = RING_LOG_SLOTS;	// Newest entries to print
+};
+
+Options options;
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--dir")
+			options.dir = argv[i + 1];
+		else if (arg == "--file")
+			options.file = argv[i + 1];
+		else if (arg == "--count")
+			options.count = atol(argv[i + 1]);
+	}
+}
+
+bool collect(const RingLogEntry& entry, void* context) {
+	static_cast<std::vector<RingLogEntry>*>(context)->push_back(entry);
+	return true;
+}
+
+void print(const RingLogEntry& entry) {
+	Event events[EVENTS_PER_ENTRY];
+	size_t n = unpackEvents(entry, events, EVENTS_PER_ENTRY);
+
+	for (size_t i = 0; i < n; i++) {
+		std::string date = events[i].epoch ? DateTime(events[i].epoch).timestamp(DateTime::TIMESTAMP_FULL).c_str() : "no date            ";
+
+		printf("%6u  %s  %s", entry.sequence, date.c_str(), eventText(events[i].code));
+		if (events[i].arg)
+			printf(" (%u)", events[i].arg);
+		printf("\n");
+	}
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+	if (options.dir.empty())
+		options.dir = nativehal::fsRoot() + "/sd";
+
+	PosixStorage storage(options.dir, 0);
+	RingLog<> log(storage, options.file);
+
+	// open() creates or recreates a file that isn't a ring of this format : check it first
+	RingLogHeader header;
+	if (!storage.readBytes(options.file, 0, (uint8_t*)&header, sizeof(header)) || !header.isValid() || !log.open()) {
+		fprintf(stderr, "%s/%s : not an error log.\n", options.dir.c_str(), options.file.c_str());
+		return 1;
+	}
+
+	std::vector<RingLogEntry> entries;
+	if (!log.forEachNewest(options.count, collect, &entries)) {
+		fprintf(stderr, "%s/%s : couldn't be read.\n", options.dir.c_str(), options.file.c_str());
+		return 1;
+	}
+
+	for (auto e = entries.rbegin(); e != entries.rend(); ++e)
+		print(*e);
+	return 0;
+}
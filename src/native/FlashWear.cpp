@@ -0,0 +1,260 @@
+/**************************************************************************************
+Program :   FlashWear.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host analyzer of the flash wear caused by the usage files. Plays years of accesses
+            through FlashMem, with the LittleFS operations replayed on a simulated NOR flash
+            (see lib/NativeHal/src/NorFlash.h, ESP32 partition geometry and esp_littlefs
+            configuration), once per way of writing the registry :
+              textPerLine       text registry, one open / append / close per line (older versions)
+              textBuffered      same lines, gathered by JournaledStorage until its buffer is full
+              binaryPerRecord   8 bytes records, appended through the handle cache
+              binaryBuffered    same records, gathered until the buffer is full
+              firmware          what main.cpp does : appendRecord() and the checkpoint after each access
+            Binary registries are renewed as main.cpp does, in the other slot (see RegistryFormat.h).
+            Prints, as JSON, the erases per block, the write amplification (bytes programmed on
+            the flash per byte written by the firmware) and the projected lifetime of the partition.
+
+Usage :     program [--years N] [--accesses-per-day N] [--log-lines-per-day N] [--seed N]
+                    [--endurance cycles] [--per-block 0|1]
+**************************************************************************************/
+#include <Arduino.h>
+#include <NorFlash.h>
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "../RegistryFormat.h"
+#include "../Checkpoint.h"
+
+namespace {
+
+struct Options {
+	long years = 1;
+	double accessesPerDay = 20;		// Codes typed on the keypad
+	double logLinesPerDay = 0;		// Text log lines, as older versions wrote them on the flash without SD card
+	uint64_t seed = 1;
+	uint32_t endurance = 100000;
+	bool perBlock = false;			// Erase count of every block
+};
+
+struct Scenario {
+	const char* name;
+	bool binary;
+	bool buffered;					// Appends wait in a JournaledStorage buffer until it is full
+	bool checkpoint;				// Checkpoint written after each access
+	size_t cachedHandles;
+};
+
+const Scenario Scenarios[] = {
+	{"textPerLine", false, false, false, 0},
+	{"textBuffered", false, true, false, HANDLE_CACHE_SIZE},
+	{"binaryPerRecord", true, false, false, HANDLE_CACHE_SIZE},
+	{"binaryBuffered", true, true, false, HANDLE_CACHE_SIZE},
+	{"firmware", true, false, true, HANDLE_CACHE_SIZE},
+};
+
+const uint32_t StartEpoch = 1640995200;		// 2022-01-01T00:00:00
+const uint32_t SecondsPerDay = 86400;
+const char LogLine[] = "2022-06-20T12:00:00 Cannot append a record in the registry file.";
+
+Options options;
+
+// Registry in use, as main.cpp keeps it
+size_t registrySlot = 0;
+RegistryHeader registryHeader = {};
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--years")
+			options.years = atol(argv[i + 1]);
+		else if (arg == "--accesses-per-day")
+			options.accessesPerDay = atof(argv[i + 1]);
+		else if (arg == "--log-lines-per-day")
+			options.logLinesPerDay = atof(argv[i + 1]);
+		else if (arg == "--seed")
+			options.seed = strtoull(argv[i + 1], nullptr, 10);
+		else if (arg == "--endurance")
+			options.endurance = atol(argv[i + 1]);
+		else if (arg == "--per-block")
+			options.perBlock = atoi(argv[i + 1]) != 0;
+	}
+}
+
+/**
+ * Unix times of the events of one day, count drawn around perDay, sorted.
+ */
+std::vector<uint32_t> dayEvents(std::mt19937_64& random, uint32_t day, double perDay) {
+	std::poisson_distribution<int> count(perDay);
+	std::uniform_int_distribution<uint32_t> second(0, SecondsPerDay - 1);
+	std::vector<uint32_t> events(perDay > 0 ? count(random) : 0);
+
+	for (uint32_t& e : events)
+		e = day + second(random);
+	std::sort(events.begin(), events.end());
+	return events;
+}
+
+bool access(const Scenario& s, Storage& storage, Checkpoint& checkpoint, uint32_t epoch, size_t user) {
+	char letter = UsersPrep[user].username;
+
+	if (!s.binary) {
+		RegistryRecord r = RegistryRecord::make(letter, epoch);
+		char line[32];
+		r.toText(line, sizeof(line));
+		return storage.addLine(LegacyRegistry, line);
+	}
+
+	RegistryRecord r = RegistryRecord::make(letter, epoch);
+	std::string_view registry = RegistrySlots[registrySlot];
+	bool ok = s.buffered ? storage.appendBytes(registry, (const uint8_t*)&r, sizeof(r)) : appendRecord(storage, registry, r);
+	if (!s.checkpoint)
+		return ok;
+
+	checkpoint.registryRecords++;
+	checkpoint.lastActivation = epoch;
+	checkpoint.users[user].usedTokens++;
+	checkpoint.users[user].lastActivation = epoch;
+	return saveCheckpoint(storage, UsageCheckpoint, checkpoint) && ok;
+}
+
+bool renew(const Scenario& s, Storage& storage, Checkpoint& checkpoint, uint32_t epoch) {
+	if (!s.binary)
+		return storage.clearFile(LegacyRegistry);
+
+	if (!renewRegistry(storage, registrySlot, registryHeader, quotaPeriodOf(epoch)))
+		return false;
+	if (!s.checkpoint)
+		return true;
+
+	checkpoint.registryGeneration = registryHeader.generation;
+	checkpoint.registryRecords = 0;
+	checkpoint.quotaPeriod = quotaPeriodOf(epoch);
+	for (CheckpointUser& u : checkpoint.users)
+		u.usedTokens = 0;
+	return saveCheckpoint(storage, UsageCheckpoint, checkpoint);
+}
+
+void run(const Scenario& s, bool first) {
+	nativehal::wipeFs();
+	nativehal::reset();
+
+	nativehal::NorGeometry geometry;
+	geometry.endurance = options.endurance;
+	nativehal::LfsModel model(geometry);
+	nativehal::setFlashModel(&model);
+
+	FlashMem flash(s.cachedHandles);
+	JournaledStorage<> journal(&flash);
+	Storage& storage = s.buffered ? (Storage&)journal : (Storage&)flash;
+	for (std::string_view registry : RegistrySlots)
+		journal.setPolicy(registry, JournalBatched);
+	journal.setPolicy(LegacyRegistry, JournalBatched);
+	journal.setPolicy(LegacyErrorLog, JournalBatched);
+
+	registrySlot = 0;
+	registryHeader = RegistryHeader::make(1, quotaPeriodOf(StartEpoch));
+
+	Checkpoint checkpoint = {};
+	checkpoint.registryGeneration = registryHeader.generation;
+	checkpoint.quotaPeriod = quotaPeriodOf(StartEpoch);
+	for (size_t u = 0; u < UserCount; u++)
+		checkpoint.users[u].user = UsersPrep[u].username;
+
+	bool ok = storage.init()
+		&& (s.binary ? createRegistry(storage, RegistrySlots[0], registryHeader.generation, registryHeader.quotaPeriod) : storage.createFile(LegacyRegistry))
+		&& (!s.checkpoint || saveCheckpoint(storage, UsageCheckpoint, checkpoint));
+
+	std::mt19937_64 random(options.seed);
+	std::uniform_int_distribution<size_t> anyUser(0, UserCount - 1);
+	uint64_t accesses = 0, failures = ok ? 0 : 1;
+	uint32_t period = quotaPeriodOf(StartEpoch);
+	uint32_t days = (uint32_t)(options.years * 365);
+
+	for (uint32_t d = 0; d < days; d++) {
+		uint32_t day = StartEpoch + d * SecondsPerDay;
+
+		if (quotaPeriodOf(day) != period) {
+			period = quotaPeriodOf(day);
+			if (!renew(s, storage, checkpoint, day))
+				failures++;
+		}
+
+		for (uint32_t epoch : dayEvents(random, day, options.accessesPerDay)) {
+			accesses++;
+			if (!access(s, storage, checkpoint, epoch, anyUser(random)))
+				failures++;
+		}
+
+		for (size_t i = dayEvents(random, day, options.logLinesPerDay).size(); i > 0; i--)
+			if (!storage.addLine(LegacyErrorLog, LogLine))
+				failures++;
+	}
+
+	if (!journal.sync())
+		failures++;
+	nativehal::setFlashModel(nullptr);
+
+	const nativehal::WearStats& w = model.stats();
+	const std::vector<uint32_t>& erases = model.erasesPerBlock();
+	uint32_t maxErases = *std::max_element(erases.begin(), erases.end());
+	uint32_t minErases = *std::min_element(erases.begin(), erases.end());
+	size_t erased = std::count_if(erases.begin(), erases.end(), [](uint32_t e) { return e > 0; });
+	double years = (double)days / 365;
+
+	printf("%s    {\"scenario\": \"%s\", \"cachedHandles\": %zu, \"accesses\": %llu, \"failures\": %llu,\n"
+		"     \"logicalBytes\": %llu, \"programmedBytes\": %llu, \"readBytes\": %llu, \"writeAmplification\": %.1f,\n"
+		"     \"erases\": %llu, \"erasesPerAccess\": %.3f, \"commits\": %llu, \"compactions\": %llu, \"relocations\": %llu,\n"
+		"     \"copiedBytes\": %llu, \"programViolations\": %llu, \"outOfSpace\": %llu,\n"
+		"     \"blocksErased\": %zu, \"minErasesPerBlock\": %u, \"meanErasesPerBlock\": %.1f, \"maxErasesPerBlock\": %u,\n"
+		"     \"projectedLifetimeYears\": %.1f, \"levelledLifetimeYears\": %.1f",
+		first ? "" : ",\n", s.name, s.cachedHandles, (unsigned long long)accesses, (unsigned long long)failures,
+		(unsigned long long)w.logicalBytes, (unsigned long long)w.programmedBytes, (unsigned long long)w.readBytes,
+		w.logicalBytes ? (double)w.programmedBytes / w.logicalBytes : 0.0,
+		(unsigned long long)w.erases, accesses ? (double)w.erases / accesses : 0.0,
+		(unsigned long long)w.commits, (unsigned long long)w.compactions, (unsigned long long)w.relocations,
+		(unsigned long long)w.copiedBytes, (unsigned long long)w.programViolations, (unsigned long long)w.outOfSpace,
+		erased, minErases, (double)w.erases / erases.size(), maxErases,
+		maxErases ? geometry.endurance * years / maxErases : 0.0,
+		w.erases ? geometry.endurance * years * erases.size() / w.erases : 0.0);
+
+	if (options.perBlock) {
+		printf(",\n     \"erasesPerBlock\": [");
+		for (size_t b = 0; b < erases.size(); b++)
+			printf("%s%u", b ? ", " : "", erases[b]);
+		printf("]");
+	}
+	printf("}");
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+	if (options.years < 1)
+		options.years = 1;
+
+	nativehal::NorGeometry geometry;
+
+	printf("{\n");
+	printf("  \"years\": %ld,\n", options.years);
+	printf("  \"accessesPerDay\": %.1f,\n", options.accessesPerDay);
+	printf("  \"logLinesPerDay\": %.1f,\n", options.logLinesPerDay);
+	printf("  \"seed\": %llu,\n", (unsigned long long)options.seed);
+	printf("  \"geometry\": {\"blockSize\": %u, \"blockCount\": %u, \"progSize\": %u, \"cacheSize\": %u, \"blockCycles\": %u, \"endurance\": %u},\n",
+		geometry.blockSize, geometry.blockCount, geometry.progSize, geometry.cacheSize, geometry.blockCycles, options.endurance);
+	printf("  \"results\": [\n");
+
+	bool first = true;
+	for (const Scenario& s : Scenarios) {
+		run(s, first);
+		first = false;
+	}
+
+	printf("\n  ]\n}\n");
+	return 0;
+}
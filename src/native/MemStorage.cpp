@@ -0,0 +1,112 @@
+#include "MemStorage.h"
+
+#include <cstring>
+
+/**
+ * Nothing to mount, the files of a previous init() are kept.
+ */
+bool MemStorage::init(){
+    return true;
+}
+
+bool MemStorage::fileExist(std::string_view fileName){
+    return _files.count(fileName) > 0;
+}
+
+/**
+ * Creates a file with the name provided, an existing file is emptied.
+ */
+bool MemStorage::createFile(std::string_view fileName){
+    _files[std::string(fileName)].clear();
+    return true;
+}
+
+/**
+ * Append a line to a file, the file is created if needed. The line is ended by "\r\n", as println() does.
+ */
+bool MemStorage::addLine(std::string_view fileName, std::string_view line){
+    std::vector<uint8_t>& file = _files[std::string(fileName)];
+
+    file.insert(file.end(), line.begin(), line.end());
+    file.push_back('\r');
+    file.push_back('\n');
+    return true;
+}
+
+/**
+ * Erase every data of a file.
+ *
+ * @return True, if the operation was successful, false if the file name doesn't exist.
+ */
+bool MemStorage::clearFile(std::string_view fileName){
+    auto f = _files.find(fileName);
+
+    if(f == _files.end())
+        return false;
+
+    f->second.clear();
+    return true;
+}
+
+bool MemStorage::fileSize(std::string_view fileName, size_t& size){
+    auto f = _files.find(fileName);
+
+    if(f == _files.end())
+        return false;
+
+    size = f->second.size();
+    return true;
+}
+
+/**
+ * Reads exactly length bytes, starting at offset.
+ *
+ * @return True, if every byte has been read, false otherwise.
+ */
+bool MemStorage::readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length){
+    auto f = _files.find(fileName);
+
+    if(f == _files.end() || offset > f->second.size() || length > f->second.size() - offset)
+        return false;
+
+    memcpy(buffer, f->second.data() + offset, length);
+    return true;
+}
+
+/**
+ * Append raw bytes to a file, the file is created if needed.
+ */
+bool MemStorage::appendBytes(std::string_view fileName, const uint8_t* data, size_t length){
+    std::vector<uint8_t>& file = _files[std::string(fileName)];
+
+    file.insert(file.end(), data, data + length);
+    return true;
+}
+
+/**
+ * Overwrite bytes in place, the file is created if needed. Offset can't be past the end of the file.
+ */
+bool MemStorage::writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length){
+    std::vector<uint8_t>& file = _files[std::string(fileName)];
+
+    if(offset > file.size())
+        return false;
+
+    if(offset + length > file.size())
+        file.resize(offset + length);
+
+    memcpy(file.data() + offset, data, length);
+    return true;
+}
+
+/**
+ * Lines are handed out straight from the file's buffer.
+ */
+bool MemStorage::forEachLine(std::string_view fileName, LineVisitor visitor, void* context){
+    auto f = _files.find(fileName);
+
+    if(f == _files.end())
+        return false;
+
+    return forEachLineIn(std::string_view((const char*)f->second.data(), f->second.size()), visitor, context);
+}
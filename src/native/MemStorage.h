@@ -0,0 +1,43 @@
+/**
+ * File :      MemStorage.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Host only backend that keeps every file in RAM. Nothing survives the process,
+ *             it is the lower bound the other backends are measured against (see StorageBench.cpp).
+*/
+#ifndef MEMSTORAGE_H
+#define MEMSTORAGE_H
+
+#include <map>
+
+#include "../Storage.h"
+
+/**
+ * Child class of Storage
+*/
+class MemStorage : public Storage{
+private:
+    std::map<std::string, std::vector<uint8_t>, std::less<>> _files;   // Found by std::string_view
+
+public:
+    MemStorage() = default;
+    MemStorage(const MemStorage &u) = delete;
+
+    ~MemStorage() = default;
+
+    bool init() override;
+
+    bool fileExist(std::string_view registreName) override;
+    bool createFile(std::string_view fileName) override;
+    bool addLine(std::string_view fileName, std::string_view line) override;
+    bool clearFile(std::string_view fileName) override;
+
+    bool fileSize(std::string_view fileName, size_t& size) override;
+    bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) override;
+    bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) override;
+    bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) override;
+
+    bool forEachLine(std::string_view fileName, LineVisitor visitor, void* context) override;
+};
+
+#endif
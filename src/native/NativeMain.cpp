@@ -0,0 +1,418 @@
+/**************************************************************************************
+Program :   NativeMain.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host entry point of the native build. Runs the unchanged setup()/loop() against
+            the simulated board (lib/NativeHal), types codes on the keypad and prints a
+            JSON report of wall-clock timings and hardware accesses. With --log-lines, also
+            appends lines to the error log through its journal, then straight to its backend.
+            With --clock-days, first follows a drifting RTC (--rtc-drift) with a ClockService
+            for that many virtual days and reports how far its answers were from the RTC.
+            --init-latency makes the RTC, LittleFS and the SD card take that long to start, in
+            real time, so the boot profile shows how much of it the boot sequence overlaps.
+            The report ends with the memory report of the firmware : heap per tag, free heap and stacks.
+
+Usage :     program [--history N] [--legacy 0|1] [--checkpoint 0|1] [--accesses N] [--code 123123]
+                    [--hold ms] [--log-lines N] [--file-latency us] [--rtc-drift ppm] [--clock-days N]
+                    [--init-latency us]
+**************************************************************************************/
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "../RegistryFormat.h"
+#include "../Checkpoint.h"
+#include "../Keypad.h"
+#include "../Actuator.h"
+#include "../ClockService.h"
+#include "../BootSequence.h"
+#include "../MemoryStats.h"
+
+void setup();
+void loop();
+
+extern RtbStorage rtbStorage;
+extern int CurrentState;
+extern Keypad keypad;
+extern Actuator lockActuator;
+extern ClockService rtcClock;
+extern BootProfile bootProfile;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	long history = 0;			// Registry entries present before boot
+	bool legacy = false;		// History written as a text registry, migrated during boot
+	bool checkpoint = false;	// History already covered by a checkpoint, i.e. not the first boot
+	long accesses = 10;			// Codes typed after boot
+	std::string code = UsersPrep[0].password;
+	uint32_t hold = 120;		// How long each key is held down, in ms
+	long logLines = 0;			// Lines appended to the error log after the accesses
+	uint32_t fileLatency = 0;	// Real time each file open takes, in us
+	uint32_t initLatency = 0;	// Real time the RTC, LittleFS and the SD card each take to start, in us
+	int32_t rtcDrift = 0;		// How much faster the RTC runs than the virtual clock, in ppm
+	long clockDays = 0;			// Virtual days of the clock check
+};
+
+struct Report {
+	double bootMicros = 0;
+	uint64_t bootVirtualMillis = 0;
+	size_t bootPeakHeapBytes = 0;		// Most heap used by setup(), on top of what was in use before
+	nativehal::Counters bootCounters;
+	size_t loopCalls = 0;				// Every loop() call, idle ones included
+	double loopTotalMicros = 0;
+	double loopMaxMicros = 0;
+	size_t keysRegistered = 0;
+	uint64_t pressLatencyTotal = 0;		// From a key going down to its registration by the keypad
+	uint64_t pressLatencyMax = 0;
+	uint32_t keysTyped = 0;
+	uint32_t lockOpenings = 0;
+	bool problem = false;
+	JournalStats journal = {};			// Error log lines written through the journal...
+	nativehal::Counters journalCounters;
+	double journalMicros = 0;
+	nativehal::Counters directCounters;	// ... and straight to the backend
+	double directMicros = 0;
+	ClockStats clock = {};				// Clock check : a call every virtual minute...
+	uint32_t clockMismatches = 0;		// ... answers that weren't the RTC's second...
+	uint32_t clockMaxErrorSeconds = 0;	// ... and the worst of them
+};
+
+Options options;
+Report report;
+
+double elapsedMicros(Clock::time_point since) {
+	return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+void printCounters(const char* name, const nativehal::Counters& c) {
+	printf("  \"%s\": {\"digitalReads\": %llu, \"digitalWrites\": %llu, \"rtcReads\": %llu, "
+		"\"fileOpens\": %llu, \"bytesRead\": %llu, \"bytesWritten\": %llu},\n", name,
+		(unsigned long long)c.digitalReads, (unsigned long long)c.digitalWrites, (unsigned long long)c.rtcReads,
+		(unsigned long long)c.fileOpens, (unsigned long long)c.bytesRead, (unsigned long long)c.bytesWritten);
+}
+
+/**
+ * Memory report of the firmware (see MemoryStats.h), as the "mem" serial command gives it.
+ */
+void printMemory() {
+	HeapStats heap = heapStats();
+	printf("  \"memory\": {\"heapFreeBytes\": %u, \"largestFreeBlock\": %u, \"minimumFreeBytes\": %u, \"tags\": {",
+		heap.freeBytes, heap.largestFreeBlock, heap.minimumFreeBytes);
+	for (uint8_t t = 0; t <= MemoryTagCount; t++) {
+		MemoryTagStats m = t < MemoryTagCount ? memoryTagStats(t) : memoryTotalStats();
+		printf("%s\n    \"%s\": {\"liveBytes\": %u, \"peakBytes\": %u, \"allocations\": %u, \"frees\": %u}",
+			t ? "," : "", t < MemoryTagCount ? memoryTagName(t) : "total", m.liveBytes, m.peakBytes, m.allocations, m.frees);
+	}
+	printf("},\n    \"stacks\": [");
+	for (size_t i = 0; i < watchedTaskCount(); i++) {
+		TaskStackStats t = taskStackStats(i);
+		printf("%s{\"name\": \"%s\", \"stackSize\": %u, \"minimumFreeBytes\": %u, \"hostStackUsedBytes\": %zu}",
+			i ? ", " : "", t.name, t.stackSize, t.minimumFreeBytes, nativehal::taskStackUsed(t.task));
+	}
+	printf("]},\n");
+}
+
+void printReport() {
+	double mean = report.loopCalls ? report.loopTotalMicros / report.loopCalls : 0;
+
+	printf("{\n");
+	printf("  \"historyEntries\": %ld,\n", options.history);
+	printf("  \"legacyHistory\": %s,\n", options.legacy ? "true" : "false");
+	printf("  \"checkpointed\": %s,\n", options.checkpoint ? "true" : "false");
+	printf("  \"bootMicros\": %.1f,\n", report.bootMicros);
+	printf("  \"bootVirtualMillis\": %llu,\n", (unsigned long long)report.bootVirtualMillis);
+	printf("  \"bootPeakHeapBytes\": %zu,\n", report.bootPeakHeapBytes);
+	printCounters("bootCounters", report.bootCounters);
+	printCounters("totalCounters", nativehal::counters());
+
+	printf("  \"bootProfile\": {\"initLatencyMicros\": %u, \"readyMicros\": %u, \"phases\": [", options.initLatency, bootProfile.readyMicros());
+	for (size_t i = 0; i < bootProfile.count(); i++) {
+		const BootPhase& p = bootProfile.phase(i);
+		printf("%s\n    {\"name\": \"%s\", \"startMicros\": %u, \"endMicros\": %u, \"ok\": %s}",
+			i ? "," : "", p.name, p.startMicros, p.endMicros, p.ok ? "true" : "false");
+	}
+	printf("]},\n");
+	printMemory();
+
+	printf("  \"accesses\": %ld,\n", options.accesses);
+	printf("  \"loopCalls\": %zu,\n", report.loopCalls);
+	printf("  \"loopMeanMicros\": %.2f,\n", mean);
+	printf("  \"loopMaxMicros\": %.1f,\n", report.loopMaxMicros);
+	printf("  \"keysTyped\": %u,\n", report.keysTyped);
+	printf("  \"keysRegistered\": %zu,\n", report.keysRegistered);
+	printf("  \"pressLatencyMeanMicros\": %.1f,\n", report.keysRegistered ? (double)report.pressLatencyTotal / report.keysRegistered : 0.0);
+	printf("  \"pressLatencyMaxMicros\": %llu,\n", (unsigned long long)report.pressLatencyMax);
+	printf("  \"keypadDroppedPresses\": %u,\n", keypad.stats().dropped);
+	printf("  \"lockOpenings\": %u,\n", report.lockOpenings);
+	printf("  \"lockPulses\": %u,\n", lockActuator.stats().pulses);
+	printf("  \"lockOnMicros\": %llu,\n", (unsigned long long)lockActuator.stats().totalOnMicros);
+	printf("  \"lockMaxOvershootMicros\": %u,\n", lockActuator.stats().maxOvershootMicros);
+	printf("  \"clockCalls\": %u,\n", rtcClock.stats().calls);
+	printf("  \"clockReads\": %u,\n", rtcClock.stats().reads);
+	printf("  \"clockSavedReads\": %u,\n", rtcClock.stats().savedReads);
+	if (options.clockDays > 0) {
+		printf("  \"clockCheckDays\": %ld,\n", options.clockDays);
+		printf("  \"clockCheckDriftPpm\": %d,\n", options.rtcDrift);
+		printf("  \"clockCheckMeasuredDriftPpm\": %.2f,\n", report.clock.driftPpb / 1000.0);
+		printf("  \"clockCheckCalls\": %u,\n", report.clock.calls);
+		printf("  \"clockCheckReads\": %u,\n", report.clock.reads);
+		printf("  \"clockCheckMaxCorrectionMicros\": %u,\n", report.clock.maxCorrectionMicros);
+		printf("  \"clockCheckUncertaintyMicros\": %u,\n", report.clock.uncertaintyMicros);
+		printf("  \"clockCheckMismatches\": %u,\n", report.clockMismatches);
+		printf("  \"clockCheckMaxErrorSeconds\": %u,\n", report.clockMaxErrorSeconds);
+	}
+	if (options.logLines > 0) {
+		printf("  \"logLines\": %ld,\n", options.logLines);
+		printf("  \"journalFlushes\": %u,\n", report.journal.flushes);
+		printf("  \"journalBytesWritten\": %u,\n", report.journal.bytesWritten);
+		printf("  \"journalFileOpens\": %llu,\n", (unsigned long long)report.journalCounters.fileOpens);
+		printf("  \"journalMicros\": %.1f,\n", report.journalMicros);
+		printf("  \"directFileOpens\": %llu,\n", (unsigned long long)report.directCounters.fileOpens);
+		printf("  \"directBytesWritten\": %llu,\n", (unsigned long long)report.directCounters.bytesWritten);
+		printf("  \"directMicros\": %.1f,\n", report.directMicros);
+	}
+	printf("  \"problem\": %s\n", report.problem ? "true" : "false");
+	printf("}\n");
+}
+
+/**
+ * Called by the virtual clock when the firmware never comes back, i.e. State::Problem.
+ */
+void onDeadline() {
+	report.problem = true;
+	report.lockOpenings = nativehal::pinRisingEdges(LockPin);
+	printReport();
+	exit(1);
+}
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--history")
+			options.history = atol(argv[i + 1]);
+		else if (arg == "--legacy")
+			options.legacy = atoi(argv[i + 1]) != 0;
+		else if (arg == "--checkpoint")
+			options.checkpoint = atoi(argv[i + 1]) != 0;
+		else if (arg == "--accesses")
+			options.accesses = atol(argv[i + 1]);
+		else if (arg == "--code")
+			options.code = argv[i + 1];
+		else if (arg == "--hold")
+			options.hold = atol(argv[i + 1]);
+		else if (arg == "--log-lines")
+			options.logLines = atol(argv[i + 1]);
+		else if (arg == "--file-latency")
+			options.fileLatency = atol(argv[i + 1]);
+		else if (arg == "--rtc-drift")
+			options.rtcDrift = atol(argv[i + 1]);
+		else if (arg == "--init-latency")
+			options.initLatency = atol(argv[i + 1]);
+		else if (arg == "--clock-days")
+			options.clockDays = atol(argv[i + 1]);
+	}
+}
+
+/**
+ * Asks a ClockService for the time every virtual minute, over options.clockDays, and compares
+ * its answers with the drifting RTC. Runs before setup(), no firmware timer slows the clock down.
+ */
+void checkClock() {
+	RTC_DS3231 rtc;
+	ClockService clock(rtc);
+
+	nativehal::setRtcDrift(options.rtcDrift);
+	clock.begin();
+	for (long minute = 0; minute < options.clockDays * 24 * 60; minute++) {
+		nativehal::advanceMicros(60000000);
+		uint32_t epoch = clock.now();
+		uint32_t truth = nativehal::rtcEpoch();
+		uint32_t error = epoch > truth ? epoch - truth : truth - epoch;
+
+		if (error > 0)
+			report.clockMismatches++;
+		if (error > report.clockMaxErrorSeconds)
+			report.clockMaxErrorSeconds = error;
+	}
+	report.clock = clock.stats();
+}
+
+/**
+ * Fills the registry with entries from an unconfigured user, so they cost a full replay
+ * at boot without consuming the configured users' tokens.
+ */
+void writeHistory() {
+	RtbStorage::UsageStorage& usage = rtbStorage.usage();
+	usage.init();
+
+	std::vector<RegistryRecord> history;
+	uint32_t start = nativehal::rtcEpoch() - 19 * 86400L;
+	for (long i = 0; i < options.history; i++)
+		history.push_back(RegistryRecord::make('z', start + (uint32_t)(i * 60 % (18 * 86400L))));
+
+	if (options.legacy) {
+		usage.createFile(LegacyRegistry);
+		char text[24];
+		for (const RegistryRecord& r : history) {
+			r.toText(text, sizeof(text));
+			usage.addLine(LegacyRegistry, text);
+		}
+	}
+	else {
+		createRegistry(usage, RegistrySlots[0]);
+		usage.appendBytes(RegistrySlots[0], (const uint8_t*)history.data(), history.size() * sizeof(RegistryRecord));
+	}
+
+	if (options.checkpoint && !options.legacy) {
+		Checkpoint checkpoint = {};
+		checkpoint.registryGeneration = 1;
+		checkpoint.registryRecords = history.size();
+		checkpoint.lastActivation = history.empty() ? 0 : history.back().epoch;
+		checkpoint.quotaPeriod = history.empty() ? 0 : quotaPeriodOf(checkpoint.lastActivation);
+		for (size_t i = 0; i < UserCount; i++)
+			checkpoint.users[i].user = UsersPrep[i].username;
+		saveCheckpoint(usage, UsageCheckpoint, checkpoint);
+	}
+}
+
+void runLoop() {
+	Clock::time_point t = Clock::now();
+	loop();
+	double us = elapsedMicros(t);
+	report.loopCalls++;
+	report.loopTotalMicros += us;
+	report.loopMaxMicros = std::max(report.loopMaxMicros, us);
+}
+
+/**
+ * Presses one key and runs loop() until it has been released for a while,
+ * noting when the keypad registered the press.
+ */
+void typeKey(uint8_t pin) {
+	uint64_t pressAt = nativehal::nowMicros() + 100000;
+	uint64_t until = pressAt + options.hold * 1000ULL + 100000;
+	uint32_t before = keypad.stats().events;
+
+	nativehal::pressKey(pin, pressAt, options.hold);
+	report.keysTyped++;
+
+	while (nativehal::nowMicros() < until)
+		runLoop();
+
+	if (keypad.stats().events > before) {
+		uint64_t latency = keypad.stats().lastEventAt - pressAt;
+		report.keysRegistered++;
+		report.pressLatencyTotal += latency;
+		report.pressLatencyMax = std::max(report.pressLatencyMax, latency);
+	}
+}
+
+/**
+ * Types one code followed by Enter, then lets the lock close again.
+ */
+void typeCode() {
+	for (char c : options.code)
+		typeKey(c == '1' ? Button1 : (c == '2' ? Button2 : Button3));
+	typeKey(EnterPin);
+
+	uint64_t until = nativehal::nowMicros() + 4000000;
+	while (nativehal::nowMicros() < until)
+		runLoop();
+}
+
+/**
+ * Appends the same lines to a text log, one every 100 ms, through a journal over the log
+ * backend and then straight to it, counting the file opens of each way.
+ */
+void benchmarkLog() {
+	JournaledStorage<> journal(&rtbStorage.log());
+	journal.setPolicy(LegacyErrorLog, JournalBatched);
+	journal.createFile(LegacyErrorLog);
+	JournalStats before = journal.stats();
+	char line[48];
+
+	nativehal::counters() = nativehal::Counters();
+	Clock::time_point t = Clock::now();
+	for (long i = 0; i < options.logLines; i++) {
+		snprintf(line, sizeof(line), "2022-06-20T12:00:00 event %ld", i);
+		journal.addLine(LegacyErrorLog, line);
+		nativehal::advanceMicros(100000);
+		journal.poll();
+	}
+	journal.sync();
+	report.journalMicros = elapsedMicros(t);
+	report.journalCounters = nativehal::counters();
+
+	report.journal = journal.stats();
+	report.journal.flushes -= before.flushes;
+	report.journal.bytesWritten -= before.bytesWritten;
+
+	nativehal::counters() = nativehal::Counters();
+	t = Clock::now();
+	for (long i = 0; i < options.logLines; i++) {
+		snprintf(line, sizeof(line), "2022-06-20T12:00:00 event %ld", i);
+		rtbStorage.log().addLine(LegacyErrorLog, line);
+		nativehal::advanceMicros(100000);
+	}
+	report.directMicros = elapsedMicros(t);
+	report.directCounters = nativehal::counters();
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+
+	if (options.clockDays > 0) {
+		nativehal::reset();
+		checkClock();
+	}
+
+	nativehal::wipeFs();
+	nativehal::reset();
+	nativehal::setRtcEpoch(DateTime(2022, 6, 20, 12, 0, 0).unixtime());
+	nativehal::setRtcDrift(options.rtcDrift);
+	writeHistory();
+	nativehal::counters() = nativehal::Counters();
+	nativehal::setInitLatency(nativehal::PeripheralRtc, options.initLatency);
+	nativehal::setInitLatency(nativehal::PeripheralFlash, options.initLatency);
+	nativehal::setInitLatency(nativehal::PeripheralSd, options.initLatency);
+
+	// Generous upper bound, only reached when the firmware is stuck in State::Problem
+	nativehal::setDeadline(nativehal::nowMicros() + (options.accesses + 10) * 60000000ULL, onDeadline);
+
+	// From here the driver doesn't allocate : the heap report is the firmware's
+	nativehal::resetHeap();
+	size_t heapBefore = memoryTotalStats().liveBytes;
+	resetMemoryPeaks();
+
+	Clock::time_point t0 = Clock::now();
+	uint64_t v0 = nativehal::nowMicros();
+	setup();
+	report.bootMicros = elapsedMicros(t0);
+	report.bootPeakHeapBytes = memoryTotalStats().peakBytes - heapBefore;
+	report.bootVirtualMillis = (nativehal::nowMicros() - v0) / 1000;
+	report.bootCounters = nativehal::counters();
+
+	for (long i = 0; i < options.accesses; i++)
+		typeCode();
+
+	report.lockOpenings = nativehal::pinRisingEdges(LockPin);
+	report.problem = CurrentState == State::Problem;
+
+	if (options.logLines > 0) {
+		nativehal::Counters total = nativehal::counters();
+		nativehal::setFileLatency(options.fileLatency);
+		benchmarkLog();
+		nativehal::counters() = total;
+	}
+	printReport();
+	return 0;
+}
@@ -0,0 +1,259 @@
+/**************************************************************************************
+Program :   PipelineStress.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host stress test of the task pipeline (see Pipeline.h). The firmware tasks run
+            as real threads while this program plays the hardware : it types codes on the
+            simulated keypad as fast as they are decided, with a slow storage, and measures
+            the real time from Enter being registered to the decision. At the end the
+            registry and checkpoint files are checked against the counters in memory, and
+            the stack high-water mark of each task is reported (see MemoryStats.h).
+            --fail-task makes the creation of a task fail : the firmware must then run
+            every stage in loop(), which this program calls wherever it waits. It is in
+            State::Problem, each code must be taken by the input stage and thrown away.
+
+Usage :     program [--codes N] [--file-latency us] [--rtc-step s] [--hold ms] [--gap ms]
+                    [--fail-task storage|policy|input]
+**************************************************************************************/
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "../RegistryFormat.h"
+#include "../Checkpoint.h"
+#include "../Keypad.h"
+#include "../SpscQueue.h"
+#include "../Pipeline.h"
+#include "../ClockService.h"
+#include "../MemoryStats.h"
+
+void setup();
+void loop();
+
+extern RtbStorage rtbStorage;
+extern int CurrentState;
+extern Keypad keypad;
+extern size_t registrySlot;
+extern size_t registryCount;
+extern SpscQueue<StorageJob, STORAGE_QUEUE_SIZE> storageQueue;
+extern PipelineStats pipelineStats;
+extern TaskHandle_t inputTask;
+extern TaskHandle_t policyTask;
+extern TaskHandle_t storageTask;
+extern ClockService rtcClock;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	long codes = 500;			// Codes typed
+	uint32_t fileLatency = 2000;	// Real time each file open takes, in us
+	uint32_t rtcStep = 90000;	// RTC jump before each code, in s (25 h : every code is out of the Activated window)
+	uint32_t hold = 30;			// How long each key is held down, in ms (virtual)
+	uint32_t gap = 30;			// Time between two keys, in ms (virtual)
+	std::string code = UsersPrep[0].password;
+	std::string failTask;		// Task whose creation fails, none if empty
+};
+
+Options options;
+std::vector<double> latencies;	// Real time from Enter to the decision, in us
+uint32_t timeouts = 0;
+bool loopTask = false;		// No pipeline task : loop() is called from this thread, the virtual clock keeps a single owner
+
+double elapsedMicros(Clock::time_point since) {
+	return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--codes")
+			options.codes = atol(argv[i + 1]);
+		else if (arg == "--file-latency")
+			options.fileLatency = atol(argv[i + 1]);
+		else if (arg == "--rtc-step")
+			options.rtcStep = atol(argv[i + 1]);
+		else if (arg == "--hold")
+			options.hold = atol(argv[i + 1]);
+		else if (arg == "--gap")
+			options.gap = atol(argv[i + 1]);
+		else if (arg == "--fail-task")
+			options.failTask = argv[i + 1];
+	}
+}
+
+/**
+ * Waits for the policy task to decide, up to one second.
+ */
+void waitDecision(uint32_t decisions, Clock::time_point registered) {
+	while (pipelineStats.decisions == decisions) {
+		if (elapsedMicros(registered) > 1000000) {
+			timeouts++;
+			return;
+		}
+		std::this_thread::yield();
+	}
+	latencies.push_back(elapsedMicros(registered));
+}
+
+/**
+ * Presses one key, the virtual clock moves one keypad sample at a time. Once Enter is
+ * registered (by the keypad timer, run from this thread), the clock stops until the decision.
+ */
+void typeKey(uint8_t pin) {
+	uint64_t pressAt = nativehal::nowMicros() + options.gap * 1000ULL;
+	uint64_t until = pressAt + options.hold * 1000ULL;
+	uint32_t events = keypad.stats().events;
+	uint32_t decisions = pipelineStats.decisions;
+
+	nativehal::pressKey(pin, pressAt, options.hold);
+
+	while (nativehal::nowMicros() < until) {
+		nativehal::advanceMicros(KEYPAD_SAMPLE_PERIOD_US);
+		if (loopTask)
+			loop();
+
+		if (pin == EnterPin && keypad.stats().events != events && !loopTask) {
+			waitDecision(decisions, Clock::now());
+			events = keypad.stats().events;
+		}
+	}
+}
+
+void typeCode() {
+	for (char c : options.code)
+		typeKey(c == '1' ? Button1 : (c == '2' ? Button2 : Button3));
+	typeKey(EnterPin);
+}
+
+/**
+ * Waits for the storage task to finish the queued jobs.
+ */
+void waitStorage() {
+	while (pipelineStats.storedJobs != pipelineStats.storageJobs) {
+		if (loopTask)
+			loop();
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/**
+ * The registry must hold as many records as the policy task counted, and the checkpoint
+ * must count the same tokens as the registry.
+ */
+bool filesMatchMemory() {
+	std::vector<RegistryRecord> records;
+	Checkpoint checkpoint;
+
+	if (!loadRegistry(rtbStorage.usage(), RegistrySlots[registrySlot], records) || records.size() != registryCount)
+		return false;
+
+	if (!loadCheckpoint(rtbStorage.usage(), UsageCheckpoint, checkpoint) || checkpoint.registryRecords != records.size())
+		return false;
+
+	for (size_t i = 0; i < UserCount; i++) {
+		long used = std::count_if(records.begin(), records.end(),
+			[&](const RegistryRecord& r) { return r.user == (uint8_t)UsersPrep[i].username; });
+		if (checkpoint.users[i].usedTokens != used)
+			return false;
+	}
+
+	return true;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+	if (sorted.empty())
+		return 0;
+	return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+
+	nativehal::wipeFs();
+	nativehal::reset();
+	nativehal::setRtcEpoch(DateTime(2022, 6, 20, 12, 0, 0).unixtime());
+
+	nativehal::failTaskCreation(options.failTask.empty() ? nullptr : options.failTask.c_str());
+	setup();
+
+	bool pipeline = inputTask != nullptr && policyTask != nullptr && storageTask != nullptr;
+	bool noTask = inputTask == nullptr && policyTask == nullptr && storageTask == nullptr;
+
+	if (options.failTask.empty() ? !pipeline : !noTask) {
+		fprintf(stderr, options.failTask.empty() ? "The pipeline isn't running, build with USE_TASK_PIPELINE set to true.\n"
+			: "Some tasks are still running, the stages would have two callers.\n");
+		return 1;
+	}
+
+	loopTask = noTask;
+
+	nativehal::setFileLatency(options.fileLatency);
+	nativehal::Counters before = nativehal::counters();
+
+	Clock::time_point t0 = Clock::now();
+	for (long i = 0; i < options.codes; i++) {
+		nativehal::setRtcEpoch(nativehal::rtcEpoch() + options.rtcStep);
+		rtcClock.requestResync();
+		typeCode();
+	}
+	double typingMicros = elapsedMicros(t0);
+
+	waitStorage();
+	double totalMicros = elapsedMicros(t0);
+
+	std::vector<double> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+	double mean = 0;
+	for (double us : sorted)
+		mean += us / sorted.size();
+
+	printf("{\n");
+	printf("  \"codes\": %ld,\n", options.codes);
+	printf("  \"pipeline\": %s,\n", pipeline ? "true" : "false");
+	printf("  \"fileLatencyMicros\": %u,\n", options.fileLatency);
+	printf("  \"decisions\": %u,\n", pipelineStats.decisions.load());
+	printf("  \"decisionTimeouts\": %u,\n", timeouts);
+	printf("  \"droppedCodes\": %u,\n", pipelineStats.droppedCodes.load());
+	printf("  \"decisionMeanMicros\": %.1f,\n", mean);
+	printf("  \"decisionP50Micros\": %.1f,\n", percentile(sorted, 0.50));
+	printf("  \"decisionP99Micros\": %.1f,\n", percentile(sorted, 0.99));
+	printf("  \"decisionMaxMicros\": %.1f,\n", sorted.empty() ? 0.0 : sorted.back());
+	printf("  \"decisionsPerSecond\": %.1f,\n", options.codes / (typingMicros / 1e6));
+	printf("  \"storageJobs\": %u,\n", pipelineStats.storedJobs.load());
+	printf("  \"storageStalls\": %u,\n", pipelineStats.storageStalls.load());
+	printf("  \"storageQueuePeak\": %u,\n", pipelineStats.storageQueuePeak.load());
+	printf("  \"storageFileOpens\": %llu,\n", (unsigned long long)(nativehal::counters().fileOpens - before.fileOpens));
+	printf("  \"storageDrainMicros\": %.1f,\n", totalMicros - typingMicros);
+	printf("  \"filesMatchMemory\": %s,\n", filesMatchMemory() ? "true" : "false");
+	printf("  \"heapLiveBytes\": %u,\n", memoryTotalStats().liveBytes);
+	printf("  \"heapPeakBytes\": %u,\n", memoryTotalStats().peakBytes);
+	printf("  \"taskStacks\": [");
+	for (size_t i = 0; i < watchedTaskCount(); i++) {
+		TaskStackStats t = taskStackStats(i);
+		printf("%s{\"name\": \"%s\", \"stackSize\": %u, \"minimumFreeBytes\": %u, \"hostStackUsedBytes\": %zu}",
+			i ? ", " : "", t.name, t.stackSize, t.minimumFreeBytes, nativehal::taskStackUsed(t.task));
+	}
+	printf("],\n");
+	printf("  \"problem\": %s\n", CurrentState == State::Problem ? "true" : "false");
+	printf("}\n");
+	fflush(stdout);
+
+	// A task that couldn't start is a problem : no decision, but no code left behind
+	bool passed = loopTask ? CurrentState == State::Problem && pipelineStats.decisions == 0 && pipelineStats.codes == options.codes
+		: timeouts == 0 && CurrentState != State::Problem;
+
+	// The tasks never return, leave without running the static destructors under their feet
+	_Exit(passed ? 0 : 1);
+}
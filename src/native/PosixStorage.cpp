@@ -0,0 +1,299 @@
+#include "PosixStorage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+/**
+ * Maps the file at least up to end. The mapping is made twice as long as needed, appends
+ * don't remap it each time : the pages past the end of the file are never read.
+ *
+ * @param end Bytes that must be mapped.
+ * @return True, if they are, false if the file couldn't be mapped.
+ */
+bool PosixFile::mapTo(size_t end){
+
+    if(end <= mapped)
+        return true;
+
+    if(map)
+        munmap(map, mapped);
+
+    size_t length = std::max((size_t)POSIX_MAP_MIN_SIZE, end * 2);
+    void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+
+    if(p == MAP_FAILED){
+        map = nullptr;
+        mapped = 0;
+        return false;
+    }
+
+    map = static_cast<uint8_t*>(p);
+    mapped = length;
+    return true;
+}
+
+void PosixFile::close(){
+
+    if(map)
+        munmap(map, mapped);
+    if(fd >= 0)
+        ::close(fd);
+
+    fd = -1;
+    map = nullptr;
+    mapped = 0;
+}
+
+/**
+ * Writes every byte, pwrite() may write less than asked.
+ */
+static bool writeAll(PosixFile& f, size_t offset, const uint8_t* data, size_t length){
+
+    while(length > 0){
+        ssize_t n = pwrite(f.fd, data, length, offset);
+
+        if(n <= 0)
+            return false;
+
+        data += n;
+        offset += n;
+        length -= n;
+    }
+
+    if(offset > f.size)
+        f.size = offset;
+
+    return true;
+}
+
+/**
+ * Creates the directory of the files if needed.
+ */
+bool PosixStorage::init(){
+
+    _handles.closeAll();
+
+    std::error_code ec;
+    std::filesystem::create_directories(_root, ec);
+
+    return std::filesystem::is_directory(_root, ec);
+}
+
+/**
+ * Verify that the given file exist.
+ *
+ * @param fileName File name.
+ * @return True, if the file exists, false otherwise.
+ */
+bool PosixStorage::fileExist(std::string_view fileName){
+
+    if(_handles.find(fileName))
+        return true;
+
+    return access((_root + "/").append(fileName).c_str(), F_OK) == 0;
+}
+
+/**
+ * Creates a file with the name provided, an existing file is emptied.
+ *
+ * @param fileName File name.
+ * @return True, if the file has been create, false otherwise.
+ */
+bool PosixStorage::createFile(std::string_view fileName){
+
+    Handle* h = handle(fileName, true);
+
+    if(!h)
+        return false;
+
+    bool ok = ftruncate(h->handle.fd, 0) == 0;
+    h->handle.size = 0;
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Append a line to a file, the file is created if needed.
+ *
+ * @param fileName File name.
+ * @param line Line of text to be added, ended by "\r\n" as println() does.
+ * @return True, if the operation was successful, false if the file couldn't be opened.
+ */
+bool PosixStorage::addLine(std::string_view fileName, std::string_view line){
+
+    std::string text = std::string(line) + "\r\n";
+
+    return appendBytes(fileName, (const uint8_t*)text.data(), text.size());
+}
+
+/**
+ * Erase every data of a file.
+ *
+ * @param fileName File's name that content will be erased.
+ * @return True, if the operation was successful, false if the file name doesn't exist.
+ */
+bool PosixStorage::clearFile(std::string_view fileName){
+
+    Handle* h = handle(fileName, false);
+
+    if(!h)
+        return false;
+
+    bool ok = ftruncate(h->handle.fd, 0) == 0;
+    h->handle.size = 0;
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Gives the size of a file.
+ *
+ * @param fileName File name.
+ * @param size Filled with the size in bytes.
+ * @return True, if the operation was successful, false if the file couldn't be opened.
+ */
+bool PosixStorage::fileSize(std::string_view fileName, size_t& size){
+
+    Handle* h = handle(fileName, false);
+
+    if(!h)
+        return false;
+
+    size = h->handle.size;
+
+    _handles.release(*h);
+
+    return true;
+}
+
+/**
+ * Reads exactly length bytes, starting at offset, out of the mapping.
+ *
+ * @param fileName File name.
+ * @param offset Position of the first byte to read.
+ * @param buffer Receives the data, must hold length bytes.
+ * @param length Number of bytes to read.
+ * @return True, if every byte has been read, false otherwise.
+ */
+bool PosixStorage::readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length){
+
+    Handle* h = handle(fileName, false);
+
+    if(!h)
+        return false;
+
+    PosixFile& f = h->handle;
+    bool ok = offset <= f.size && length <= f.size - offset && (length == 0 || f.mapTo(offset + length));
+
+    if(ok && length > 0)
+        memcpy(buffer, f.map + offset, length);
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Append raw bytes to a file, the file is created if needed.
+ *
+ * @param fileName File name.
+ * @param data Bytes to be added, nothing is put after them.
+ * @param length Number of bytes.
+ * @return True, if the operation was successful, false if the file couldn't be opened.
+ */
+bool PosixStorage::appendBytes(std::string_view fileName, const uint8_t* data, size_t length){
+
+    Handle* h = handle(fileName, true);
+
+    if(!h)
+        return false;
+
+    bool ok = writeAll(h->handle, h->handle.size, data, length);
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Overwrite bytes in place, the file is created if needed. Offset can't be past the end of the file.
+ *
+ * @param fileName File name.
+ * @param offset Position of the first byte to write.
+ * @param data Bytes to be written.
+ * @param length Number of bytes.
+ * @return True, if the operation was successful, false otherwise.
+ */
+bool PosixStorage::writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length){
+
+    Handle* h = handle(fileName, true);
+
+    if(!h)
+        return false;
+
+    bool ok = offset <= h->handle.size && writeAll(h->handle, offset, data, length);
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Lines are handed out straight from the mapping, the file is never copied.
+ */
+bool PosixStorage::forEachLine(std::string_view fileName, LineVisitor visitor, void* context){
+
+    Handle* h = handle(fileName, false);
+
+    if(!h)
+        return false;
+
+    PosixFile& f = h->handle;
+    bool ok = (f.size == 0 || f.mapTo(f.size))
+        && forEachLineIn(std::string_view((const char*)f.map, f.size), visitor, context);
+
+    _handles.release(*h);
+
+    return ok;
+}
+
+/**
+ * Open file, taken from the cache or opened for reading and writing. It is mapped on the first read.
+ *
+ * @param fileName File name.
+ * @param create Creates the file if it doesn't exist.
+ * @return The cache entry, nullptr if the file couldn't be opened.
+ */
+PosixStorage::Handle* PosixStorage::handle(std::string_view fileName, bool create){
+
+    if(Handle* h = _handles.find(fileName))
+        return h;
+
+    Handle* slot = _handles.slot(fileName);
+
+    if(!slot || (!slot->path[0] && !makePath(slot->path, (_root + "/").c_str(), fileName)))
+        return nullptr;
+
+    Handle& h = *slot;
+
+    PosixFile& f = h.handle;
+    struct stat st;
+
+    f.fd = open(h.path, O_RDWR | (create ? O_CREAT : 0), 0644);
+    h.open = f.fd >= 0 && fstat(f.fd, &st) == 0;
+    f.size = h.open ? st.st_size : 0;
+
+    if(!h.open)
+        f.close();
+
+    return h.open ? &h : nullptr;
+}
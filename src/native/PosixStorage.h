@@ -0,0 +1,71 @@
+/**
+ * File :      PosixStorage.h
+ * Author :    Loïc Bouillon
+ * Date :      17/10/2026
+ * Purpose :   Host only backend on plain files of a directory. Writes are pwrite() calls,
+ *             reads are copies out of a shared mapping of the file (mmap), which also lets
+ *             forEachLine() hand out lines without any read call.
+*/
+#ifndef POSIXSTORAGE_H
+#define POSIXSTORAGE_H
+
+#include <climits>
+
+#include "../Storage.h"
+#include "../HandleCache.h"
+
+#define POSIX_MAP_MIN_SIZE 65536    // Smallest mapping, growing files are mapped again when they pass its end
+
+/**
+ * Open file and its mapping, kept by the handle cache.
+ */
+struct PosixFile {
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t mapped = 0;              // Length of the mapping, may go past the end of the file
+    size_t size = 0;                // Length of the file, only this backend writes it
+
+    bool mapTo(size_t end);
+    void close();
+};
+
+/**
+ * Child class of Storage
+*/
+class PosixStorage : public Storage{
+private:
+    typedef HandleCache<PosixFile, PATH_MAX>::Entry Handle;
+
+    std::string _root;
+    HandleCache<PosixFile, PATH_MAX> _handles;
+
+    Handle* handle(std::string_view fileName, bool create);
+
+public:
+    /**
+     * @param root Directory of the files, created by init().
+     * @param cachedHandles Files kept open and mapped, 0 opens and maps them for each operation.
+     */
+    explicit PosixStorage(std::string_view root, size_t cachedHandles = HANDLE_CACHE_SIZE) : _root(root), _handles(cachedHandles) {}
+    PosixStorage(const PosixStorage &u) = delete;
+
+    ~PosixStorage(){ _handles.closeAll(); }
+
+    const HandleCacheStats& cacheStats() const { return _handles.stats(); }
+
+    bool init() override;
+
+    bool fileExist(std::string_view registreName) override;
+    bool createFile(std::string_view fileName) override;
+    bool addLine(std::string_view fileName, std::string_view line) override;
+    bool clearFile(std::string_view fileName) override;
+
+    bool fileSize(std::string_view fileName, size_t& size) override;
+    bool readBytes(std::string_view fileName, size_t offset, uint8_t* buffer, size_t length) override;
+    bool appendBytes(std::string_view fileName, const uint8_t* data, size_t length) override;
+    bool writeBytes(std::string_view fileName, size_t offset, const uint8_t* data, size_t length) override;
+
+    bool forEachLine(std::string_view fileName, LineVisitor visitor, void* context) override;
+};
+
+#endif
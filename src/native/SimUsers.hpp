@@ -0,0 +1,20 @@
+/**************************************************************************************
+Program :   SimUsers.hpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Users of the time-warp simulator (see TimeWarp.cpp), one per policy kind,
+            replaces UsersPrep when RTB_SIM_USERS is defined. The heavy user fills the
+            registry so boots have something to replay, its short activation keeps the
+            RTB from staying activated all the time.
+**************************************************************************************/
+#pragma once
+
+constexpr UsersConfig UsersPrep[] = {
+	{'a', "123123", 2},										// Monthly
+	{'b', "2121", 4, RollingQuota(30)},
+	{'c', "3311", 3, TokenBucket(7 * 86400)},
+	{'d', "1232", 2, MonthlyQuota().during(8, 20)},
+	{'e', "3131", 8, RollingQuota(3).during(22, 6)},		// Window over midnight
+	{'f', "2222", 1500, MonthlyQuota().activatedFor(1)},	// Heavy user
+	{'g', "1111", 1, MonthlyQuota().activatedFor(3600)},
+};
@@ -0,0 +1,201 @@
+/**************************************************************************************
+Program :   SteadyState.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host check that the hot path doesn't allocate. Boots the firmware once, then
+            types codes on the keypad (its sample() is called directly, no virtual time
+            is spent debouncing), mostly the heavy user of SimUsers.hpp so most accesses
+            spend a token and append a record, with a user of short activation, wrong codes
+            and codes too long for the keypad in between (the users activating the RTB for
+            a day would keep every later code from spending a token). Every operator new is counted (see
+            MemoryStats.h) : after the warm-up, the accesses must not allocate at all. The
+            RTC moves forward between accesses, the month changes and the registry is
+            renewed on the way. Prints a JSON report, exits with 1 if anything allocated.
+
+Usage :     program [--accesses N] [--warmup N] [--gap s]
+**************************************************************************************/
+#include <Arduino.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "../StorageManagement.h"
+#include "../Keypad.h"
+#include "../SpscQueue.h"
+#include "../Pipeline.h"
+#include "../MemoryStats.h"
+
+void setup();
+void loop();
+
+extern int CurrentState;
+extern Keypad keypad;
+extern size_t registryCount;
+extern SpscQueue<CodeEvent, CODE_QUEUE_SIZE> codeQueue;
+extern PipelineStats pipelineStats;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t StartEpoch = 1640995200;		// 2022-01-01T00:00:00
+const uint8_t DebounceSamples = 5;			// Samples a key is held down, then released
+
+// Codes typed in turn besides the heavy user : a user activating the RTB for an hour, a wrong
+// code, one longer than the small string buffer of std::string and one longer than the keypad keeps
+const char* const OtherCodes[] = {
+	"1111", "3213213", "12312312312312312312", "1231231231231231231231231231231231231",
+};
+const size_t OtherCodeCount = sizeof(OtherCodes) / sizeof(OtherCodes[0]);
+const char HeavyCode[] = "2222";
+
+struct Options {
+	long accesses = 1000000;	// Codes typed once the warm-up is done
+	long warmup = 100;			// Codes typed first, their allocations aren't counted
+	uint32_t gap = 1200;		// Virtual seconds between two codes, the heavy user spends about its monthly tokens
+};
+
+struct Report {
+	MemoryTagStats before[MemoryTagCount];
+	MemoryTagStats after[MemoryTagCount];
+	uint32_t lockOpenings = 0;
+	uint32_t decisions = 0;
+	uint32_t storageJobs = 0;	// Records appended and registries renewed
+	uint32_t virtualDays = 0;
+	double seconds = 0;
+	bool problem = false;
+};
+
+Options options;
+Report report;
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--accesses")
+			options.accesses = atol(argv[i + 1]);
+		else if (arg == "--warmup")
+			options.warmup = atol(argv[i + 1]);
+		else if (arg == "--gap")
+			options.gap = atol(argv[i + 1]);
+	}
+}
+
+uint8_t keyPin(char key) {
+	switch (key) {
+		case '1': return Button1;
+		case '2': return Button2;
+		case '3': return Button3;
+		default: return EnterPin;
+	}
+}
+
+/**
+ * Holds a key down long enough to be registered, releases it, and lets the input stage
+ * take it (the keypad queue is shorter than the longest code).
+ */
+void typeKey(char key) {
+	uint8_t pin = keyPin(key);
+
+	nativehal::setPin(pin, HIGH);
+	for (uint8_t i = 0; i < DebounceSamples; i++)
+		keypad.sample();
+	nativehal::setPin(pin, LOW);
+	for (uint8_t i = 0; i < DebounceSamples; i++)
+		keypad.sample();
+	loop();
+}
+
+/**
+ * Types the code of access i, then runs loop() until it has been decided and stored.
+ */
+void access(long i) {
+	const char* code = i % 4 == 3 ? OtherCodes[(i / 4) % OtherCodeCount] : HeavyCode;
+
+	nativehal::warpMicros(options.gap * 1000000ULL);
+	for (const char* c = code; *c; c++)
+		typeKey(*c);
+	typeKey('\n');
+
+	do
+		loop();
+	while (!codeQueue.empty() || pipelineStats.storedJobs != pipelineStats.storageJobs);
+}
+
+void snapshot(MemoryTagStats* stats) {
+	for (uint8_t t = 0; t < MemoryTagCount; t++)
+		stats[t] = memoryTagStats(t);
+}
+
+void printReport() {
+	uint32_t allocations = 0;
+	uint32_t frees = 0;
+
+	printf("{\n");
+	printf("  \"accesses\": %ld,\n", options.accesses);
+	printf("  \"warmupAccesses\": %ld,\n", options.warmup);
+	printf("  \"gapSeconds\": %u,\n", options.gap);
+	printf("  \"seconds\": %.1f,\n", report.seconds);
+	printf("  \"accessesPerSecond\": %.0f,\n", report.seconds > 0 ? options.accesses / report.seconds : 0.0);
+	printf("  \"lockOpenings\": %u,\n", report.lockOpenings);
+	printf("  \"decisions\": %u,\n", report.decisions);
+	printf("  \"storageJobs\": %u,\n", report.storageJobs);
+	printf("  \"virtualDays\": %u,\n", report.virtualDays);
+	printf("  \"tags\": {");
+	for (uint8_t t = 0; t < MemoryTagCount; t++) {
+		uint32_t a = report.after[t].allocations - report.before[t].allocations;
+		uint32_t f = report.after[t].frees - report.before[t].frees;
+		allocations += a;
+		frees += f;
+		printf("%s\n    \"%s\": {\"allocations\": %u, \"frees\": %u}", t ? "," : "", memoryTagName(t), a, f);
+	}
+	printf("},\n");
+	printf("  \"allocations\": %u,\n", allocations);
+	printf("  \"frees\": %u,\n", frees);
+	printf("  \"problem\": %s\n", report.problem ? "true" : "false");
+	printf("}\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+
+	#if !USE_MEMORY_STATS
+		fprintf(stderr, "Allocations aren't counted, build with USE_MEMORY_STATS=true.\n");
+		return 1;
+	#endif
+
+	nativehal::wipeFs();
+	nativehal::reset();
+	nativehal::setRtcEpoch(StartEpoch);
+	setup();
+
+	for (long i = 0; i < options.warmup; i++)
+		access(i);
+
+	snapshot(report.before);
+	uint32_t edges = nativehal::pinRisingEdges(LockPin);
+	uint32_t decisions = pipelineStats.decisions;
+	uint32_t stored = pipelineStats.storedJobs;
+	uint32_t epoch = nativehal::rtcEpoch();
+	Clock::time_point start = Clock::now();
+
+	for (long i = 0; i < options.accesses && CurrentState != State::Problem; i++)
+		access(options.warmup + i);
+
+	report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	snapshot(report.after);
+	report.lockOpenings = nativehal::pinRisingEdges(LockPin) - edges;
+	report.decisions = pipelineStats.decisions - decisions;
+	report.storageJobs = pipelineStats.storedJobs - stored;
+	report.virtualDays = (nativehal::rtcEpoch() - epoch) / 86400;
+	report.problem = CurrentState == State::Problem;
+	printReport();
+
+	for (uint8_t t = 0; t < MemoryTagCount; t++)
+		if (report.after[t].allocations != report.before[t].allocations)
+			return 1;
+	return report.problem ? 1 : 0;
+}
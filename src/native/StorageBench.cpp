@@ -0,0 +1,233 @@
+/**************************************************************************************
+Program :   StorageBench.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host benchmark of the storage backends : FlashMem and mSdCard on the simulated
+            board, with and without the handle cache (see HandleCache.h), and the host only
+            PosixStorage (mmap reads) and MemStorage (RAM). Times each Storage operation as
+            the firmware uses them (8 bytes registry records, 32 bytes checkpoint, log lines)
+            on files of FileLines lines or records, and prints operations per second,
+            latency percentiles, bytes moved and file opens per operation, as JSON. Then the
+            time of a journal append whose backend is reached through Storage, or directly as
+            the firmware does (see StorageController.h), over NullStorage so that only the
+            calls are timed.
+
+Usage :     program [--iterations N] [--file-latency us]
+**************************************************************************************/
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "MemStorage.h"
+#include "PosixStorage.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	long iterations = 2000;		// Calls of each operation, fewer for those that go through the whole file
+	uint32_t fileLatency = 0;	// Real time each file open takes, in us
+};
+
+/**
+ * An operation returns the bytes it moved, -1 when it failed.
+ */
+struct Operation {
+	const char* name;
+	bool wholeFile;									// Its cost grows with the file
+	std::function<long(Storage&, long)> run;
+	std::function<bool(Storage&)> before;			// Untimed, before each call, may be empty
+};
+
+Options options;
+bool firstResult = true;
+
+const size_t FileLines[] = {16, 1024, 16384};		// Lines of the text files, records of the binary one
+const char LogLine[] = "2022-06-20T12:00:00 event";	// 25 characters, 27 bytes once ended
+
+std::string_view RecordsFile = "bench.bin";
+std::string_view CheckpointFile = "bench.ckp";
+std::string_view LogFile = "bench.txt";
+std::string_view ScratchFile = "scratch.txt";
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--iterations")
+			options.iterations = atol(argv[i + 1]);
+		else if (arg == "--file-latency")
+			options.fileLatency = atol(argv[i + 1]);
+	}
+}
+
+/**
+ * An existing empty file, mSdCard::createFile() keeps the content of a file that exists.
+ */
+bool emptyFile(Storage& storage, std::string_view fileName) {
+	return storage.createFile(fileName) && storage.clearFile(fileName);
+}
+
+/**
+ * A text file of lines log lines, written with a single append.
+ */
+bool fillText(Storage& storage, std::string_view fileName, size_t lines) {
+	std::string text;
+	text.reserve(lines * (sizeof(LogLine) + 1));
+	for (size_t i = 0; i < lines; i++)
+		text.append(LogLine).append("\r\n");
+
+	return emptyFile(storage, fileName) && storage.appendBytes(fileName, (const uint8_t*)text.data(), text.size());
+}
+
+bool countLine(std::string_view line, void* context) {
+	*static_cast<long*>(context) += line.size() + 2;
+	return true;
+}
+
+/**
+ * Same access pattern as the firmware : registry records, checkpoint and log lines.
+ */
+std::vector<Operation> operations(size_t lines) {
+	static uint8_t record[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	static uint8_t checkpoint[32] = {};
+	static uint8_t buffer[8];
+
+	return {
+		{"fileExist", false, [](Storage& s, long) { return s.fileExist(LogFile) ? 0L : -1L; }, nullptr},
+		{"fileSize", false, [](Storage& s, long) { size_t size; return s.fileSize(RecordsFile, size) ? 0L : -1L; }, nullptr},
+		{"readBytes", false, [lines](Storage& s, long i) {
+			return s.readBytes(RecordsFile, (i * 7919 % lines) * 8, buffer, sizeof(buffer)) ? (long)sizeof(buffer) : -1L; }, nullptr},
+		{"forEachLine", true, [](Storage& s, long) { long bytes = 0; return s.forEachLine(LogFile, countLine, &bytes) ? bytes : -1L; }, nullptr},
+		{"appendBytes", false, [](Storage& s, long) { return s.appendBytes(RecordsFile, record, sizeof(record)) ? (long)sizeof(record) : -1L; }, nullptr},
+		{"writeBytes", false, [](Storage& s, long) { return s.writeBytes(CheckpointFile, 0, checkpoint, sizeof(checkpoint)) ? (long)sizeof(checkpoint) : -1L; }, nullptr},
+		{"addLine", false, [](Storage& s, long) { return s.addLine(LogFile, LogLine) ? (long)sizeof(LogLine) + 1 : -1L; }, nullptr},
+		{"createFile", true, [](Storage& s, long) { return s.createFile(ScratchFile) ? 0L : -1L; },
+			[lines](Storage& s) { return fillText(s, ScratchFile, lines); }},
+		{"clearFile", true, [](Storage& s, long) { return s.clearFile(ScratchFile) ? 0L : -1L; },
+			[lines](Storage& s) { return fillText(s, ScratchFile, lines); }},
+	};
+}
+
+bool prepare(Storage& storage, size_t lines) {
+	std::vector<uint8_t> records(lines * 8, 0x5a);
+
+	return storage.init()
+		&& emptyFile(storage, RecordsFile)
+		&& storage.appendBytes(RecordsFile, records.data(), records.size())
+		&& emptyFile(storage, CheckpointFile)
+		&& fillText(storage, LogFile, lines);
+}
+
+void run(const char* backend, Storage& storage, size_t cachedHandles, size_t lines) {
+	if (!prepare(storage, lines)) {
+		fprintf(stderr, "%s : couldn't prepare the files.\n", backend);
+		exit(1);
+	}
+
+	for (const Operation& op : operations(lines)) {
+		long count = options.iterations;
+		if (op.wholeFile)
+			count = std::max(5L, std::min(count, (long)(options.iterations * 64 / lines)));
+
+		std::vector<double> samples;
+		samples.reserve(count);
+		uint64_t opens = 0, bytes = 0;
+		long failures = 0;
+
+		for (long i = 0; i < count; i++) {
+			if (op.before && !op.before(storage))
+				failures++;
+
+			uint64_t opensBefore = nativehal::counters().fileOpens;
+			Clock::time_point t = Clock::now();
+			long moved = op.run(storage, i);
+			samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+			opens += nativehal::counters().fileOpens - opensBefore;
+
+			if (moved < 0)
+				failures++;
+			else
+				bytes += moved;
+		}
+
+		std::sort(samples.begin(), samples.end());
+		double mean = 0;
+		for (double us : samples)
+			mean += us / samples.size();
+
+		printf("%s    {\"backend\": \"%s\", \"cachedHandles\": %zu, \"lines\": %zu, \"op\": \"%s\", \"samples\": %ld, "
+			"\"opsPerSecond\": %.0f, \"meanMicros\": %.2f, \"p50Micros\": %.2f, \"p99Micros\": %.2f, "
+			"\"bytesPerOp\": %.0f, \"opensPerOp\": %.3f, \"failures\": %ld}",
+			firstResult ? "" : ",\n", backend, cachedHandles, lines, op.name, count,
+			mean > 0 ? 1e6 / mean : 0.0, mean, samples[samples.size() / 2], samples[std::min(samples.size() - 1, samples.size() * 99 / 100)],
+			(double)bytes / count, (double)opens / count, failures);
+		firstResult = false;
+	}
+}
+
+/**
+ * Mean time of a write through append, the clock is read once for all the calls.
+ */
+template<typename Backend>
+double nanosPerAppend(JournaledStorage<Backend>& journal, long calls) {
+	static const uint8_t record[8] = {};
+	Clock::time_point t = Clock::now();
+	for (long i = 0; i < calls; i++)
+		journal.appendBytes(RecordsFile, record, sizeof(record));
+	return std::chrono::duration<double, std::nano>(Clock::now() - t).count() / calls;
+}
+
+void runDispatch() {
+	const long calls = options.iterations * 1000;
+	NullStorage backend;
+	JournaledStorage<> throughStorage(&backend);
+	JournaledStorage<NullStorage> direct(&backend);
+
+	nanosPerAppend(throughStorage, calls);		// Warm-up
+	printf("  \"dispatch\": {\"calls\": %ld, \"throughStorageNanos\": %.2f, \"directNanos\": %.2f}\n",
+		calls, nanosPerAppend(throughStorage, calls), nanosPerAppend(direct, calls));
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+	if (options.iterations < 1)
+		options.iterations = 1;
+
+	nativehal::wipeFs();
+	nativehal::reset();
+	nativehal::setFileLatency(options.fileLatency);
+
+	printf("{\n");
+	printf("  \"iterations\": %ld,\n", options.iterations);
+	printf("  \"fileLatencyMicros\": %u,\n", options.fileLatency);
+	printf("  \"results\": [\n");
+
+	for (size_t lines : FileLines) {
+		for (size_t cachedHandles : {(size_t)0, (size_t)HANDLE_CACHE_SIZE}) {
+			FlashMem flash(cachedHandles);
+			run("FlashMem", flash, cachedHandles, lines);
+
+			mSdCard sdCard(cachedHandles);
+			run("mSdCard", sdCard, cachedHandles, lines);
+
+			PosixStorage posix(nativehal::fsRoot() + "/posix", cachedHandles);
+			run("PosixStorage", posix, cachedHandles, lines);
+		}
+
+		MemStorage memory;
+		run("MemStorage", memory, 0, lines);
+	}
+
+	printf("\n  ],\n");
+	runDispatch();
+	printf("}\n");
+	return 0;
+}
@@ -0,0 +1,763 @@
+/**************************************************************************************
+Program :   TimeWarp.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Deterministic time-warp simulator of the access controller. Years of accesses by
+            the users of SimUsers.hpp go through the unchanged setup()/loop(), while the RTC
+            is set forward and back, the board reboots, the power goes in the middle of a
+            write and writes fail. Each boot is a child process that starts from the files
+            the previous one left behind. The parent keeps a plain reference model of the
+            quotas and prints a JSON report : decisions that differ from the model, decision
+            rate, registry growth, archive size and boot time against the records to replay.
+            The same seed always plays the same events.
+
+Usage :     program [--years N] [--seed N] [--rate-scale x] [--jumps per-day] [--reboots per-day]
+                    [--power-cuts p] [--cut-bytes N] [--failures p] [--rtc-drift ppm]
+                    [--checkpoint 0|1]
+**************************************************************************************/
+#include <Arduino.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "../RegistryFormat.h"
+#include "../Archive.h"
+#include "../ClockService.h"
+#include "../SpscQueue.h"
+#include "../Pipeline.h"
+
+void setup();
+void loop();
+
+extern RtbStorage rtbStorage;
+extern int CurrentState;
+extern size_t registrySlot;
+extern size_t registryCount;
+extern uint32_t lastActivation;
+extern ClockService rtcClock;
+extern SpscQueue<CodeEvent, CODE_QUEUE_SIZE> codeQueue;
+extern PipelineStats pipelineStats;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Accesses per day of each user of SimUsers.hpp, same order
+const double AccessesPerDay[] = {0.3, 0.4, 0.5, 0.4, 1.5, 60, 0.2};
+const double WrongCodesPerDay = 1;
+const char WrongCode[] = "3213213";
+const uint32_t StartEpoch = 1640995200;		// 2022-01-01T00:00:00
+const uint32_t MinAccessGap = 5;			// Seconds between two accesses, at least
+const size_t StuckBoots = 20;				// Boots in a row that end setup() in State::Problem, before giving up
+const size_t ShownDivergences = 10;
+
+static_assert(sizeof(AccessesPerDay) / sizeof(AccessesPerDay[0]) == UserCount, "One rate per simulated user");
+
+struct Options {
+	double years = 5;
+	uint64_t seed = 1;
+	double rateScale = 1;		// Multiplies every access rate
+	double jumps = 0.01;		// RTC set forward or back, per day
+	double reboots = 0.03;		// Planned reboots, per day
+	double powerCuts = 0.003;	// Probability an access has the power cut during its writes
+	double failures = 0.001;	// Probability the first write of an access fails
+	uint32_t cutBytes = 400;	// The power cut comes after 0 to this many bytes, a record and a checkpoint are about 400
+	int32_t rtcDrift = 0;		// How much faster the RTC runs than the virtual clock, in ppm
+	bool checkpoint = true;		// False : the checkpoint is deleted before each boot, which replays the whole registry
+};
+
+enum EventType : uint8_t { EventAccess, EventJump, EventReboot };
+enum Fault : uint8_t { FaultNone, FaultPowerCut, FaultWrite };
+
+struct Event {
+	uint8_t type;				// See EventType
+	uint8_t fault;				// Access : see Fault
+	int8_t user;				// Access : index in UsersPrep, -1 for a wrong code
+	uint16_t cutAfter;			// FaultPowerCut : bytes written before the power goes
+	uint32_t epoch;				// Access : RTC time it is typed at
+	int32_t shift;				// Jump : seconds the RTC is set forward (back if negative)
+};
+
+/**
+ * Child to parent messages, written at once on a pipe (smaller than PIPE_BUF).
+ */
+enum MessageType : uint8_t { MessageBoot, MessageDecision, MessagePowerCut, MessageEnd };
+
+struct Message {
+	uint8_t type;				// See MessageType
+	bool opened;				// Decision : the lock opened...
+	bool spent;					// ... a token has been spent...
+	bool problem;				// ... the RTB is in State::Problem (Boot : after setup())
+	int8_t persisted;			// Boot : the uncertain record is in the registry (1) or not (0), -1 without one
+	uint32_t index;				// Decision, power cut : event. End : next event to play
+	uint32_t epoch;				// RTC time
+	int64_t records;			// Boot, End : registry records counted by the firmware
+	int64_t fileRecords;		// End : records in the registry file, -1 if it isn't valid
+	uint32_t archiveSegments;	// End : months in the archive...
+	uint64_t archiveRecords;	// ... their records...
+	uint64_t archiveBytes;		// ... and the size of the file
+	uint64_t bytes;				// Boot : read by setup(). Decision : written
+	double micros;				// Boot : setup() time. Decision : loop() time until it is stored
+};
+
+/**
+ * Boots grouped by the number of registry records found, see BootBuckets.
+ */
+struct BootBucket {
+	uint32_t boots = 0;
+	double micros = 0;
+	uint64_t bytesRead = 0;
+	uint64_t maxBytesRead = 0;
+};
+
+const size_t BootBuckets[] = {0, 100, 200, 400, 700, 1000};
+const size_t BootBucketCount = sizeof(BootBuckets) / sizeof(BootBuckets[0]);
+
+struct Divergence {
+	uint32_t event;
+	uint32_t epoch;
+	int8_t user;
+	bool expectedOpen, opened, expectedSpent, spent;
+	uint32_t boot;
+};
+
+struct Report {
+	uint32_t events = 0;
+	uint32_t decisions = 0;
+	uint32_t opens = 0;
+	uint32_t spends = 0;
+	uint32_t boots = 0;
+	uint32_t powerCuts = 0;
+	uint32_t writeFailures = 0;
+	uint32_t clockJumps = 0;
+	uint32_t monthRollovers = 0;
+	uint32_t yearRollovers = 0;
+	uint32_t lostRecords = 0;			// Spent in memory, missing from the registry after the reboot
+	uint32_t divergences = 0;
+	uint32_t divergencesByUser[UserCount] = {};
+	std::vector<Divergence> shown;
+	uint32_t registryMismatches = 0;	// Boots that ended with another number of records than the model
+	uint32_t problemBoots = 0;
+	uint32_t problemDecisions = 0;
+	bool stuck = false;					// Stopped, the RTB stayed in State::Problem
+	double decisionMicros = 0;
+	uint64_t bytesWritten = 0;
+	size_t registryPeakRecords = 0;
+	uint64_t monthRecords = 0;			// Records of the months that ended, for the mean
+	uint32_t archiveSegments = 0;		// Archive left by the last boot
+	uint64_t archiveRecords = 0;
+	uint64_t archiveBytes = 0;
+	BootBucket bootBuckets[BootBucketCount];
+	double wallSeconds = 0;
+};
+
+Options options;
+Report report;
+std::vector<Event> events;
+
+// Access whose writes may not all have reached the file system (power cut or write failure)
+int64_t uncertainIndex = -1;
+uint32_t uncertainEpoch = 0;
+
+double elapsedMicros(Clock::time_point since) {
+	return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+/**
+ * Month id computed again with DateTime, the model doesn't share code with QuotaPolicy.cpp.
+ */
+uint32_t monthOf(uint32_t epoch) {
+	DateTime date(epoch);
+	return date.year() * 12U + date.month() - 1;
+}
+
+uint32_t monthStart(uint32_t month) {
+	return DateTime(month / 12, month % 12 + 1, 1).unixtime();
+}
+
+/**************************************************************************************
+	Events
+**************************************************************************************/
+
+/**
+ * Plays the calendar : accesses come at random, jumps and reboots fall between them.
+ * Jumps back stay in the month, the registry is never older than the RTC month.
+ */
+void generateEvents() {
+	std::mt19937_64 rng(options.seed);
+	std::uniform_real_distribution<double> uniform(0, 1);
+
+	double perDay = WrongCodesPerDay;
+	for (size_t u = 0; u < UserCount; u++)
+		perDay += AccessesPerDay[u] * options.rateScale;
+	std::exponential_distribution<double> gaps(perDay / 86400);
+
+	double duration = options.years * 365.25 * 86400;
+	double elapsed = 0;
+	int64_t offset = 0;					// RTC time minus real time
+
+	for (;;) {
+		double gap = MinAccessGap + gaps(rng);
+		elapsed += gap;
+		if (elapsed > duration)
+			break;
+
+		uint32_t now = StartEpoch + (int64_t)elapsed + offset;
+
+		if (uniform(rng) < gap * options.jumps / 86400) {
+			Event e = {};
+			e.type = EventJump;
+			e.shift = uniform(rng) < 0.7 ? 3600 + (int32_t)(uniform(rng) * 39 * 86400) : -(60 + (int32_t)(uniform(rng) * 3540));
+			if (e.shift < 0 && monthOf(now + e.shift) != monthOf(now))
+				e.shift = -e.shift;
+			offset += e.shift;
+			now += e.shift;
+			events.push_back(e);
+		}
+
+		if (uniform(rng) < gap * options.reboots / 86400) {
+			Event e = {};
+			e.type = EventReboot;
+			events.push_back(e);
+		}
+
+		Event e = {};
+		e.type = EventAccess;
+		e.epoch = now;
+		e.user = -1;
+		double pick = uniform(rng) * perDay - WrongCodesPerDay;
+		for (size_t u = 0; u < UserCount && pick >= 0; u++) {
+			e.user = u;
+			pick -= AccessesPerDay[u] * options.rateScale;
+		}
+
+		double fault = uniform(rng);
+		if (fault < options.powerCuts) {
+			e.fault = FaultPowerCut;
+			e.cutAfter = uniform(rng) * options.cutBytes;
+		}
+		else if (fault < options.powerCuts + options.failures)
+			e.fault = FaultWrite;
+
+		events.push_back(e);
+	}
+}
+
+/**************************************************************************************
+	Reference model : every access kept, quotas counted again at each decision
+**************************************************************************************/
+
+struct Model {
+	std::vector<uint32_t> spends[UserCount];		// In the order they happened
+	std::vector<std::pair<int, uint32_t>> registry;
+	uint32_t registryMonth = 0;
+	uint32_t activatedUntil = 0;
+
+	uint32_t activation(int u) const {
+		uint32_t seconds = UsersPrep[u].quota.activatedSeconds;
+		return seconds ? seconds : ActivatedTime.totalseconds();
+	}
+
+	bool inWindow(int u, uint32_t now) const {
+		const QuotaConfig& q = UsersPrep[u].quota;
+		uint32_t hour = now % 86400 / 3600;
+		if (q.fromHour == q.toHour)
+			return true;
+		if (q.fromHour < q.toHour)
+			return hour >= q.fromHour && hour < q.toHour;
+		return hour >= q.fromHour || hour < q.toHour;
+	}
+
+	/**
+	 * Accesses are almost in time order : the RTC only goes back by an hour at most,
+	 * so the scans stop a little past the window.
+	 */
+	bool allows(int u, uint32_t now) const {
+		const QuotaConfig& q = UsersPrep[u].quota;
+		const std::vector<uint32_t>& s = spends[u];
+		int tokens = UsersPrep[u].tokens;
+		int used = 0;
+
+		switch (q.kind) {
+			case QuotaMonthly: {
+				uint32_t month = monthOf(now), from = monthStart(month);
+				for (size_t k = s.size(); k-- > 0 && s[k] + 7200 >= from;)
+					used += monthOf(s[k]) == month;
+				return used < tokens;
+			}
+			case QuotaRolling:
+				for (size_t k = s.size(); k-- > 0 && s[k] + q.period + 7200 > now;)
+					used += s[k] + q.period > now;
+				return used < tokens;
+			default: {
+				// One token back every period, counted from the access that found the bucket full
+				uint32_t next = 0;
+				for (uint32_t t : s) {
+					while (used > 0 && t >= next) {
+						used--;
+						next += q.period;
+					}
+					if (used == 0)
+						next = t + q.period;
+					used++;
+				}
+				while (used > 0 && now >= next) {
+					used--;
+					next += q.period;
+				}
+				return used < tokens;
+			}
+		}
+	}
+
+	/**
+	 * What the firmware should decide, then the model follows what it did decide,
+	 * so that one difference doesn't make every later decision differ.
+	 */
+	void access(int u, uint32_t now, bool spent, bool& expectedOpen, bool& expectedSpent) {
+		bool activated = !registry.empty() && now <= activatedUntil;
+
+		if (!activated && !registry.empty() && monthOf(now) > registryMonth) {
+			report.monthRollovers++;
+			report.yearRollovers += monthOf(now) / 12 != registryMonth / 12;
+			report.monthRecords += registry.size();
+			registry.clear();
+			registryMonth = monthOf(now);
+		}
+
+		expectedOpen = inWindow(u, now) && (allows(u, now) || activated);
+		expectedSpent = expectedOpen && !activated;
+
+		if (spent) {
+			spends[u].push_back(now);
+			registry.push_back({u, now});
+			if (monthOf(now) > registryMonth)
+				registryMonth = monthOf(now);
+			activatedUntil = now + activation(u);
+			if (registry.size() > report.registryPeakRecords)
+				report.registryPeakRecords = registry.size();
+		}
+	}
+
+	/**
+	 * The record of the newest access didn't reach the registry.
+	 */
+	void forgetLast() {
+		int u = registry.back().first;
+		registry.pop_back();
+		spends[u].pop_back();
+		if (!registry.empty())
+			activatedUntil = registry.back().second + activation(registry.back().first);
+	}
+};
+
+Model model;
+
+/**************************************************************************************
+	Child : one boot of the firmware
+**************************************************************************************/
+
+int channel = -1;
+
+// Access being decided, the power cut handler reports it
+struct {
+	uint32_t index;
+	uint32_t epoch;
+	uint32_t edges;
+	uint32_t lastActivation;
+	uint64_t bytesWritten;
+	Clock::time_point start;
+} pending;
+
+void send(const Message& m) {
+	if (write(channel, &m, sizeof(m)) != sizeof(m))
+		_exit(2);
+}
+
+Message decision() {
+	Message m = {};
+	m.type = MessageDecision;
+	m.index = pending.index;
+	m.opened = nativehal::pinRisingEdges(LockPin) != pending.edges;
+	m.spent = lastActivation != pending.lastActivation;
+	m.epoch = m.spent ? lastActivation : pending.epoch;		// Time of the record, the firmware's clock may be a second off after a boot
+	m.problem = CurrentState == State::Problem;
+	m.bytes = nativehal::counters().bytesWritten - pending.bytesWritten;
+	m.micros = elapsedMicros(pending.start);
+	return m;
+}
+
+/**
+ * Called by the file system in the middle of a write : what has been written stays, nothing else.
+ */
+void onPowerCut() {
+	send(decision());
+
+	Message m = {};
+	m.type = MessagePowerCut;
+	m.index = pending.index;
+	m.epoch = nativehal::rtcEpoch();
+	send(m);
+	_exit(0);
+}
+
+/**
+ * Whether the newest registry record is the one of the uncertain access.
+ */
+int8_t uncertainPersisted() {
+	if (uncertainIndex < 0)
+		return -1;
+
+	size_t count;
+	RegistryRecord last;
+	std::string_view registry = RegistrySlots[registrySlot];
+	if (!registryRecordCount(rtbStorage.usage(), registry, count) || count == 0 || !readRecords(rtbStorage.usage(), registry, count - 1, &last, 1))
+		return 0;
+
+	const Event& e = events[uncertainIndex];
+	return last.isValid() && last.epoch == uncertainEpoch && last.user == (uint8_t)UsersPrep[e.user].username;
+}
+
+bool countSegment(const ArchiveSegment& segment, void* context) {
+	Message& m = *static_cast<Message*>(context);
+	m.archiveSegments++;
+	m.archiveRecords += segment.header.records;
+	m.archiveBytes = segment.end();
+	return true;
+}
+
+[[noreturn]] void endBoot(size_t next) {
+	Message m = {};
+	m.type = MessageEnd;
+	m.index = next;
+	m.epoch = nativehal::rtcEpoch();
+	m.records = registryCount;
+	size_t count;
+	m.fileRecords = registryRecordCount(rtbStorage.usage(), RegistrySlots[registrySlot], count) ? (int64_t)count : -1;
+	forEachSegment(rtbStorage.archive(), RegistryArchive, countSegment, &m);
+	send(m);
+	_exit(0);
+}
+
+/**
+ * Boots, then plays the events from first on, until a reboot, a power cut or State::Problem.
+ */
+[[noreturn]] void runBoot(size_t first) {
+	Clock::time_point start = Clock::now();
+	setup();
+
+	Message boot = {};
+	boot.type = MessageBoot;
+	boot.micros = elapsedMicros(start);
+	boot.records = registryCount;
+	boot.bytes = nativehal::counters().bytesRead;
+	boot.problem = CurrentState == State::Problem;
+	boot.persisted = uncertainPersisted();
+	send(boot);
+
+	for (size_t i = first; i < events.size(); i++) {
+		const Event& e = events[i];
+
+		if (e.type == EventReboot)
+			endBoot(i + 1);
+
+		if (e.type == EventJump) {
+			nativehal::shiftRtc(e.shift);
+			rtcClock.requestResync();		// As setRTCtime() does
+			continue;
+		}
+
+		// Typed in the middle of its second, a drift free clock can't be off by one. Events
+		// that fell during the downtime come a few seconds apart, once the lock closed again
+		int64_t wait = e.epoch * 1000000LL + 500000 - (int64_t)nativehal::rtcEpochMicros();
+		nativehal::warpMicros(wait > MinAccessGap * 1000000LL ? wait : MinAccessGap * 1000000LL);
+
+		const char* code = e.user >= 0 ? UsersPrep[e.user].password : WrongCode;
+		CodeEvent event = {};
+		event.length = strlen(code);
+		memcpy(event.code, code, event.length);
+		event.at = micros();
+
+		pending.index = i;
+		pending.epoch = nativehal::rtcEpoch();
+		pending.edges = nativehal::pinRisingEdges(LockPin);
+		pending.lastActivation = lastActivation;
+		pending.bytesWritten = nativehal::counters().bytesWritten;
+
+		if (e.fault == FaultPowerCut)
+			nativehal::setPowerCut(e.cutAfter, onPowerCut);
+		else if (e.fault == FaultWrite)
+			nativehal::setWriteFailures(1);
+
+		pending.start = Clock::now();
+		codeQueue.push(event);
+		do
+			loop();
+		while (!codeQueue.empty() || pipelineStats.storedJobs != pipelineStats.storageJobs);
+
+		nativehal::setPowerCut(0, nullptr);
+		nativehal::setWriteFailures(0);
+
+		Message m = decision();
+		send(m);
+		if (m.problem)
+			endBoot(i + 1);
+	}
+
+	endBoot(events.size());
+}
+
+/**************************************************************************************
+	Parent
+**************************************************************************************/
+
+bool receive(int fd, Message& m) {
+	size_t got = 0;
+	while (got < sizeof(m)) {
+		ssize_t n = read(fd, reinterpret_cast<char*>(&m) + got, sizeof(m) - got);
+		if (n <= 0)
+			return false;
+		got += n;
+	}
+	return true;
+}
+
+void onBoot(const Message& m) {
+	if (m.problem)
+		report.problemBoots++;
+
+	size_t b = BootBucketCount - 1;
+	while (b > 0 && (size_t)m.records < BootBuckets[b])
+		b--;
+	BootBucket& bucket = report.bootBuckets[b];
+	bucket.boots++;
+	bucket.micros += m.micros;
+	bucket.bytesRead += m.bytes;
+	if (m.bytes > bucket.maxBytesRead)
+		bucket.maxBytesRead = m.bytes;
+
+	if (m.persisted == 0) {
+		report.lostRecords++;
+		model.forgetLast();
+	}
+	uncertainIndex = -1;
+}
+
+void onDecision(const Message& m) {
+	const Event& e = events[m.index];
+	report.decisions++;
+	report.decisionMicros += m.micros;
+	report.bytesWritten += m.bytes;
+	report.opens += m.opened;
+	report.spends += m.spent;
+
+	// State::Problem opens the lock on its own, there is nothing to compare. A token may
+	// still have been spent if the failure happened while its record was being written
+	if (m.problem)
+		report.problemDecisions++;
+	if (m.problem && !m.spent)
+		return;
+
+	bool expectedOpen = false, expectedSpent = false;
+	if (e.user >= 0)
+		model.access(e.user, m.epoch, m.spent, expectedOpen, expectedSpent);
+
+	if (m.spent && e.fault == FaultWrite) {
+		report.writeFailures++;
+		uncertainIndex = m.index;
+		uncertainEpoch = m.epoch;
+	}
+
+	if (!m.problem && (expectedOpen != m.opened || expectedSpent != m.spent)) {
+		report.divergences++;
+		if (e.user >= 0)
+			report.divergencesByUser[e.user]++;
+		if (report.shown.size() < ShownDivergences)
+			report.shown.push_back({m.index, m.epoch, e.user, expectedOpen, m.opened, expectedSpent, m.spent, report.boots});
+	}
+}
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string arg = argv[i];
+		if (arg == "--years")
+			options.years = atof(argv[i + 1]);
+		else if (arg == "--seed")
+			options.seed = strtoull(argv[i + 1], nullptr, 10);
+		else if (arg == "--rate-scale")
+			options.rateScale = atof(argv[i + 1]);
+		else if (arg == "--jumps")
+			options.jumps = atof(argv[i + 1]);
+		else if (arg == "--reboots")
+			options.reboots = atof(argv[i + 1]);
+		else if (arg == "--power-cuts")
+			options.powerCuts = atof(argv[i + 1]);
+		else if (arg == "--failures")
+			options.failures = atof(argv[i + 1]);
+		else if (arg == "--cut-bytes")
+			options.cutBytes = atol(argv[i + 1]);
+		else if (arg == "--checkpoint")
+			options.checkpoint = atoi(argv[i + 1]) != 0;
+		else if (arg == "--rtc-drift")
+			options.rtcDrift = atol(argv[i + 1]);
+	}
+}
+
+void printReport() {
+	double days = options.years * 365.25;
+
+	printf("{\n");
+	printf("  \"years\": %.2f, \"seed\": %llu, \"events\": %u, \"boots\": %u,\n", options.years,
+		(unsigned long long)options.seed, report.events, report.boots);
+	printf("  \"decisions\": %u, \"opens\": %u, \"spends\": %u,\n", report.decisions, report.opens, report.spends);
+	printf("  \"clockJumps\": %u, \"monthRollovers\": %u, \"yearRollovers\": %u,\n", report.clockJumps,
+		report.monthRollovers, report.yearRollovers);
+	printf("  \"powerCuts\": %u, \"writeFailures\": %u, \"lostRecords\": %u, \"problemBoots\": %u, \"problemDecisions\": %u, \"stuck\": %s,\n",
+		report.powerCuts, report.writeFailures, report.lostRecords, report.problemBoots, report.problemDecisions,
+		report.stuck ? "true" : "false");
+	printf("  \"divergences\": %u, \"registryMismatches\": %u,\n", report.divergences, report.registryMismatches);
+
+	printf("  \"divergencesByUser\": {");
+	for (size_t u = 0; u < UserCount; u++)
+		printf("%s\"%c\": %u", u ? ", " : "", UsersPrep[u].username, report.divergencesByUser[u]);
+	printf("},\n");
+
+	printf("  \"firstDivergences\": [");
+	for (size_t k = 0; k < report.shown.size(); k++) {
+		const Divergence& d = report.shown[k];
+		printf("%s\n    {\"event\": %u, \"date\": \"%s\", \"user\": \"%c\", \"boot\": %u, \"expectedOpen\": %s, \"opened\": %s, "
+			"\"expectedSpent\": %s, \"spent\": %s}", k ? "," : "", d.event, DateTime(d.epoch).timestamp().c_str(),
+			d.user >= 0 ? UsersPrep[d.user].username : '?', d.boot, d.expectedOpen ? "true" : "false",
+			d.opened ? "true" : "false", d.expectedSpent ? "true" : "false", d.spent ? "true" : "false");
+	}
+	printf("%s],\n", report.shown.empty() ? "" : "\n  ");
+
+	printf("  \"decisionsPerSecond\": %.0f, \"decisionsPerDay\": %.1f, \"bytesWrittenPerDecision\": %.1f,\n",
+		report.decisionMicros > 0 ? report.decisions / report.decisionMicros * 1e6 : 0.0, report.decisions / days,
+		report.decisions ? (double)report.bytesWritten / report.decisions : 0.0);
+	printf("  \"registryPeakRecords\": %zu, \"registryPeakBytes\": %zu, \"registryRecordsPerMonth\": %.1f,\n",
+		report.registryPeakRecords, sizeof(RegistryHeader) + report.registryPeakRecords * sizeof(RegistryRecord),
+		report.monthRollovers ? (double)report.monthRecords / report.monthRollovers : 0.0);
+	printf("  \"archiveSegments\": %u, \"archivedRecords\": %llu, \"endedMonthRecords\": %llu, \"archiveBytes\": %llu, \"archiveBytesPerRecord\": %.2f,\n",
+		report.archiveSegments, (unsigned long long)report.archiveRecords, (unsigned long long)report.monthRecords,
+		(unsigned long long)report.archiveBytes, report.archiveRecords ? (double)report.archiveBytes / report.archiveRecords : 0.0);
+
+	printf("  \"bootReplay\": [");
+	for (size_t b = 0; b < BootBucketCount; b++) {
+		const BootBucket& k = report.bootBuckets[b];
+		printf("%s\n    {\"fromRecords\": %zu, \"boots\": %u, \"meanSetupMicros\": %.1f, \"meanBytesRead\": %.0f, \"maxBytesRead\": %llu}",
+			b ? "," : "", BootBuckets[b], k.boots, k.boots ? k.micros / k.boots : 0.0,
+			k.boots ? (double)k.bytesRead / k.boots : 0.0, (unsigned long long)k.maxBytesRead);
+	}
+	printf("\n  ],\n");
+	printf("  \"wallSeconds\": %.2f\n", report.wallSeconds);
+	printf("}\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+	generateEvents();
+	report.events = events.size();
+
+	Clock::time_point start = Clock::now();
+	std::mt19937_64 downtimes(options.seed + 1);
+	std::uniform_int_distribution<uint32_t> downtime(10, 600);
+
+	nativehal::wipeFs();
+	uint32_t resume = StartEpoch;
+	size_t next = 0, problemBoots = 0;
+
+	while (next < events.size()) {
+		nativehal::reset();
+		nativehal::setRtcEpoch(resume);
+		nativehal::setRtcDrift(options.rtcDrift);
+		if (!options.checkpoint)
+			remove(nativehal::hostPath("littlefs", std::string(UsageCheckpoint).c_str()).c_str());
+
+		int fds[2];
+		if (pipe(fds) != 0) {
+			perror("pipe");
+			return 1;
+		}
+
+		fflush(stdout);
+		pid_t child = fork();
+		if (child == 0) {
+			close(fds[0]);
+			channel = fds[1];
+			runBoot(next);
+		}
+		close(fds[1]);
+		report.boots++;
+
+		bool ended = false, problem = false;
+		uint32_t epoch = resume;
+		Message m, last = {};
+		while (!ended && receive(fds[0], m)) {
+			switch (m.type) {
+				case MessageBoot:
+					onBoot(m);
+					problem = m.problem;
+					break;
+
+				case MessageDecision:
+					onDecision(m);
+					next = m.index + 1;
+					last = m;
+					break;
+
+				case MessagePowerCut:
+					// Sent right after the decision of the access whose writes were cut
+					report.powerCuts++;
+					if (last.spent) {
+						uncertainIndex = last.index;
+						uncertainEpoch = last.epoch;
+					}
+					epoch = m.epoch;
+					ended = true;
+					break;
+
+				case MessageEnd:
+					next = m.index;
+					epoch = m.epoch;
+					report.archiveSegments = m.archiveSegments;
+					report.archiveRecords = m.archiveRecords;
+					report.archiveBytes = m.archiveBytes;
+					if (uncertainIndex < 0 && (m.fileRecords != (int64_t)model.registry.size() || m.records != (int64_t)model.registry.size()))
+						report.registryMismatches++;
+					ended = true;
+					break;
+			}
+		}
+		close(fds[0]);
+
+		int status;
+		waitpid(child, &status, 0);
+		if (!ended || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "Boot %u ended without a report (status %d)\n", report.boots, status);
+			return 1;
+		}
+
+		problemBoots = problem ? problemBoots + 1 : 0;
+		if (problemBoots >= StuckBoots) {
+			report.stuck = true;
+			break;
+		}
+		resume = epoch + downtime(downtimes);
+	}
+
+	for (const Event& e : events)
+		report.clockJumps += e.type == EventJump;
+	report.wallSeconds = elapsedMicros(start) / 1e6;
+
+	printReport();
+	return 0;
+}
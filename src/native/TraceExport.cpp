@@ -0,0 +1,412 @@
+/**************************************************************************************
+Program :   TraceExport.cpp
+Author :    Loïc Bouillon
+Date :      17/10/2026
+Purpose :   Host decoder of the tracepoints (see Trace.h). Reads the binary frames the "trace"
+            serial command sends, from a capture of the serial port (text around them is
+            skipped), and writes them as a Chrome trace (chrome://tracing, ui.perfetto.dev),
+            with the histograms of each point printed on stderr.
+            With --run, boots the firmware on the simulated board, types codes on its keypad
+            and decodes its export instead. With --overhead, times the tracepoints themselves.
+
+Usage :     program [--in capture.bin] [--out trace.json]
+            program --run N [--out trace.json]
+            program --overhead N
+            --in defaults to stdin, --out to stdout.
+**************************************************************************************/
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../StorageManagement.h"
+#include "../Checksum.h"
+#include "../Trace.h"
+
+void setup();
+void loop();
+
+extern int CurrentState;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+	std::string in;					// Capture of the serial port, stdin if empty
+	std::string out;				// Chrome trace, stdout if empty
+	long run = 0;					// Codes typed on the simulated board, 0 to read a capture
+	long overhead = 0;				// Tracepoints timed, 0 not to
+};
+
+/**
+ * A decoded event, its start unwrapped to 64 bits.
+ */
+struct Span {
+	uint8_t core;
+	uint8_t point;
+	uint64_t start;
+	uint32_t cycles;
+	uint32_t arg;
+};
+
+struct Histogram {
+	uint64_t count = 0;
+	uint32_t max = 0;
+	uint64_t buckets[TRACE_BUCKETS] = {};
+};
+
+/**
+ * Frames of a capture, see TraceFrameType.
+ */
+struct Capture {
+	uint32_t cpuMHz = 0;
+	std::vector<std::string> names;
+	std::vector<Span> spans;
+	std::vector<Histogram> histograms[TRACE_CORES];	// Per point, since boot : the newest export replaces the previous ones
+	uint64_t lost = 0;
+	uint32_t frames = 0;
+	uint32_t badFrames = 0;					// Sync byte found, CRC wrong : noise, or text that looked like a frame
+	bool ended = false;
+	uint64_t last[TRACE_CORES] = {};		// Newest start of each core, to unwrap the 32 bits counter
+	bool started[TRACE_CORES] = {};
+};
+
+/**
+ * Payload of a frame, read as it was written by TraceFrame.
+ */
+class Reader {
+private:
+	const uint8_t* _data;
+	size_t _length;
+	size_t _at = 0;
+
+public:
+	Reader(const uint8_t* data, size_t length) : _data(data), _length(length) {}
+
+	bool more() const { return _at < _length; }
+
+	uint8_t byte() { return _at < _length ? _data[_at++] : 0; }
+
+	uint32_t varint() {
+		uint32_t v = 0;
+		for (int shift = 0; shift < 35 && more(); shift += 7) {
+			uint8_t b = byte();
+			v |= (uint32_t)(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				break;
+		}
+		return v;
+	}
+
+	int32_t signedVarint() {
+		uint32_t v = varint();
+		return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+	}
+
+	std::string rest() { return std::string((const char*)_data + _at, _length - _at); }
+};
+
+Options options;
+
+void parseArguments(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--in" && i + 1 < argc)
+			options.in = argv[++i];
+		else if (arg == "--out" && i + 1 < argc)
+			options.out = argv[++i];
+		else if (arg == "--run" && i + 1 < argc)
+			options.run = atol(argv[++i]);
+		else if (arg == "--overhead" && i + 1 < argc)
+			options.overhead = atol(argv[++i]);
+		else {
+			fprintf(stderr, "Unknown argument %s\n", argv[i]);
+			exit(1);
+		}
+	}
+}
+
+void decodeFrame(Capture& c, uint8_t type, Reader r) {
+	switch (type) {
+		case TraceFrameInfo: {
+			r.byte();
+			c.cpuMHz = r.varint();
+			uint8_t points = r.byte();
+			c.names.resize(points);
+			break;
+		}
+		case TraceFramePoint: {
+			uint8_t p = r.byte();
+			if (p < c.names.size())
+				c.names[p] = r.rest();
+			break;
+		}
+		case TraceFrameEvents: {
+			uint8_t core = r.byte() % TRACE_CORES;
+			uint32_t previous = 0;
+			c.lost += r.varint();
+			while (r.more()) {
+				Span s;
+				s.core = core;
+				s.point = r.byte();
+				uint32_t start = previous + (uint32_t)r.signedVarint();
+				s.cycles = r.varint();
+				s.arg = r.varint();
+				previous = start;
+
+				// Events of a core are close in time, a start far behind the previous one is a wrap of the counter
+				s.start = c.started[core] ? c.last[core] + (int64_t)(int32_t)(start - (uint32_t)c.last[core]) : start;
+				c.last[core] = s.start;
+				c.started[core] = true;
+				c.spans.push_back(s);
+			}
+			break;
+		}
+		case TraceFrameHistogram: {
+			std::vector<Histogram>& histograms = c.histograms[r.byte() % TRACE_CORES];
+			uint8_t p = r.byte();
+			if (p >= histograms.size())
+				histograms.resize(p + 1);
+			Histogram& h = histograms[p];
+			h = Histogram();
+			h.count = r.varint();
+			h.max = r.varint();
+			while (r.more()) {
+				uint8_t b = r.byte();
+				uint32_t n = r.varint();
+				if (b < TRACE_BUCKETS)
+					h.buckets[b] += n;
+			}
+			break;
+		}
+		case TraceFrameEnd:
+			c.ended = true;
+			break;
+	}
+}
+
+/**
+ * Finds the frames among the bytes received, checked by their CRC.
+ */
+void decode(Capture& c, const std::vector<uint8_t>& bytes) {
+	size_t i = 0;
+	while (i + 7 <= bytes.size()) {
+		if (bytes[i] != TRACE_SYNC) {
+			i++;
+			continue;
+		}
+
+		size_t length = bytes[i + 2];
+		if (i + 3 + length + 4 > bytes.size()) {
+			i++;
+			continue;
+		}
+
+		const uint8_t* crcAt = &bytes[i + 3 + length];
+		uint32_t crc = crcAt[0] | crcAt[1] << 8 | crcAt[2] << 16 | (uint32_t)crcAt[3] << 24;
+		if (crc != crc32(&bytes[i + 1], length + 2)) {
+			c.badFrames++;
+			i++;
+			continue;
+		}
+
+		decodeFrame(c, bytes[i + 1], Reader(&bytes[i + 3], length));
+		c.frames++;
+		i += 3 + length + 4;
+	}
+}
+
+std::string pointName(const Capture& c, uint8_t point) {
+	return point < c.names.size() && !c.names[point].empty() ? c.names[point] : "point" + std::to_string(point);
+}
+
+/**
+ * Chrome trace format : one complete event ("X") per span, one thread per core.
+ */
+bool writeChromeTrace(const Capture& c, FILE* out) {
+	double mhz = c.cpuMHz ? c.cpuMHz : 1;
+	uint64_t origin = UINT64_MAX;
+	for (const Span& s : c.spans)
+		origin = std::min(origin, s.start);
+
+	fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	for (int core = 0; core < TRACE_CORES; core++)
+		fprintf(out, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"core %d\"}},\n", core, core);
+
+	for (size_t i = 0; i < c.spans.size(); i++) {
+		const Span& s = c.spans[i];
+		fprintf(out, "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"cycles\": %u, \"arg\": %u}},\n",
+			pointName(c, s.point).c_str(), s.core, (s.start - origin) / mhz, s.cycles / mhz, s.cycles, s.arg);
+	}
+
+	fprintf(out, "  {\"name\": \"lost\", \"ph\": \"C\", \"pid\": 1, \"ts\": 0, \"args\": {\"events\": %llu}}\n]}\n", (unsigned long long)c.lost);
+	return !ferror(out);
+}
+
+/**
+ * Length below which a share of the points fall, from the histogram : the top of its bucket.
+ */
+double percentileMicros(const Histogram& h, double share, double mhz) {
+	uint64_t wanted = (uint64_t)(h.count * share + 0.5), seen = 0;
+	for (int b = 0; b < TRACE_BUCKETS; b++) {
+		seen += h.buckets[b];
+		if (seen >= wanted && seen > 0)
+			return std::min((double)h.max, (double)((2ULL << b) - 1)) / mhz;
+	}
+	return h.max / mhz;
+}
+
+void printHistograms(const Capture& c) {
+	double mhz = c.cpuMHz ? c.cpuMHz : 1;
+
+	std::vector<Histogram> total;
+	for (const std::vector<Histogram>& histograms : c.histograms) {
+		total.resize(std::max(total.size(), histograms.size()));
+		for (size_t p = 0; p < histograms.size(); p++) {
+			total[p].count += histograms[p].count;
+			total[p].max = std::max(total[p].max, histograms[p].max);
+			for (int b = 0; b < TRACE_BUCKETS; b++)
+				total[p].buckets[b] += histograms[p].buckets[b];
+		}
+	}
+
+	fprintf(stderr, "%-16s %10s %12s %12s %12s\n", "point", "count", "p50 (us)", "p99 (us)", "max (us)");
+	for (size_t p = 0; p < total.size(); p++) {
+		const Histogram& h = total[p];
+		if (h.count == 0)
+			continue;
+		fprintf(stderr, "%-16s %10llu %12.3f %12.3f %12.3f\n", pointName(c, p).c_str(), (unsigned long long)h.count,
+			percentileMicros(h, 0.5, mhz), percentileMicros(h, 0.99, mhz), h.max / mhz);
+	}
+	fprintf(stderr, "%zu events, %llu lost, %u frames, %u bad frames, %s\n", c.spans.size(), (unsigned long long)c.lost,
+		c.frames, c.badFrames, c.ended ? "complete" : "no end frame");
+}
+
+/**
+ * Keeps what the firmware sends, as the serial port would.
+ */
+class Recorder : public Print {
+public:
+	std::vector<uint8_t> bytes;
+
+	size_t write(const uint8_t* buffer, size_t size) override {
+		bytes.insert(bytes.end(), buffer, buffer + size);
+		return size;
+	}
+	using Print::write;
+};
+
+void runFor(uint64_t micros) {
+	uint64_t until = nativehal::nowMicros() + micros;
+	while (nativehal::nowMicros() < until)
+		loop();
+}
+
+/**
+ * Boots the firmware and types the first user's code, as the native build does.
+ */
+std::vector<uint8_t> runFirmware() {
+	nativehal::wipeFs();
+	nativehal::reset();
+	nativehal::setRtcEpoch(DateTime(2022, 6, 20, 12, 0, 0).unixtime());
+
+	setup();
+
+	for (long i = 0; i < options.run; i++) {
+		for (char k : std::string(UsersPrep[0].password)) {
+			nativehal::pressKey(k == '1' ? Button1 : (k == '2' ? Button2 : Button3), nativehal::nowMicros() + 100000, 120);
+			runFor(320000);
+		}
+		nativehal::pressKey(EnterPin, nativehal::nowMicros() + 100000, 120);
+		runFor(4000000);
+	}
+
+	if (CurrentState == State::Problem)
+		fprintf(stderr, "The firmware is in State::Problem.\n");
+
+	Recorder recorder;
+	traceExport(recorder);
+	return recorder.bytes;
+}
+
+std::vector<uint8_t> readCapture() {
+	FILE* in = options.in.empty() ? stdin : fopen(options.in.c_str(), "rb");
+	std::vector<uint8_t> bytes;
+	uint8_t buffer[4096];
+	size_t n;
+
+	if (!in) {
+		fprintf(stderr, "Can't open %s\n", options.in.c_str());
+		exit(1);
+	}
+	while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer + n);
+	if (in != stdin)
+		fclose(in);
+	return bytes;
+}
+
+// Not inlined, so that both loops call a function
+__attribute__((noinline)) void untraced(volatile uint32_t& sink) {
+	sink++;
+}
+
+__attribute__((noinline)) void traced(volatile uint32_t& sink) {
+	TraceScope scope(TraceUserIndex);
+	sink++;
+}
+
+/**
+ * Cost of a tracepoint : the same function with and without one, timed on the host clock.
+ * The host reads its clock where the ESP32 reads a register, that part is given apart.
+ */
+int measureOverhead() {
+	volatile uint32_t sink = 0;
+
+	Clock::time_point tc = Clock::now();
+	for (long i = 0; i < options.overhead; i++)
+		sink += traceCycles();
+	Clock::time_point t0 = Clock::now();
+	for (long i = 0; i < options.overhead; i++)
+		untraced(sink);
+	Clock::time_point t1 = Clock::now();
+	for (long i = 0; i < options.overhead; i++)
+		traced(sink);
+	Clock::time_point t2 = Clock::now();
+
+	double base = std::chrono::duration<double, std::nano>(t1 - t0).count() / options.overhead;
+	double withTrace = std::chrono::duration<double, std::nano>(t2 - t1).count() / options.overhead;
+	double clockRead = std::chrono::duration<double, std::nano>(t0 - tc).count() / options.overhead;
+
+	printf("{\"events\": %ld, \"untracedNanos\": %.1f, \"tracedNanos\": %.1f, \"overheadNanosPerEvent\": %.1f,\n"
+		" \"counterReadNanos\": %.1f, \"overheadWithoutCounterNanos\": %.1f}\n",
+		options.overhead, base, withTrace, withTrace - base, clockRead, withTrace - base - 2 * clockRead);
+	return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+	parseArguments(argc, argv);
+
+	if (options.overhead > 0)
+		return measureOverhead();
+
+	Capture capture;
+	decode(capture, options.run > 0 ? runFirmware() : readCapture());
+
+	FILE* out = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+	if (!out) {
+		fprintf(stderr, "Can't write %s\n", options.out.c_str());
+		return 1;
+	}
+	bool ok = writeChromeTrace(capture, out);
+	if (out != stdout)
+		fclose(out);
+
+	printHistograms(capture);
+	return ok && capture.frames > 0 ? 0 : 1;
+}